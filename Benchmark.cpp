@@ -0,0 +1,234 @@
+/*
+ * Benchmark.cpp - Timing of the hot paths, on the Due and on the host
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <math.h>
+#include "Benchmark.h"
+#include "CanbusHandler.h"
+#include "SerialConsole.h"
+#include "Watchdog.h"
+
+extern EEPROMSettings settings;
+extern CANBusHandler *cbHandler;
+
+static volatile float benchSink; //keeps results from being optimized away
+static uint8_t benchIndex;
+static CAB300 *benchCab300; //made on the first run so builds that never run this don't pay for them
+static CAN_FRAME benchFrame;
+static SerialConsole *benchConsole;
+static char benchCommand[24];
+
+void Benchmark::runAll(Print &out)
+{
+	uint32_t packAH = settings.currentPackAH;
+
+	if (benchCab300 == NULL) benchCab300 = new CAB300();
+	if (benchConsole == NULL) benchConsole = new SerialConsole();
+	out.print("#bench build ");
+	out.print(CFG_BUILD_NUM);
+#if defined(__SAM3X8E__)
+	out.println(", ticks are CPU cycles");
+#else
+	out.println(", ticks are ns");
+#endif
+	out.println("name,ops,min,median,mean,stddev,max");
+
+	runHandleTick(out);
+	runBatched(out, "getTemperature", opTemperature);
+	runBatched(out, "getPackVoltage", opPackVoltage);
+	runBatched(out, "sendStatus", opSendStatus);
+	runBatched(out, "sendQuadStatus", opSendQuadStatus);
+
+	//50A of discharge, the same as the CAB300 sends it
+	memset(&benchFrame, 0, sizeof(benchFrame));
+	benchFrame.id = settings.cab300Address;
+	benchFrame.extended = (settings.cab300Address > 0x7FF);
+	benchFrame.length = 8;
+	benchFrame.data.byte[0] = 0x80;
+	benchFrame.data.byte[2] = 0xC3;
+	benchFrame.data.byte[3] = 0x50;
+	runBatched(out, "cab300Frame", opCab300);
+	settings.currentPackAH = packAH; //that integrated a little current
+
+	runBatched(out, "logFloat", opLogFloat);
+
+	//set a value to what it already is so nothing changes
+	sprintf(benchCommand, "BALTHR=%u\r", settings.balanceThreshold);
+	runBatched(out, "configCmd", opConfigCmd);
+}
+
+/*
+Calls op in a batch that takes at least BENCH_SAMPLE_US, doubling the batch until it does,
+then times BENCH_SAMPLES batches of that size.
+*/
+void Benchmark::runBatched(Print &out, const char *name, void (*op)())
+{
+	float samples[BENCH_SAMPLES];
+	uint32_t ops = 1, start, ticks;
+
+	while (true)
+	{
+		start = Profiler::now();
+		for (uint32_t i = 0; i < ops; i++) op();
+		ticks = Profiler::now() - start;
+		if (ticks >= BENCH_SAMPLE_US * PROFILE_TICKS_PER_US || ops >= BENCH_MAX_BATCH) break;
+		ops *= 2;
+	}
+
+	for (int s = 0; s < BENCH_SAMPLES; s++)
+	{
+		idle(0);
+		start = Profiler::now();
+		for (uint32_t i = 0; i < ops; i++) op();
+		ticks = Profiler::now() - start;
+		samples[s] = (float)ticks / ops;
+	}
+	report(out, name, ops, samples, BENCH_SAMPLES);
+}
+
+/*
+handleTick() does a different one of its five steps each call so each step gets its own
+line. Calls are spaced out like the scheduler spaces them, otherwise the reads would
+always find the conversion still going.
+*/
+void Benchmark::runHandleTick(Print &out)
+{
+	ADCClass *adc = ADCClass::getInstance();
+	float samples[5][BENCH_ADC_ROUNDS];
+	uint32_t start, ticks;
+	uint8_t operation;
+	char name[16];
+
+	while (adc->getOperation() != 0)
+	{
+		adc->handleTick();
+		idle(BENCH_ADC_SPACING);
+	}
+	for (int round = 0; round < BENCH_ADC_ROUNDS; round++)
+	{
+		for (operation = 0; operation < 5; operation++)
+		{
+			idle(BENCH_ADC_SPACING);
+			start = Profiler::now();
+			adc->handleTick();
+			ticks = Profiler::now() - start;
+			samples[operation][round] = (float)ticks;
+		}
+	}
+	for (operation = 0; operation < 5; operation++)
+	{
+		sprintf(name, "handleTick.op%u", operation);
+		report(out, name, 1, samples[operation], BENCH_ADC_ROUNDS);
+	}
+}
+
+//min, median, mean, standard deviation and max of the samples. Sorts them in place
+void Benchmark::report(Print &out, const char *name, uint32_t ops, float *samples, int count)
+{
+	float sum = 0.0f, mean, variance = 0.0f, swap;
+
+	for (int i = 1; i < count; i++)
+	{
+		for (int j = i; j > 0 && samples[j - 1] > samples[j]; j--)
+		{
+			swap = samples[j];
+			samples[j] = samples[j - 1];
+			samples[j - 1] = swap;
+		}
+	}
+	for (int i = 0; i < count; i++) sum += samples[i];
+	mean = sum / count;
+	for (int i = 0; i < count; i++) variance += (samples[i] - mean) * (samples[i] - mean);
+	variance /= (count - 1);
+
+	out.print(name);
+	out.print(',');
+	out.print(ops);
+	out.print(',');
+	out.print(samples[0], 1);
+	out.print(',');
+	out.print((samples[(count - 1) / 2] + samples[count / 2]) / 2.0f, 1);
+	out.print(',');
+	out.print(mean, 1);
+	out.print(',');
+	out.print(sqrtf(variance), 1);
+	out.print(',');
+	out.println(samples[count - 1], 1);
+}
+
+//between samples. The main loop isn't running so the heartbeats have to come from here
+void Benchmark::idle(uint32_t ms)
+{
+	Watchdog::beat(HB_ADC);
+	Watchdog::beat(HB_CAN);
+	Watchdog::beat(HB_CHARGER);
+	if (ms) delay(ms);
+}
+
+void Benchmark::format(Print &out, char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	Logger::logMessage(out, format, args);
+	va_end(args);
+}
+
+void Benchmark::opTemperature()
+{
+	benchSink = ADCClass::getInstance()->getTemperature(benchIndex++ % BMS_NUM_CHANNELS);
+}
+
+void Benchmark::opPackVoltage()
+{
+	benchSink = ADCClass::getInstance()->getPackVoltage();
+}
+
+void Benchmark::opSendStatus()
+{
+	cbHandler->sendStatus();
+}
+
+void Benchmark::opSendQuadStatus()
+{
+	cbHandler->sendQuadStatus();
+}
+
+void Benchmark::opCab300()
+{
+	benchCab300->processFrame(benchFrame);
+}
+
+//the formatting a handleTick debug line gets, into a line buffer like log() uses
+void Benchmark::opLogFloat()
+{
+	LogLine line;
+	format(line, "T%i: %f", benchIndex & 3, 22.679f + benchIndex);
+	benchIndex++;
+}
+
+void Benchmark::opConfigCmd()
+{
+	for (char *c = benchCommand; *c; c++) benchConsole->rcvCharacter(*c);
+}
@@ -0,0 +1,70 @@
+/*
+ * Benchmark.h - Timing of the hot paths, on the Due and on the host
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <Arduino.h>
+#include "config.h"
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#define BENCH_SAMPLES		32 //timed samples per benchmark, after one warm up
+#define BENCH_SAMPLE_US		1000 //ops are batched until one sample takes at least this long
+#define BENCH_MAX_BATCH		1048576
+#define BENCH_ADC_ROUNDS	16 //full handleTick cycles timed, one call at a time
+#define BENCH_ADC_SPACING	70 //ms between handleTick calls so the ADS1110 has a conversion ready (15 per second)
+
+/*
+Times the functions that run all the time so a change that slows one down shows up. Ticks
+come from Profiler::now(): CPU cycles from the DWT counter on the Due, nanoseconds on the
+host. Results are CSV, one line per benchmark, all in ticks per op:
+  name,ops,min,median,mean,stddev,max
+where ops is how many calls went into each sample. host/tools/bench.cpp (bmsbench) runs
+these on the host and compares against a saved run. On the Due, B on the console runs them
+when CFG_BENCHMARK is set. That sends status frames flat out, reads the ADCs and puts a
+config command through the console, so only do it on a unit on the bench.
+*/
+class Benchmark
+{
+public:
+	static void runAll(Print &out);
+
+private:
+	static void runBatched(Print &out, const char *name, void (*op)());
+	static void runHandleTick(Print &out);
+	static void report(Print &out, const char *name, uint32_t ops, float *samples, int count);
+	static void idle(uint32_t ms);
+	static void format(Print &out, char *format, ...);
+
+	static void opTemperature();
+	static void opPackVoltage();
+	static void opSendStatus();
+	static void opSendQuadStatus();
+	static void opCab300();
+	static void opLogFloat();
+	static void opConfigCmd();
+};
+
+#endif
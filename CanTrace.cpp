@@ -0,0 +1,89 @@
+/*
+ * CanTrace.cpp - RAM ring of received canbus frames for chasing field problems
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include "CanTrace.h"
+
+#if CFG_CANTRACE_FRAMES
+CANTRACE_ENTRY CanTrace::entries[CFG_CANTRACE_FRAMES];
+#endif
+uint16_t CanTrace::head = 0;
+uint16_t CanTrace::count = 0;
+uint32_t CanTrace::total = 0;
+
+//called for each frame as it is read, before anything acts on it
+void CanTrace::record(const CAN_FRAME &frame)
+{
+#if CFG_CANTRACE_FRAMES
+	CANTRACE_ENTRY &entry = entries[head];
+
+	entry.micros = micros();
+	entry.id = frame.id;
+	if (frame.extended) entry.id |= 0x80000000ul;
+	if (frame.rtr) entry.id |= 0x40000000ul;
+	entry.length = (frame.length > 8) ? 8 : frame.length;
+	memcpy(entry.data, frame.data.bytes, 8);
+
+	head = (head + 1) % CFG_CANTRACE_FRAMES;
+	if (count < CFG_CANTRACE_FRAMES) count++;
+	total++;
+#endif
+}
+
+//oldest frame first. The ring is left alone so T can be sent again
+void CanTrace::dump(Print &out)
+{
+	char buff[CANTRACE_LINE];
+	uint32_t last = 0, wraps = 0;
+	uint64_t time;
+	int pos;
+
+	snprintf(buff, sizeof(buff), "#BMS can trace build %u, %u frames, %lu not kept", CFG_BUILD_NUM, count, (unsigned long)(total - count));
+	out.println(buff);
+#if CFG_CANTRACE_FRAMES
+	for (uint16_t i = 0; i < count; i++)
+	{
+		const CANTRACE_ENTRY &entry = entries[(head + CFG_CANTRACE_FRAMES - count + i) % CFG_CANTRACE_FRAMES];
+		if (i > 0 && entry.micros < last) wraps++;
+		last = entry.micros;
+		time = ((uint64_t)wraps << 32) + entry.micros;
+
+		//worst case is 10 digit seconds, an extended RTR id and 8 data bytes: 52 with the terminator
+		pos = snprintf(buff, sizeof(buff), "(%lu.%06lu) can0 ", (unsigned long)(time / 1000000), (unsigned long)(time % 1000000));
+		if (entry.id & 0x80000000ul) pos += snprintf(&buff[pos], sizeof(buff) - pos, "%08lX#", (unsigned long)(entry.id & 0x1FFFFFFF));
+		else pos += snprintf(&buff[pos], sizeof(buff) - pos, "%03lX#", (unsigned long)(entry.id & 0x7FF));
+		if (entry.id & 0x40000000ul) pos += snprintf(&buff[pos], sizeof(buff) - pos, "R");
+		for (int b = 0; b < entry.length; b++) pos += snprintf(&buff[pos], sizeof(buff) - pos, "%02X", entry.data[b]);
+		out.println(buff);
+	}
+#endif
+}
+
+void CanTrace::clear()
+{
+	head = 0;
+	count = 0;
+	total = 0;
+}
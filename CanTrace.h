@@ -0,0 +1,70 @@
+/*
+ * CanTrace.h - RAM ring of received canbus frames for chasing field problems
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <Arduino.h>
+#include "due_can.h"
+#include "config.h"
+
+#ifndef CANTRACE_H_
+#define CANTRACE_H_
+
+/*
+Every frame the BMS receives goes into a ring in RAM with its micros() timestamp, so after
+something odd happens in the field (an SOC jump, the charger cutting out) the last
+CFG_CANTRACE_FRAMES frames leading up to it can be pulled off with T on the console. The
+dump is a candump -l style log that bmshost --replay feeds back through the canbus handler:
+  (seconds.micros) can0 ID#DATA
+Times are since power up. micros() wraps every 71 minutes which the dump undoes as long as
+the bus was never quiet for that long between two frames in the ring.
+*/
+
+#define CANTRACE_LINE	64 //dump line buffer. The header needs up to 60, a frame line 52
+
+struct CANTRACE_ENTRY
+{
+	uint32_t micros;
+	uint32_t id; //bit 31 set if extended, bit 30 if RTR
+	uint8_t length;
+	uint8_t data[8];
+};
+
+class CanTrace
+{
+public:
+	static void record(const CAN_FRAME &frame);
+	static void dump(Print &out);
+	static void clear();
+
+private:
+#if CFG_CANTRACE_FRAMES
+	static CANTRACE_ENTRY entries[CFG_CANTRACE_FRAMES];
+#endif
+	static uint16_t head; //where the next frame goes
+	static uint16_t count;
+	static uint32_t total; //frames recorded since the last clear, including ones written over
+};
+
+#endif
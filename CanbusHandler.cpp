@@ -27,30 +27,11 @@
 #include "FirmwareReceiver.h"
 
 extern FirmwareReceiver *fwReceiver;
+extern DataLogger *sdLogger;
 
 CANBusHandler *CANBusHandler::instance = NULL;
 extern EEPROMSettings settings;
 extern STATUS status;
-volatile bool DoStatus1 = false;
-volatile bool DoStatus2 = false;
-volatile bool DoStatus3 = false;
-volatile bool DoStatus4 = false;
-volatile uint8_t intCounter = 0;
-
-//the status 1 message is sent every 100ms, the others are sent every 500ms
-void tickBounce()
-{
-	DoStatus1 = true;
-	intCounter++;
-	if (intCounter == 4)
-	{
-		DoStatus2 = true;
-		DoStatus3 = true;
-		DoStatus4 = true;
-		intCounter = 0;
-	}
-}
-
 //bounces frame back into class object
 void canbusRX(CAN_FRAME *frame)
 {
@@ -85,35 +66,51 @@ void CANBusHandler::setup()
 	else canbusTermDisable();
 
 	if (settings.CANSpeed < 33333) settings.CANSpeed = 500000; //don't allow stupidly low canbus values
-	Can0.begin(settings.CANSpeed, 255); //no enable pin
+	setSpeed(settings.CANSpeed);
 	if (settings.cab300Address > 0) 
 	{
 		//Can0.watchFor(settings.cab300Address); //allow through only this address for now
 		cab300 = new CAB300();
 	}
 
-	Can0.setRXFilter(0, 0, 0, true);
-	Can0.setRXFilter(1, 0, 0, false);
-
 	elcon = new ElconCharger();
  
 	//Can0.setGeneralCallback(canbusRX);
 
-	Timer5.attachInterrupt(tickBounce);
-	Timer5.start(100000); //100ms
-
 	adc = ADCClass::getInstance();
 }
 
+//begin() resets every mailbox so the receive filters have to go back in each time
+void CANBusHandler::setSpeed(uint32_t speed)
+{
+	Can0.begin(speed, 255); //no enable pin
+	Can0.setRXFilter(0, 0, 0, true);
+	Can0.setRXFilter(1, 0, 0, false);
+}
+
 void CANBusHandler::gotFrame(CAN_FRAME *frame)
 {
 	if (cab300) cab300->processFrame(*frame);
+	if (sdLogger) sdLogger->logFrame(millis(), frame->id, frame->extended, frame->length, frame->data.bytes);
 
 	if (frame->id == (settings.bmsBaseAddress - 0x10)) //BMS control packet
 	{
 		if (frame->data.byte[0] == 0x10) //reset SOC to 100% externally
 		{
 			settings.currentPackAH = settings.maxPackAH;
+			SOCJournal::getInstance()->save();
+		}
+		if (frame->data.byte[0] == 0x20) //request charge session summary. byte 1 = session (0 = newest)
+		{
+			ChargeRecorder::getInstance()->sendSession(frame->data.byte[1]);
+		}
+		if (frame->data.byte[0] >= 0x30 && frame->data.byte[0] <= 0x35) //configuration read / bulk import
+		{
+			handleConfigFrame(frame);
+		}
+		if (frame->data.byte[0] >= 0x40 && frame->data.byte[0] <= 0x42) //profile probe query, see Profiler::sendProbe
+		{
+			Profiler::sendProbe(frame->data.byte[0], frame->data.byte[1]);
 		}
 	}
 	fwReceiver->gotFrame(frame);
@@ -122,78 +119,185 @@ void CANBusHandler::gotFrame(CAN_FRAME *frame)
 	//Logger::debug("Got msg, id=%x", frame->id);
 }
 
+/*
+Settings over canbus, for provisioning tools. Requests come in on the control address
+(base - 0x10), replies go out on base + 5. Parameters are addressed by their index in the
+table in Parameters.cpp and values are the same raw 32 bit values the serial export uses
+(integers unscaled, floats as their bits), little endian.
+0x30 index            read. Reply 0x30, index, type, flags, value
+0x31                  start an import. Reply 0x31, parameter count
+0x32 index value      stage a value. Reply 0x32, index, PARAM_RESULT
+0x33 count            apply the import if count values were staged and all were good.
+                      Reply 0x33, bad value count (0xFF if count didn't match). Saves to EEPROM.
+0x34                  abort the import. Reply 0x34
+0x35                  parameter count. Reply 0x35, count
+*/
+void CANBusHandler::handleConfigFrame(CAN_FRAME *frame)
+{
+	CAN_FRAME reply;
+	const PARAM_DESC *param;
+	uint8_t index = frame->data.byte[1];
+	uint32_t raw;
+	int errors;
+
+	reply.id = settings.bmsBaseAddress + 5;
+	reply.extended = (settings.bmsBaseAddress < 0x7E0) ? false : true;
+	reply.length = 8;
+	reply.rtr = 0;
+	reply.data.value = 0;
+	reply.data.bytes[0] = frame->data.byte[0];
+
+	switch (frame->data.byte[0])
+	{
+	case 0x30:
+		param = Parameters::get(index);
+		reply.data.bytes[1] = index;
+		if (param == NULL)
+		{
+			reply.data.bytes[2] = 0xFF;
+			break;
+		}
+		raw = Parameters::getRaw(param);
+		reply.data.bytes[2] = param->type;
+		reply.data.bytes[3] = param->flags;
+		memcpy(&reply.data.bytes[4], &raw, 4);
+		break;
+	case 0x31:
+		Parameters::beginImport();
+		reply.data.bytes[1] = Parameters::count();
+		break;
+	case 0x32:
+		memcpy(&raw, &frame->data.bytes[2], 4);
+		reply.data.bytes[1] = index;
+		reply.data.bytes[2] = Parameters::importValue(index, raw);
+		break;
+	case 0x33:
+		//the count guards against a frame lost in the middle of the import
+		if (Parameters::isImporting() && Parameters::getImportCount() == index) errors = Parameters::commitImport();
+		else errors = -1;
+		Parameters::abortImport();
+		if (errors == 0) SettingsStore::getInstance()->save();
+		reply.data.bytes[1] = (errors < 0) ? 0xFF : errors;
+		break;
+	case 0x34:
+		Parameters::abortImport();
+		break;
+	case 0x35:
+		reply.data.bytes[1] = Parameters::count();
+		break;
+	}
+	Can0.sendFrame(reply);
+}
+
+//pack current in milliamps or 0 if there is no current sensor
+int32_t CANBusHandler::getAmps()
+{
+	if (cab300) return cab300->getAmps();
+	return 0;
+}
+
+bool CANBusHandler::hasCurrentSensor()
+{
+	return cab300 != NULL;
+}
+
 void CANBusHandler::loop()
 {
-	CAN_FRAME frame, inFrame;
-	uint32_t currAH, maxAH, calcAH;
-	frame.length = 8;
-	if (settings.bmsBaseAddress < 0x7E0) frame.extended = false;
-	else frame.extended = true;
+	PROFILE_SCOPE("canDrain");
+	CAN_FRAME inFrame;
 
 	//this is polling for canbus frames now. This as opposed to
 	//callback mode where things are processed in the interrupt handler
 	for (int i = 0; i < Can0.available(); i++)
 	{
 		Can0.read(inFrame);
+		CanTrace::record(inFrame);
 		gotFrame(&inFrame);
 	}
+}
 
-	if (DoStatus1)
-	{
-		DoStatus1 = false;
-		frame.id = settings.bmsBaseAddress;	
-		BMS_STATUS_1 stat1;
-		stat1.packamps = (int16_t)(cab300->getAmps()/10);
-		stat1.packvolts = (uint16_t)(adc->getPackVoltage() * 100);		
-
-		//Done this way to avoid overflow issues
-		currAH = settings.currentPackAH / 10000;
-		maxAH = settings.maxPackAH / 10000;
-		calcAH = 255 * currAH;
-		calcAH = calcAH / maxAH;
-		uint8_t soc = (uint8_t)calcAH;
-
-		stat1.soc = soc;
-		stat1.status = status;
-		frame.data.value = stat1.value;
-		Can0.sendFrame(frame);
-	}
-	if (DoStatus2)
-	{
-		DoStatus2 = false;
-		frame.id = settings.bmsBaseAddress + 1;
-		BMS_STATUS_2 stat2;
-		stat2.quad1 = (uint16_t)(adc->getVoltage(0) * 100);
-		stat2.quad2 = (uint16_t)(adc->getVoltage(1) * 100);
-		stat2.quad3 = (uint16_t)(adc->getVoltage(2) * 100);
-		stat2.quad4 = (uint16_t)(adc->getVoltage(3) * 100);
-		frame.data.value = stat2.value;
-		Can0.sendFrame(frame);
-	}
+void CANBusHandler::setupStatusFrame(CAN_FRAME &frame, uint8_t offset)
+{
+	frame.id = settings.bmsBaseAddress + offset;
+	frame.length = 8;
+	frame.rtr = 0;
+	if (settings.bmsBaseAddress < 0x7E0) frame.extended = false;
+	else frame.extended = true;
+}
 
-	if (DoStatus3)
-	{
-		DoStatus3 = false;
-		frame.id = settings.bmsBaseAddress + 2;
-		BMS_STATUS_3 stat3;
-		stat3.quad1 = (uint16_t)(adc->getCellAvgVoltage(0) * 1000);
-		stat3.quad2 = (uint16_t)(adc->getCellAvgVoltage(1) * 1000);
-		stat3.quad3 = (uint16_t)(adc->getCellAvgVoltage(2) * 1000);
-		stat3.quad4 = (uint16_t)(adc->getCellAvgVoltage(3) * 1000);
-		frame.data.value = stat3.value;
-		Can0.sendFrame(frame);
-	}
+//pack amps, volts, SOC and status. Sent every 100ms by the scheduler. False if the frame couldn't be queued
+bool CANBusHandler::sendStatus()
+{
+	CAN_FRAME frame;
+
+	setupStatusFrame(frame, 0);
+	BMS_STATUS_1 stat1;
+	stat1.packamps = (int16_t)(getAmps()/10);
+	stat1.packvolts = (uint16_t)(adc->getPackVoltage() * 100);		
+
+	stat1.soc = ChargeRecorder::getSOC(); //0 until the pack size is set, instead of dividing by zero
+	stat1.status = status;
+	frame.data.value = stat1.value;
+	return Can0.sendFrame(frame);
+}
 
-	if (DoStatus4)
+//quad voltages, cell averages and temperatures. Sent every 400ms by the scheduler
+void CANBusHandler::sendQuadStatus()
+{
+	CAN_FRAME frame;
+
+	setupStatusFrame(frame, 1);
+	BMS_STATUS_2 stat2;
+	stat2.quad1 = (uint16_t)(adc->getVoltage(0) * 100);
+	stat2.quad2 = (uint16_t)(adc->getVoltage(1) * 100);
+	stat2.quad3 = (uint16_t)(adc->getVoltage(2) * 100);
+	stat2.quad4 = (uint16_t)(adc->getVoltage(3) * 100);
+	frame.data.value = stat2.value;
+	Can0.sendFrame(frame);
+
+	setupStatusFrame(frame, 2);
+	BMS_STATUS_3 stat3;
+	stat3.quad1 = (uint16_t)(adc->getCellAvgVoltage(0) * 1000);
+	stat3.quad2 = (uint16_t)(adc->getCellAvgVoltage(1) * 1000);
+	stat3.quad3 = (uint16_t)(adc->getCellAvgVoltage(2) * 1000);
+	stat3.quad4 = (uint16_t)(adc->getCellAvgVoltage(3) * 1000);
+	frame.data.value = stat3.value;
+	Can0.sendFrame(frame);
+
+	setupStatusFrame(frame, 3);
+	BMS_STATUS_4 stat4;
+	stat4.quad1 = (int16_t)(adc->getTemperature(0) * 10);
+	stat4.quad2 = (int16_t)(adc->getTemperature(1) * 10);
+	stat4.quad3 = (int16_t)(adc->getTemperature(2) * 10);
+	stat4.quad4 = (int16_t)(adc->getTemperature(3) * 10);
+	frame.data.value = stat4.value;
+	Can0.sendFrame(frame);
+
+#if BMS_NUM_CHANNELS > 4
+	//the rest of the channels are multiplexed onto base + 6, three values per frame
+	BMS_STATUS_5 stat5;
+	uint16_t values[3];
+	setupStatusFrame(frame, 6);
+	for (int kind = CHANNEL_VOLTS; kind <= CHANNEL_TEMP; kind++)
 	{
-		DoStatus4 = false;
-		frame.id = settings.bmsBaseAddress + 3;
-		BMS_STATUS_4 stat4;
-		stat4.quad1 = (int16_t)(adc->getTemperature(0) * 10);
-		stat4.quad2 = (int16_t)(adc->getTemperature(1) * 10);
-		stat4.quad3 = (int16_t)(adc->getTemperature(2) * 10);
-		stat4.quad4 = (int16_t)(adc->getTemperature(3) * 10);
-		frame.data.value = stat4.value;
-		Can0.sendFrame(frame);
+		for (int chan = 4; chan < BMS_NUM_CHANNELS; chan += 3)
+		{
+			for (int x = 0; x < 3; x++)
+			{
+				values[x] = 0;
+				if (chan + x >= BMS_NUM_CHANNELS) continue;
+				if (kind == CHANNEL_VOLTS) values[x] = (uint16_t)(adc->getVoltage(chan + x) * 100);
+				else if (kind == CHANNEL_CELLAVG) values[x] = (uint16_t)(adc->getCellAvgVoltage(chan + x) * 1000);
+				else values[x] = (uint16_t)(int16_t)(adc->getTemperature(chan + x) * 10);
+			}
+			stat5.channel = chan;
+			stat5.kind = kind;
+			stat5.value1 = values[0];
+			stat5.value2 = values[1];
+			stat5.value3 = values[2];
+			frame.data.value = stat5.value;
+			Can0.sendFrame(frame);
+		}
 	}
+#endif
 }
@@ -32,6 +32,13 @@
 #include "i2c_adc.h"
 #include "cab300.h"
 #include "ElconCharger.h"
+#include "ChargeRecorder.h"
+#include "DataLogger.h"
+#include "Parameters.h"
+#include "SOCJournal.h"
+#include "SettingsStore.h"
+#include "Profiler.h"
+#include "CanTrace.h"
 
 #ifndef CANBUSCLASS_H_
 #define CANBUSCLASS_H_
@@ -42,12 +49,19 @@ public:
 	void canbusTermEnable();
 	void canbusTermDisable();
 	void setup();
+	void setSpeed(uint32_t speed);
 	static CANBusHandler *getInstance();
 	void gotFrame(CAN_FRAME *frame);
+	int32_t getAmps();
+	bool hasCurrentSensor();
 	void loop();
+	bool sendStatus();
+	void sendQuadStatus();
 protected:
 private:
 	static CANBusHandler* instance;
+	void handleConfigFrame(CAN_FRAME *frame);
+	void setupStatusFrame(CAN_FRAME &frame, uint8_t offset);
 	ADCClass *adc;
 	CAB300 *cab300;
 	ElconCharger *elcon;
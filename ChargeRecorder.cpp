@@ -0,0 +1,289 @@
+/*
+ * ChargeRecorder.cpp - Keeps summary statistics of the last few charge sessions
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include "ChargeRecorder.h"
+#include "i2c_adc.h"
+
+extern EEPROMSettings settings;
+
+ChargeRecorder *ChargeRecorder::instance = NULL;
+
+static const char *endReasonNames[] = { "in progress/power lost", "complete", "pack full", "BMS abort", "charger fault", "charger lost" };
+
+ChargeRecorder::ChargeRecorder()
+{
+	active = false;
+	headSlot = CHARGE_LOG_SESSIONS - 1;
+	nextSequence = 1;
+	lastState = CHARGER_IDLE;
+}
+
+ChargeRecorder *ChargeRecorder::getInstance()
+{
+	if (instance == NULL)
+	{
+		instance = new ChargeRecorder();
+	}
+	return instance;
+}
+
+//Find the newest stored session so new ones continue on from there
+void ChargeRecorder::setup()
+{
+	CHARGE_SESSION session;
+	uint32_t newest = 0;
+
+	for (int slot = 0; slot < CHARGE_LOG_SESSIONS; slot++)
+	{
+		EEPROM.read(EE_CHARGELOG_ADDR + slot * sizeof(CHARGE_SESSION), session);
+		if (validSession(session) && session.sequence > newest)
+		{
+			newest = session.sequence;
+			headSlot = slot;
+		}
+	}
+	nextSequence = newest + 1;
+}
+
+//the charger only talks to us when it is plugged in. If it goes quiet the session is over.
+void ChargeRecorder::loop()
+{
+	if (active && (millis() - lastChargerFrame) > CHARGER_TIMEOUT)
+	{
+		endSession(CHARGE_END_LOST);
+	}
+}
+
+//Called every time the charger sends a status frame (about once a second)
+void ChargeRecorder::chargerUpdate(ElconCharger *charger)
+{
+	uint32_t now = millis();
+	uint32_t interval;
+	CHARGER_STATE state = charger->getState();
+	int16_t temperature;
+
+	lastChargerFrame = now;
+
+	if (!active)
+	{
+		if (state != CHARGER_BULK && state != CHARGER_TAPER) return;
+		startSession();
+	}
+
+	//integrate over the time since the last frame using what the charger is reporting right now
+	interval = now - lastUpdate;
+	lastUpdate = now;
+	ampAccum += (uint64_t)charger->getCurrent() * interval;
+	wattAccum += (uint64_t)charger->getCurrent() * charger->getVoltage() * interval;
+	if (lastState == CHARGER_BULK) bulkMillis += interval;
+	if (lastState == CHARGER_TAPER) taperMillis += interval;
+	lastState = state;
+
+	//tenths of an amp * ms -> mAh is * 100 / 3,600,000
+	current.milliAH = (uint32_t)(ampAccum / 36000);
+	//hundredths of a watt * ms -> Wh is / (100 * 3,600,000)
+	current.wattHours = (uint32_t)(wattAccum / 360000000ull);
+	current.bulkSeconds = bulkMillis / 1000;
+	current.taperSeconds = taperMillis / 1000;
+	current.endSOC = getSOC();
+	current.chargerFaults |= charger->getStatusFlags();
+	if (charger->getVoltage() > current.peakVoltage) current.peakVoltage = charger->getVoltage();
+	for (int x = 0; x < BMS_NUM_CHANNELS; x++)
+	{
+		temperature = (int16_t)(ADCClass::getInstance()->getTemperature(x) * 10);
+		if (temperature > current.peakTemp) current.peakTemp = temperature;
+	}
+
+	switch (state)
+	{
+	case CHARGER_FAULT:
+		endSession(CHARGE_END_FAULT);
+		break;
+	case CHARGER_ABORTED:
+		endSession(CHARGE_END_BMS_ABORT);
+		break;
+	case CHARGER_DONE:
+		if (settings.currentPackAH >= settings.maxPackAH) endSession(CHARGE_END_PACKFULL);
+		else endSession(CHARGE_END_COMPLETE);
+		break;
+	default:
+		if ((now - lastCheckpoint) > CHARGE_CHECKPOINT_TIME)
+		{
+			lastCheckpoint = now;
+			saveSession();
+		}
+		break;
+	}
+}
+
+void ChargeRecorder::startSession()
+{
+	memset(&current, 0, sizeof(current));
+	current.sequence = nextSequence++;
+	current.startSOC = getSOC();
+	current.endSOC = current.startSOC;
+	current.peakTemp = -32768;
+	current.endReason = CHARGE_END_NONE;
+
+	ampAccum = 0;
+	wattAccum = 0;
+	bulkMillis = 0;
+	taperMillis = 0;
+	lastUpdate = millis();
+	lastCheckpoint = lastUpdate;
+	lastState = CHARGER_IDLE;
+	headSlot = (headSlot + 1) % CHARGE_LOG_SESSIONS;
+	active = true;
+
+	Logger::info("Charge session %l started at SOC %i", current.sequence, current.startSOC);
+	saveSession();
+}
+
+void ChargeRecorder::endSession(CHARGE_END_REASON reason)
+{
+	current.endReason = reason;
+	current.endSOC = getSOC();
+	active = false;
+	saveSession();
+	Logger::info("Charge session %l ended: %s", current.sequence, endReasonNames[reason]);
+}
+
+//the session in progress is always written over the same slot so checkpoints don't push out old sessions
+void ChargeRecorder::saveSession()
+{
+	uint8_t *bytes = (uint8_t *)&current;
+	uint8_t sum = 0;
+
+	current.checksum = 0;
+	for (unsigned int x = 0; x < sizeof(CHARGE_SESSION); x++) sum += bytes[x];
+	current.checksum = -sum;
+	EEPROM.write(EE_CHARGELOG_ADDR + headSlot * sizeof(CHARGE_SESSION), current);
+}
+
+bool ChargeRecorder::validSession(CHARGE_SESSION &session)
+{
+	uint8_t *bytes = (uint8_t *)&session;
+	uint8_t sum = 0;
+
+	if (session.sequence == 0 || session.sequence == 0xFFFFFFFF) return false;
+	for (unsigned int x = 0; x < sizeof(CHARGE_SESSION); x++) sum += bytes[x];
+	return (sum == 0);
+}
+
+bool ChargeRecorder::getSession(uint8_t which, CHARGE_SESSION &session)
+{
+	if (which >= CHARGE_LOG_SESSIONS) return false;
+	if (which == 0 && active)
+	{
+		session = current;
+		return true;
+	}
+	EEPROM.read(EE_CHARGELOG_ADDR + ((headSlot + CHARGE_LOG_SESSIONS - which) % CHARGE_LOG_SESSIONS) * sizeof(CHARGE_SESSION), session);
+	return validSession(session);
+}
+
+void ChargeRecorder::printSessions()
+{
+	CHARGE_SESSION session;
+	bool found = false;
+
+	for (int x = 0; x < CHARGE_LOG_SESSIONS; x++)
+	{
+		if (!getSession(x, session)) continue;
+		found = true;
+		Logger::console("Session %l%s: SOC %i%% -> %i%%, %l mAh, %l Wh", session.sequence, (x == 0 && active) ? " (charging)" : "",
+			(session.startSOC * 100) / 255, (session.endSOC * 100) / 255, session.milliAH, session.wattHours);
+		Logger::console("    Bulk %l:%l Taper %l:%l (h:mm), Peak %f C, %f V, Faults %X, Ended: %s",
+			session.bulkSeconds / 3600, (session.bulkSeconds / 60) % 60, session.taperSeconds / 3600, (session.taperSeconds / 60) % 60,
+			session.peakTemp / 10.0f, session.peakVoltage / 10.0f, session.chargerFaults,
+			(x == 0 && active) ? "still charging" : endReasonNames[session.endReason < 6 ? session.endReason : 0]);
+	}
+	if (!found) Logger::console("No charge sessions recorded");
+}
+
+/*
+Reply to a session request on base address + 4. Three frames are sent, byte 0 is which session
+(0 = newest), byte 1 is the page. Little endian, just like the status frames.
+page 0: start SOC, end SOC, end reason, charger faults, peak temperature (int16, tenths C)
+page 1: mAh delivered (uint32), minutes in bulk (uint16)
+page 2: Wh delivered (uint32), minutes in taper (uint16)
+A session that doesn't exist gets a single page 0 frame with the end reason set to 0xFF
+*/
+void ChargeRecorder::sendSession(uint8_t which)
+{
+	CAN_FRAME frame;
+	CHARGE_SESSION session;
+	uint16_t minutes;
+
+	frame.id = settings.bmsBaseAddress + 4;
+	frame.extended = (settings.bmsBaseAddress < 0x7E0) ? false : true;
+	frame.length = 8;
+	frame.rtr = 0;
+	frame.data.value = 0;
+	frame.data.bytes[0] = which;
+
+	if (!getSession(which, session))
+	{
+		frame.data.bytes[4] = 0xFF;
+		Can0.sendFrame(frame);
+		return;
+	}
+
+	frame.data.bytes[1] = 0;
+	frame.data.bytes[2] = session.startSOC;
+	frame.data.bytes[3] = session.endSOC;
+	frame.data.bytes[4] = session.endReason;
+	frame.data.bytes[5] = session.chargerFaults;
+	frame.data.s3 = session.peakTemp;
+	Can0.sendFrame(frame);
+
+	frame.data.bytes[1] = 1;
+	memcpy(&frame.data.bytes[2], &session.milliAH, 4);
+	minutes = session.bulkSeconds / 60;
+	memcpy(&frame.data.bytes[6], &minutes, 2);
+	Can0.sendFrame(frame);
+
+	frame.data.bytes[1] = 2;
+	memcpy(&frame.data.bytes[2], &session.wattHours, 4);
+	minutes = session.taperSeconds / 60;
+	memcpy(&frame.data.bytes[6], &minutes, 2);
+	Can0.sendFrame(frame);
+}
+
+bool ChargeRecorder::isCharging()
+{
+	return active;
+}
+
+//Same scaling as the SOC in BMS_STATUS_1
+uint8_t ChargeRecorder::getSOC()
+{
+	uint32_t currAH = settings.currentPackAH / 10000;
+	uint32_t maxAH = settings.maxPackAH / 10000;
+	if (maxAH == 0) return 0;
+	if (currAH > maxAH) currAH = maxAH;
+	return (uint8_t)((255 * currAH) / maxAH);
+}
@@ -0,0 +1,103 @@
+/*
+ * ChargeRecorder.h - Keeps summary statistics of the last few charge sessions
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <Arduino.h>
+#include "due_can.h"
+#include <Wire_EEPROM.h>
+#include "Logger.h"
+#include "config.h"
+#include "ElconCharger.h"
+
+#ifndef CHARGERECORDER_H_
+#define CHARGERECORDER_H_
+
+#define CHARGE_LOG_SESSIONS		8 //how many sessions are kept in EEPROM
+#define CHARGER_TIMEOUT			5000 //ms without a charger status frame before we decide it went away
+#define CHARGE_CHECKPOINT_TIME	300000 //save the session in progress every 5 minutes in case we lose power
+
+enum CHARGE_END_REASON
+{
+	CHARGE_END_NONE = 0, //still in progress (or power was lost before it ended)
+	CHARGE_END_COMPLETE, //charger reached the target voltage
+	CHARGE_END_PACKFULL, //coulomb counter says the pack is full
+	CHARGE_END_BMS_ABORT, //BMS status said charging was not OK
+	CHARGE_END_FAULT, //charger reported a fault
+	CHARGE_END_LOST //charger stopped talking to us (unplugged, AC lost, etc)
+};
+
+//This is stored as-is in EEPROM so keep it at 32 bytes
+struct CHARGE_SESSION
+{
+	uint32_t sequence; //increments with each session. 0 or 0xFFFFFFFF is an empty slot
+	uint32_t milliAH; //amp hours delivered according to the charger, in mAh
+	uint32_t wattHours; //energy delivered according to the charger
+	uint32_t bulkSeconds; //time spent in the constant current phase
+	uint32_t taperSeconds; //time spent tapering current near the target voltage
+	int16_t peakTemp; //highest pack temperature seen (tenths of a degree C)
+	uint16_t peakVoltage; //highest output voltage reported by the charger (tenths of a volt)
+	uint8_t startSOC; //state of charge scaled 0 to 255 just like BMS_STATUS_1
+	uint8_t endSOC;
+	uint8_t endReason; //CHARGE_END_REASON
+	uint8_t chargerFaults; //every Elcon status flag seen during the session OR'd together
+	uint8_t reserved[3];
+	uint8_t checksum; //all 32 bytes sum to zero if the record is good
+};
+
+class ChargeRecorder
+{
+public:
+	ChargeRecorder();
+	static ChargeRecorder *getInstance();
+	void setup();
+	void loop();
+	void chargerUpdate(ElconCharger *charger);
+	bool getSession(uint8_t which, CHARGE_SESSION &session); //0 = newest
+	void printSessions();
+	void sendSession(uint8_t which);
+	bool isCharging();
+	static uint8_t getSOC();
+
+private:
+	static ChargeRecorder *instance;
+	CHARGE_SESSION current;
+	bool active;
+	uint8_t headSlot; //slot that holds (or will hold) the newest session
+	uint32_t nextSequence;
+	uint32_t lastUpdate;
+	uint32_t lastChargerFrame;
+	uint32_t lastCheckpoint;
+	uint32_t bulkMillis, taperMillis;
+	uint64_t ampAccum; //tenths of an amp * ms
+	uint64_t wattAccum; //tenths of a volt * tenths of an amp * ms
+	CHARGER_STATE lastState;
+
+	void startSession();
+	void endSession(CHARGE_END_REASON reason);
+	void saveSession();
+	static bool validSession(CHARGE_SESSION &session);
+};
+
+#endif
@@ -0,0 +1,268 @@
+/*
+ * DataLogger.cpp - Streams pack snapshots and canbus traffic to an SD card
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+//No Arduino includes in here on purpose. The host tools build this file as-is.
+#include <string.h>
+#include "DataLogger.h"
+
+DataLogger::DataLogger(SdCard *sdCard)
+{
+	card = sdCard;
+	active = false;
+	queuedBuffer = -1;
+	inFlight = false;
+	dropped = 0;
+	totalDropped = 0;
+	blocksWritten = 0;
+	errors = 0;
+	failuresInRow = 0;
+}
+
+/*
+Bring up the card and find the newest segment on it. Logging continues in the segment after that.
+This reads the first block of every segment so it does block for a bit. Only call it from setup().
+*/
+bool DataLogger::begin(uint32_t now, uint32_t buildNum)
+{
+	SDLOG_BLOCK_HEADER header;
+	uint32_t newest = 0;
+	uint32_t blocks;
+
+	active = false;
+	if (!card->begin()) return false;
+
+	blocks = card->getBlockCount();
+	segmentBlocks = blocks / SDLOG_MAX_SEGMENTS;
+	if (segmentBlocks < SDLOG_MIN_SEGMENT_BLOCKS) segmentBlocks = SDLOG_MIN_SEGMENT_BLOCKS;
+	segmentCount = blocks / segmentBlocks;
+	if (segmentCount == 0) return false;
+
+	segment = segmentCount - 1; //so a blank card starts at segment 0
+	for (uint32_t s = 0; s < segmentCount; s++)
+	{
+		if (!card->readBlock(s * segmentBlocks, buffers[0])) return false;
+		memcpy(&header, buffers[0], sizeof(header));
+		if (header.magic == SDLOG_MAGIC && header.blockIndex == 0 && header.sequence > newest)
+		{
+			newest = header.sequence;
+			segment = s;
+		}
+	}
+
+	segment = (segment + 1) % segmentCount;
+	sequence = newest + 1;
+	blockIndex = 0;
+	fillBuffer = 0;
+	queuedBuffer = -1;
+	inFlight = false;
+	failuresInRow = 0;
+	lastSeal = now;
+	startBlock();
+	active = true;
+
+	addRecord(now, SDLOG_REC_START, &buildNum, 4);
+	return true;
+}
+
+bool DataLogger::isActive()
+{
+	return active;
+}
+
+/*
+Keeps the card busy. Never waits for the card, it only looks to see if the last write
+finished and if so starts the next one.
+*/
+void DataLogger::loop(uint32_t now)
+{
+	if (!active) return;
+
+	if (queuedBuffer >= 0 && inFlight && !card->isBusy())
+	{
+		queuedBuffer = -1;
+		inFlight = false;
+		if (card->hadError())
+		{
+			if (writeFailed()) return;
+		}
+		else
+		{
+			blocksWritten++;
+			failuresInRow = 0;
+		}
+	}
+
+	if (queuedBuffer >= 0 && !inFlight && !card->isBusy())
+	{
+		if (card->startWrite(queuedBlock, buffers[queuedBuffer])) inFlight = true;
+		else
+		{
+			queuedBuffer = -1; //that block is lost but keep going
+			if (writeFailed()) return;
+		}
+	}
+
+	//don't let a half full block sit in RAM forever if things are quiet
+	if ((now - lastSeal) > SDLOG_FLUSH_TIME) flush(now);
+}
+
+void DataLogger::logSnapshot(uint32_t now, const SDLOG_SNAPSHOT &snapshot)
+{
+	addRecord(now, SDLOG_REC_SNAPSHOT, &snapshot, sizeof(SDLOG_SNAPSHOT));
+}
+
+void DataLogger::logChannels(uint32_t now, const SDLOG_CHANNELS &channels)
+{
+	addRecord(now, SDLOG_REC_CHANNELS, &channels, sizeof(SDLOG_CHANNELS));
+}
+
+void DataLogger::logFrame(uint32_t now, uint32_t id, bool extended, uint8_t length, const uint8_t *data)
+{
+	uint8_t payload[12];
+
+	if (length > 8) length = 8;
+	if (extended) id |= 0x80000000ul;
+	memcpy(payload, &id, 4);
+	memcpy(&payload[4], data, length);
+	addRecord(now, SDLOG_REC_CANFRAME, payload, 4 + length);
+}
+
+//queue up whatever has been collected so far, even if the block isn't full
+void DataLogger::flush(uint32_t now)
+{
+	if (!active) return;
+	if (fillPos > sizeof(SDLOG_BLOCK_HEADER)) seal(now);
+}
+
+uint32_t DataLogger::getSequence()
+{
+	return sequence;
+}
+
+uint32_t DataLogger::getBlocksWritten()
+{
+	return blocksWritten;
+}
+
+uint32_t DataLogger::getDroppedCount()
+{
+	return totalDropped;
+}
+
+uint32_t DataLogger::getErrorCount()
+{
+	return errors;
+}
+
+/*
+Add a record to the block being filled. If it won't fit the block is handed off to the card
+and the other buffer is used. If the card still hasn't finished with the other buffer the
+record is thrown away and counted. The count is written out as soon as there is room.
+*/
+bool DataLogger::addRecord(uint32_t now, uint8_t type, const void *payload, uint8_t length)
+{
+	uint16_t needed = SDLOG_RECORD_HEADER + length;
+	uint8_t *out;
+
+	if (!active) return false;
+	if (dropped > 0) needed += SDLOG_RECORD_HEADER + 4;
+
+	if ((fillPos + needed) > SD_BLOCK_SIZE && !seal(now))
+	{
+		dropped++;
+		totalDropped++;
+		return false;
+	}
+
+	if (dropped > 0)
+	{
+		uint32_t count = dropped;
+		dropped = 0;
+		addRecord(now, SDLOG_REC_DROPPED, &count, 4); //room for this was checked above
+	}
+
+	out = &buffers[fillBuffer][fillPos];
+	out[0] = type;
+	out[1] = length;
+	memcpy(&out[2], &now, 4);
+	memcpy(&out[SDLOG_RECORD_HEADER], payload, length);
+	fillPos += SDLOG_RECORD_HEADER + length;
+	return true;
+}
+
+//count a lost block. Returns true if the card has now failed too often and logging is stopped
+bool DataLogger::writeFailed()
+{
+	errors++;
+	if (++failuresInRow < SDLOG_MAX_FAILURES) return false;
+	active = false; //card pulled or dead. Don't keep stalling the loop on command timeouts
+	return true;
+}
+
+//hand the block being filled off to the card. Fails if the other buffer is still in use.
+bool DataLogger::seal(uint32_t now)
+{
+	SDLOG_BLOCK_HEADER header;
+
+	if (queuedBuffer >= 0) return false;
+
+	header.magic = SDLOG_MAGIC;
+	header.sequence = sequence;
+	header.blockIndex = blockIndex;
+	header.used = fillPos;
+	header.reserved = 0;
+	memcpy(buffers[fillBuffer], &header, sizeof(header));
+
+	queuedBuffer = fillBuffer;
+	queuedBlock = segment * segmentBlocks + blockIndex;
+	inFlight = false;
+	lastSeal = now;
+
+	//file rotation - once a segment is full move on to the next one
+	blockIndex++;
+	if (blockIndex >= segmentBlocks)
+	{
+		blockIndex = 0;
+		segment = (segment + 1) % segmentCount;
+		sequence++;
+	}
+
+	fillBuffer ^= 1;
+	startBlock();
+
+	//get the write going right away if the card is free
+	if (!card->isBusy())
+	{
+		if (card->startWrite(queuedBlock, buffers[queuedBuffer])) inFlight = true;
+	}
+	return true;
+}
+
+void DataLogger::startBlock()
+{
+	memset(buffers[fillBuffer], 0, SD_BLOCK_SIZE);
+	fillPos = sizeof(SDLOG_BLOCK_HEADER);
+}
@@ -0,0 +1,142 @@
+/*
+ * DataLogger.h - Streams pack snapshots and canbus traffic to an SD card
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stdint.h>
+#include "SdCard.h"
+
+#ifndef DATALOGGER_H_
+#define DATALOGGER_H_
+
+/*
+There is no file system on the card. Doing FAT on this chip would cost a lot of RAM and
+would mean waiting on directory and FAT updates. Instead the card is split into equal
+segments and each segment is one log "file". Every power up starts a new segment, and
+a segment that fills up rolls over to the next one. Once the card is full the oldest
+segment is reused.
+
+Every 512 byte block starts with an SDLOG_BLOCK_HEADER followed by packed records.
+Records never straddle blocks. A record is:
+  byte 0    type (SDLOG_RECORD_TYPE)
+  byte 1    payload length
+  bytes 2-5 millis() timestamp
+  payload
+When reading a segment back, stop at the first block whose magic or sequence doesn't
+match block 0 of the segment. Everything after that is left over from a previous pass.
+host/tools/sdlog.cpp does all of this.
+*/
+
+#define SDLOG_MAGIC				0x474F4C42 //"BLOG"
+#define SDLOG_MIN_SEGMENT_BLOCKS 2048 //1MB
+#define SDLOG_MAX_SEGMENTS		256 //all segments are scanned at start up so don't make this huge
+#define SDLOG_FLUSH_TIME		10000 //write out a partly filled block after this many ms
+#define SDLOG_RECORD_HEADER		6
+#define SDLOG_MAX_FAILURES		3 //writes in a row that fail before the card is given up on until the next power up
+
+enum SDLOG_RECORD_TYPE
+{
+	SDLOG_REC_PAD = 0, //end of the records in this block
+	SDLOG_REC_SNAPSHOT = 1, //SDLOG_SNAPSHOT
+	SDLOG_REC_CANFRAME = 2, //uint32_t id (bit 31 set if extended) then the data bytes
+	SDLOG_REC_DROPPED = 3, //uint32_t count of records lost because the card fell behind
+	SDLOG_REC_START = 4, //uint32_t firmware build number. First record after power up
+	SDLOG_REC_CHANNELS = 5 //SDLOG_CHANNELS per expansion board, after each snapshot
+};
+
+struct SDLOG_BLOCK_HEADER
+{
+	uint32_t magic;
+	uint32_t sequence; //segment (file) number, increases by one each time a segment is started
+	uint32_t blockIndex; //which block of the segment this is
+	uint16_t used; //bytes used in this block including this header
+	uint16_t reserved;
+} __attribute__((packed));
+
+//one full scan of the pack
+struct SDLOG_SNAPSHOT
+{
+	uint16_t packVolts; //hundredths of a volt
+	int32_t packMilliAmps; //from the CAB300, positive is discharge
+	uint32_t currentPackAH; //same units as settings.currentPackAH
+	uint8_t soc; //0 - 255 like BMS_STATUS_1
+	uint8_t status; //STATUS bitfield
+	uint16_t quadVolts[4]; //hundredths of a volt
+	int16_t quadTemps[4]; //tenths of a degree C
+} __attribute__((packed));
+
+//the quads of an expansion board, channels 4 * group to 4 * group + 3. Same units as the snapshot
+struct SDLOG_CHANNELS
+{
+	uint8_t group;
+	uint16_t volts[4];
+	int16_t temps[4];
+} __attribute__((packed));
+
+class DataLogger
+{
+public:
+	DataLogger(SdCard *sdCard);
+	bool begin(uint32_t now, uint32_t buildNum);
+	bool isActive();
+	void loop(uint32_t now);
+	void logSnapshot(uint32_t now, const SDLOG_SNAPSHOT &snapshot);
+	void logChannels(uint32_t now, const SDLOG_CHANNELS &channels);
+	void logFrame(uint32_t now, uint32_t id, bool extended, uint8_t length, const uint8_t *data);
+	void flush(uint32_t now);
+	uint32_t getSequence();
+	uint32_t getBlocksWritten();
+	uint32_t getDroppedCount();
+	uint32_t getErrorCount();
+
+private:
+	SdCard *card;
+	bool active;
+	uint32_t segmentBlocks;
+	uint32_t segmentCount;
+	uint32_t segment; //segment being written
+	uint32_t sequence;
+	uint32_t blockIndex; //index within the segment of the block being filled
+
+	uint8_t buffers[2][SD_BLOCK_SIZE];
+	uint8_t fillBuffer; //buffer records are going into
+	uint16_t fillPos;
+	int8_t queuedBuffer; //full buffer waiting for (or being written to) the card. -1 if none
+	uint32_t queuedBlock; //absolute card block for the queued buffer
+	bool inFlight;
+	uint32_t lastSeal;
+
+	uint32_t dropped; //records dropped since the last DROPPED record
+	uint32_t totalDropped;
+	uint32_t blocksWritten;
+	uint32_t errors;
+	uint8_t failuresInRow; //failed writes since the last good one
+
+	bool writeFailed();
+	bool addRecord(uint32_t now, uint8_t type, const void *payload, uint8_t length);
+	bool seal(uint32_t now);
+	void startBlock();
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "ElconCharger.h"
+#include "ChargeRecorder.h"
 
 extern EEPROMSettings settings;
 extern STATUS status;
@@ -9,6 +10,7 @@ ElconCharger::ElconCharger()
 	outputVoltage = 0;
 	outputCurrent = 0;
 	statusFlags = 0;
+	chargerState = CHARGER_IDLE;
 }
 
 /*
@@ -45,6 +47,9 @@ void ElconCharger::processFrame(CAN_FRAME &frame)
 			wantCharging = true;
 		}
 		if (wantCharging) sendCommand();
+		else if (statusFlags != 0) chargerState = CHARGER_FAULT;
+
+		ChargeRecorder::getInstance()->chargerUpdate(this);
 	}
 }
 
@@ -78,6 +83,8 @@ void ElconCharger::sendCommand()
 	if (statusFlags == 0 && (settings.currentPackAH < settings.maxPackAH) && wantCharging)
 	{
 		Logger::debug("Sending command to continue charging");
+		if (voltageDifference <= 50) chargerState = CHARGER_TAPER;
+		else chargerState = CHARGER_BULK;
 		commandFrame.data.bytes[0] = highByte(settings.chargingVoltage); //charging voltage high byte (in tenths)
 		commandFrame.data.bytes[1] = lowByte(settings.chargingVoltage); //charging voltage low byte (in tenths)
 		commandFrame.data.bytes[2] = highByte(targetAmperage); //charging current high byte (in tenths)
@@ -90,6 +97,9 @@ void ElconCharger::sendCommand()
 	else
 	{
 		Logger::debug("Sending command to cease charging");
+		if (statusFlags != 0) chargerState = CHARGER_FAULT;
+		else if (status.CHARGE_OK == 0) chargerState = CHARGER_ABORTED;
+		else chargerState = CHARGER_DONE;
 		commandFrame.data.bytes[0] = highByte(settings.chargingVoltage); //charging voltage high byte (in tenths)
 		commandFrame.data.bytes[1] = lowByte(settings.chargingVoltage); //charging voltage low byte (in tenths)
 		commandFrame.data.bytes[2] = 0; //charging current high byte (in tenths)
@@ -112,3 +122,13 @@ int32_t ElconCharger::getCurrent()
 {
 	return outputCurrent;
 }
+
+uint8_t ElconCharger::getStatusFlags()
+{
+	return statusFlags;
+}
+
+CHARGER_STATE ElconCharger::getState()
+{
+	return chargerState;
+}
\ No newline at end of file
@@ -32,6 +32,16 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #ifndef ELCON_H_
 #define ELCON_H_
 
+enum CHARGER_STATE
+{
+	CHARGER_IDLE, //haven't been asked to charge yet
+	CHARGER_BULK, //constant current portion of the charge
+	CHARGER_TAPER, //close to target voltage so current is being tapered back
+	CHARGER_DONE, //reached target voltage or pack capacity
+	CHARGER_ABORTED, //BMS said it isn't OK to charge
+	CHARGER_FAULT //charger reported a fault
+};
+
 class ElconCharger
 {
 public:
@@ -39,10 +49,13 @@ public:
 	void processFrame(CAN_FRAME &frame);
 	int32_t getVoltage();
 	int32_t getCurrent();
+	uint8_t getStatusFlags();
+	CHARGER_STATE getState();
 
 private:
 	void sendCommand();
 	uint8_t statusFlags;
+	CHARGER_STATE chargerState;
 	boolean wantCharging;
 	int32_t outputVoltage;
 	int32_t outputCurrent;
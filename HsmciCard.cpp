@@ -0,0 +1,269 @@
+/*
+ * HsmciCard.cpp - SD card on the SAM3X high speed multimedia card interface
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include "HsmciCard.h"
+
+//MCCK = MCK / (2 * (CLKDIV + 1))
+#define CLKDIV_400KHZ	104 //identification has to happen at 400KHz or less
+#define CLKDIV_21MHZ	1 //data transfer mode
+
+//command numbers and the response they expect
+#define SD_CMD0		(0 | HSMCI_CMDR_RSPTYP_NORESP | HSMCI_CMDR_OPDCMD_OPENDRAIN)
+#define SD_CMD2		(2 | HSMCI_CMDR_RSPTYP_136_BIT | HSMCI_CMDR_OPDCMD_OPENDRAIN)
+#define SD_CMD3		(3 | HSMCI_CMDR_RSPTYP_48_BIT | HSMCI_CMDR_MAXLAT)
+#define SD_CMD6		(6 | HSMCI_CMDR_RSPTYP_48_BIT | HSMCI_CMDR_MAXLAT)
+#define SD_CMD7		(7 | HSMCI_CMDR_RSPTYP_R1B | HSMCI_CMDR_MAXLAT)
+#define SD_CMD8		(8 | HSMCI_CMDR_RSPTYP_48_BIT | HSMCI_CMDR_MAXLAT | HSMCI_CMDR_OPDCMD_OPENDRAIN)
+#define SD_CMD9		(9 | HSMCI_CMDR_RSPTYP_136_BIT)
+#define SD_CMD16	(16 | HSMCI_CMDR_RSPTYP_48_BIT | HSMCI_CMDR_MAXLAT)
+#define SD_CMD17	(17 | HSMCI_CMDR_RSPTYP_48_BIT | HSMCI_CMDR_MAXLAT | HSMCI_CMDR_TRCMD_START_DATA | HSMCI_CMDR_TRDIR_READ | HSMCI_CMDR_TRTYP_SINGLE)
+#define SD_CMD24	(24 | HSMCI_CMDR_RSPTYP_48_BIT | HSMCI_CMDR_MAXLAT | HSMCI_CMDR_TRCMD_START_DATA | HSMCI_CMDR_TRDIR_WRITE | HSMCI_CMDR_TRTYP_SINGLE)
+#define SD_ACMD41	(41 | HSMCI_CMDR_RSPTYP_48_BIT | HSMCI_CMDR_OPDCMD_OPENDRAIN)
+#define SD_CMD55	(55 | HSMCI_CMDR_RSPTYP_48_BIT | HSMCI_CMDR_MAXLAT)
+
+#define HSMCI_DATA_ERRORS	(HSMCI_SR_DCRCE | HSMCI_SR_DTOE | HSMCI_SR_OVRE | HSMCI_SR_UNRE)
+#define HSMCI_CMD_ERRORS	(HSMCI_SR_RINDE | HSMCI_SR_RDIRE | HSMCI_SR_RENDE | HSMCI_SR_RTOE)
+
+HsmciCard::HsmciCard()
+{
+	rca = 0;
+	blockCount = 0;
+	highCapacity = false;
+	writing = false;
+	error = false;
+	writeStart = 0;
+}
+
+/*
+Run the card through the SD identification sequence and switch it to 4 bit, 21MHz transfers.
+This blocks while the card powers up but it is only ever called from setup()
+*/
+bool HsmciCard::begin()
+{
+	uint32_t csd[4];
+	uint32_t start, status;
+	bool version2;
+
+	hsmciPinsinit();
+	pmc_enable_periph_clk(ID_HSMCI);
+	pmc_enable_periph_clk(ID_DMAC);
+
+	HSMCI->HSMCI_CR = HSMCI_CR_SWRST;
+	HSMCI->HSMCI_CR = HSMCI_CR_MCIDIS | HSMCI_CR_PWSDIS;
+	HSMCI->HSMCI_IDR = 0xFFFFFFFF;
+	HSMCI->HSMCI_DTOR = HSMCI_DTOR_DTOCYC(0xF) | HSMCI_DTOR_DTOMUL_1048576;
+	HSMCI->HSMCI_CSTOR = HSMCI_CSTOR_CSTOCYC(0xF) | HSMCI_CSTOR_CSTOMUL_1048576;
+	HSMCI->HSMCI_CFG = HSMCI_CFG_FIFOMODE | HSMCI_CFG_FERRCTRL;
+	HSMCI->HSMCI_SDCR = HSMCI_SDCR_SDCSEL_SLOTA | HSMCI_SDCR_SDCBUS_1;
+	setClock(CLKDIV_400KHZ);
+	HSMCI->HSMCI_CR = HSMCI_CR_MCIEN;
+
+	DMAC->DMAC_EN &= ~DMAC_EN_ENABLE;
+	DMAC->DMAC_GCFG = DMAC_GCFG_ARB_CFG_FIXED;
+	DMAC->DMAC_EN |= DMAC_EN_ENABLE;
+
+	//74 clocks of init sequence then reset the card
+	HSMCI->HSMCI_CMDR = HSMCI_CMDR_RSPTYP_NORESP | HSMCI_CMDR_SPCMD_INIT | HSMCI_CMDR_OPDCMD_OPENDRAIN;
+	if (!waitStatus(HSMCI_SR_CMDRDY, status)) return false;
+	if (!sendCommand(SD_CMD0, 0)) return false;
+
+	//only version 2 cards answer CMD8 and only they can be high capacity
+	version2 = sendCommand(SD_CMD8, 0x1AA) && ((HSMCI->HSMCI_RSPR[0] & 0xFFF) == 0x1AA);
+
+	start = millis();
+	for (;;)
+	{
+		//R3 has no CRC so sendCommand will complain about it. Just look at the response.
+		sendAppCommand(SD_ACMD41, 0x00FF8000 | (version2 ? 0x40000000 : 0));
+		if (HSMCI->HSMCI_RSPR[0] & 0x80000000) break; //card is done powering up
+		if ((millis() - start) > HSMCI_INIT_TIMEOUT) return false;
+	}
+	highCapacity = (HSMCI->HSMCI_RSPR[0] & 0x40000000) ? true : false;
+
+	if (!sendCommand(SD_CMD2, 0)) return false;
+	if (!sendCommand(SD_CMD3, 0)) return false;
+	rca = HSMCI->HSMCI_RSPR[0] >> 16;
+
+	if (!sendCommand(SD_CMD9, rca << 16)) return false;
+	for (int x = 0; x < 4; x++) csd[x] = HSMCI->HSMCI_RSPR[x];
+	blockCount = getCapacity(csd);
+
+	if (!sendCommand(SD_CMD7, rca << 16)) return false;
+	if (!waitStatus(HSMCI_SR_NOTBUSY, status)) return false;
+
+	if (!sendAppCommand(SD_CMD6, 2)) return false; //4 bit bus
+	HSMCI->HSMCI_SDCR = HSMCI_SDCR_SDCSEL_SLOTA | HSMCI_SDCR_SDCBUS_4;
+	if (!highCapacity && !sendCommand(SD_CMD16, SD_BLOCK_SIZE)) return false;
+
+	setClock(CLKDIV_21MHZ);
+	return (blockCount > 0);
+}
+
+uint32_t HsmciCard::getBlockCount()
+{
+	return blockCount;
+}
+
+//Plain polled read. Only used when the logger starts up.
+bool HsmciCard::readBlock(uint32_t block, uint8_t *data)
+{
+	uint32_t *words = (uint32_t *)data;
+	uint32_t status;
+
+	while (isBusy()); //a stuck write times out in isBusy()
+	//only called from setup() while DataLogger scans the segments, before Watchdog::setup() kicks the WDT
+	watchdogReset();
+	HSMCI->HSMCI_DMA = 0;
+	HSMCI->HSMCI_BLKR = HSMCI_BLKR_BLKLEN(SD_BLOCK_SIZE) | HSMCI_BLKR_BCNT(1);
+	if (!sendCommand(SD_CMD17, highCapacity ? block : block * SD_BLOCK_SIZE)) return false;
+
+	for (int x = 0; x < SD_BLOCK_SIZE / 4; x++)
+	{
+		if (!waitStatus(HSMCI_SR_RXRDY | HSMCI_DATA_ERRORS, status)) return false;
+		if (status & HSMCI_DATA_ERRORS) return false;
+		words[x] = HSMCI->HSMCI_RDR;
+	}
+	return waitStatus(HSMCI_SR_XFRDONE, status);
+}
+
+/*
+Point DMA channel at the block and tell the card to start writing. The DMA controller
+feeds the HSMCI FIFO on its own so this returns as soon as the card has accepted the command.
+*/
+bool HsmciCard::startWrite(uint32_t block, const uint8_t *data)
+{
+	if (isBusy()) return false;
+	error = false;
+
+	DMAC->DMAC_CHDR = DMAC_CHDR_DIS0 << HSMCI_DMA_CHANNEL;
+	DMAC->DMAC_EBCISR; //reading clears any old status
+	DMAC->DMAC_CH_NUM[HSMCI_DMA_CHANNEL].DMAC_SADDR = (uint32_t)data;
+	DMAC->DMAC_CH_NUM[HSMCI_DMA_CHANNEL].DMAC_DADDR = (uint32_t)&HSMCI->HSMCI_TDR;
+	DMAC->DMAC_CH_NUM[HSMCI_DMA_CHANNEL].DMAC_DSCR = 0;
+	DMAC->DMAC_CH_NUM[HSMCI_DMA_CHANNEL].DMAC_CTRLA = (SD_BLOCK_SIZE / 4) | DMAC_CTRLA_SRC_WIDTH_WORD | DMAC_CTRLA_DST_WIDTH_WORD;
+	DMAC->DMAC_CH_NUM[HSMCI_DMA_CHANNEL].DMAC_CTRLB = DMAC_CTRLB_SRC_DSCR | DMAC_CTRLB_DST_DSCR |
+		DMAC_CTRLB_FC_MEM2PER_DMA_FC | DMAC_CTRLB_SRC_INCR_INCREMENTING | DMAC_CTRLB_DST_INCR_FIXED;
+	//HSMCI is hardware handshake interface 0
+	DMAC->DMAC_CH_NUM[HSMCI_DMA_CHANNEL].DMAC_CFG = DMAC_CFG_DST_PER(0) | DMAC_CFG_DST_H2SEL | DMAC_CFG_SOD | DMAC_CFG_FIFOCFG_ALAP_CFG;
+	DMAC->DMAC_CHER = DMAC_CHER_ENA0 << HSMCI_DMA_CHANNEL;
+
+	HSMCI->HSMCI_DMA = HSMCI_DMA_DMAEN;
+	HSMCI->HSMCI_BLKR = HSMCI_BLKR_BLKLEN(SD_BLOCK_SIZE) | HSMCI_BLKR_BCNT(1);
+	if (!sendCommand(SD_CMD24, highCapacity ? block : block * SD_BLOCK_SIZE))
+	{
+		DMAC->DMAC_CHDR = DMAC_CHDR_DIS0 << HSMCI_DMA_CHANNEL;
+		HSMCI->HSMCI_DMA = 0;
+		error = true;
+		return false;
+	}
+	writing = true;
+	writeStart = millis();
+	return true;
+}
+
+//XFRDONE only comes up once the data is sent and the card has stopped signalling busy
+bool HsmciCard::isBusy()
+{
+	uint32_t status;
+
+	if (!writing) return false;
+	status = HSMCI->HSMCI_SR;
+	if (status & HSMCI_DATA_ERRORS) error = true;
+	else if (!(status & HSMCI_SR_XFRDONE))
+	{
+		if ((millis() - writeStart) <= HSMCI_WRITE_TIMEOUT) return true;
+		error = true; //card pulled or stuck. Give up on this block
+	}
+
+	DMAC->DMAC_CHDR = DMAC_CHDR_DIS0 << HSMCI_DMA_CHANNEL;
+	HSMCI->HSMCI_DMA = 0;
+	writing = false;
+	return false;
+}
+
+bool HsmciCard::hadError()
+{
+	return error;
+}
+
+//poll the status register until one of flags comes up. False if that takes over HSMCI_CMD_TIMEOUT
+bool HsmciCard::waitStatus(uint32_t flags, uint32_t &status)
+{
+	uint32_t start = millis();
+
+	for (;;)
+	{
+		status = HSMCI->HSMCI_SR;
+		if (status & flags) return true;
+		if ((millis() - start) > HSMCI_CMD_TIMEOUT) return false;
+	}
+}
+
+bool HsmciCard::sendCommand(uint32_t cmdr, uint32_t arg)
+{
+	uint32_t status;
+
+	HSMCI->HSMCI_ARGR = arg;
+	HSMCI->HSMCI_CMDR = cmdr;
+	if (!waitStatus(HSMCI_SR_CMDRDY, status)) return false;
+
+	if (status & (HSMCI_CMD_ERRORS | HSMCI_SR_RCRCE)) return false;
+	if ((cmdr & HSMCI_CMDR_RSPTYP_Msk) == HSMCI_CMDR_RSPTYP_R1B)
+	{
+		return waitStatus(HSMCI_SR_NOTBUSY, status);
+	}
+	return true;
+}
+
+bool HsmciCard::sendAppCommand(uint32_t cmdr, uint32_t arg)
+{
+	if (!sendCommand(SD_CMD55, rca << 16)) return false;
+	return sendCommand(cmdr, arg);
+}
+
+void HsmciCard::setClock(uint32_t divider)
+{
+	HSMCI->HSMCI_MR = HSMCI_MR_CLKDIV(divider) | HSMCI_MR_PWSDIV(7) | HSMCI_MR_RDPROOF | HSMCI_MR_WRPROOF;
+}
+
+//number of 512 byte blocks on the card according to the CSD register
+uint32_t HsmciCard::getCapacity(uint32_t *csd)
+{
+	//csd[0] holds bits 127-96, csd[3] holds bits 31-0
+	#define CSD_BITS(msb, lsb) ((((uint64_t)csd[(127 - (msb)) / 32] << 32 | csd[(127 - (lsb)) / 32]) >> ((lsb) % 32)) & ((1ull << ((msb) - (lsb) + 1)) - 1))
+	uint32_t cSize, cSizeMult, readBlockLength;
+
+	if (CSD_BITS(127, 126) == 1) //CSD version 2 (SDHC / SDXC)
+	{
+		cSize = CSD_BITS(69, 48);
+		return (cSize + 1) * 1024;
+	}
+	cSize = CSD_BITS(73, 62);
+	cSizeMult = CSD_BITS(49, 47);
+	readBlockLength = CSD_BITS(83, 80);
+	return ((cSize + 1) << (cSizeMult + 2)) << readBlockLength >> 9;
+	#undef CSD_BITS
+}
@@ -0,0 +1,65 @@
+/*
+ * HsmciCard.h - SD card on the SAM3X high speed multimedia card interface
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <Arduino.h>
+#include "SamNonDuePin.h" //Non-supported SAM3X pin library
+#include "SdCard.h"
+
+#ifndef HSMCICARD_H_
+#define HSMCICARD_H_
+
+#define HSMCI_DMA_CHANNEL	0 //DMAC channel used to feed the HSMCI during writes
+#define HSMCI_INIT_TIMEOUT	1000 //ms to wait for the card to come out of its power up cycle
+#define HSMCI_CMD_TIMEOUT	100 //ms to wait for a command, busy signal or read data before giving up on the card
+#define HSMCI_WRITE_TIMEOUT	500 //ms a block write may take before it counts as failed
+
+class HsmciCard : public SdCard
+{
+public:
+	HsmciCard();
+	bool begin();
+	uint32_t getBlockCount();
+	bool readBlock(uint32_t block, uint8_t *data);
+	bool startWrite(uint32_t block, const uint8_t *data);
+	bool isBusy();
+	bool hadError();
+
+private:
+	uint32_t rca;
+	uint32_t blockCount;
+	bool highCapacity;
+	bool writing;
+	bool error;
+	uint32_t writeStart; //millis() when the write going now was started
+
+	bool waitStatus(uint32_t flags, uint32_t &status);
+	bool sendCommand(uint32_t cmdr, uint32_t arg);
+	bool sendAppCommand(uint32_t cmdr, uint32_t arg);
+	void setClock(uint32_t divider);
+	uint32_t getCapacity(uint32_t *csd);
+};
+
+#endif
@@ -0,0 +1,68 @@
+/*
+ * LogFormat.h - Layout of binary log records. Shared by the firmware and the
+ * host side decoder (host/tools/logdecode.cpp) so keep it plain C.
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#ifndef LOGFORMAT_H_
+#define LOGFORMAT_H_
+
+#include <stdint.h>
+
+/*
+ * A binary log record looks like this (multi byte values are little endian):
+ *
+ * byte 0       LOG_SYNC
+ * byte 1       LOG_RECORD_TEXT
+ * byte 2       log level (Logger::LogLevel)
+ * byte 3       number of argument bytes that follow the header
+ * bytes 4-5    format string id (see logFormatId())
+ * bytes 6-9    millis() when the message was logged
+ * arguments    one entry per % conversion in the format string:
+ *              %f       - 4 bytes, the value as a 32 bit float
+ *              %s       - 1 length byte then that many characters (at most LOG_MAX_STRING)
+ *              %%       - nothing
+ *              the rest - 4 bytes, the raw 32 bit argument
+ * last byte    checksum. All bytes of the record add up to zero.
+ */
+#define LOG_SYNC			0xA5
+#define LOG_RECORD_TEXT		0x4C
+#define LOG_RECORD_HEADER	10
+#define LOG_MAX_STRING		32
+
+/*
+ * The id of a format string is a 16 bit fold of its 32 bit FNV-1a hash. The decoder
+ * computes the same thing for every log string it finds in the sources.
+ */
+static inline uint16_t logFormatId(const char *format)
+{
+	uint32_t hash = 2166136261UL;
+	while (*format) {
+		hash ^= (uint8_t) *format++;
+		hash *= 16777619UL;
+	}
+	return (uint16_t) (hash ^ (hash >> 16));
+}
+
+#endif /* LOGFORMAT_H_ */
@@ -25,84 +25,91 @@
  */
 
 #include "Logger.h"
+#include "LogFormat.h"
+#include "Profiler.h"
 
 Logger::LogLevel Logger::logLevel = Logger::Info;
 uint32_t Logger::lastLogTime = 0;
-
-/*
- * Output a debug message with a variable amount of parameters.
- * printf() style, see Logger::log()
- *
- */
-void Logger::debug(char *message, ...)
+char Logger::ringBuffer[LOG_BUFFER_SIZE];
+volatile uint16_t Logger::ringHead = 0;
+volatile uint16_t Logger::ringTail = 0;
+uint32_t Logger::droppedMessages = 0;
+uint32_t Logger::totalDropped = 0;
+boolean Logger::binaryMode = false;
+LogSite Logger::sites[LOG_SITE_COUNT];
+uint32_t Logger::lastSummaryScan = 0;
+
+static void printPrefix(Print &out, uint32_t time, Logger::LogLevel level)
 {
-    if (logLevel > Debug) {
-        return;
+    out.print(time);
+    out.print(" - ");
+
+    switch (level) {
+        case Logger::Debug:
+            out.print("DEBUG");
+            break;
+
+        case Logger::Info:
+            out.print("INFO");
+            break;
+
+        case Logger::Warn:
+            out.print("WARNING");
+            break;
+
+        case Logger::Error:
+            out.print("ERROR");
+            break;
+
+        case Logger::Off: //nothing is logged at this level
+            break;
     }
 
-    va_list args;
-    va_start(args, message);
-    Logger::log(Debug, message, args);
-    va_end(args);
+    out.print(": ");
 }
 
-/*
- * Output a info message with a variable amount of parameters
- * printf() style, see Logger::log()
- */
-void Logger::info(char *message, ...)
+LogLine::LogLine()
 {
-    if (logLevel > Info) {
-        return;
-    }
-
-    va_list args;
-    va_start(args, message);
-    Logger::log(Info, message, args);
-    va_end(args);
+    length = 0;
+    truncated = false;
 }
 
-/*
- * Output a warning message with a variable amount of parameters
- * printf() style, see Logger::log()
- */
-void Logger::warn(char *message, ...)
+size_t LogLine::write(uint8_t c)
 {
-    if (logLevel > Warn) {
-        return;
+    if (length >= LOG_LINE_SIZE) {
+        truncated = true;
+        return 0;
     }
-
-    va_list args;
-    va_start(args, message);
-    Logger::log(Warn, message, args);
-    va_end(args);
+    buffer[length++] = c;
+    return 1;
 }
 
 /*
- * Output a error message with a variable amount of parameters
+ * Output a message at the given level with a variable amount of parameters.
+ * This is what debug(), info(), warn() and error() end up calling once they
+ * have decided the message should be logged.
  * printf() style, see Logger::log()
  */
-void Logger::error(char *message, ...)
+void Logger::output(LogLevel level, char *message, ...)
 {
-    if (logLevel > Error) {
-        return;
-    }
-
     va_list args;
     va_start(args, message);
-    Logger::log(Error, message, args);
+    Logger::log(level, message, args);
     va_end(args);
 }
 
 /*
  * Output a comnsole message with a variable amount of parameters
  * printf() style, see Logger::logMessage()
+ *
+ * Console output is the answer to something the user typed so it goes straight
+ * out to SerialUSB instead of through the ring buffer.
  */
 void Logger::console(char *message, ...)
 {
     va_list args;
     va_start(args, message);
-    Logger::logMessage(message, args);
+    Logger::logMessage(SerialUSB, message, args);
     va_end(args);
 }
 
@@ -131,18 +138,140 @@ uint32_t Logger::getLastLogTime()
 }
 
 /*
- * Returns if debug log level is enabled. This can be used in time critical
- * situations to prevent unnecessary string concatenation (if the message won't
- * be logged in the end).
- *
- * Example:
- * if (Logger::isDebug()) {
- *    Logger::debug("current time: %d", millis());
- * }
+ * Hand some of the buffered log output to SerialUSB. Call this often from the main loop.
+ * Only one USB packet worth of data is written per call so a slow (or missing) host
+ * can never hold up the rest of the loop for long.
+ */
+void Logger::loop()
+{
+    PROFILE_SCOPE("logDrain");
+    uint16_t pending;
+    uint16_t start;
+    int room;
+
+    //a call site that keeps getting suppressed still gets a line every so often
+    if ((millis() - lastSummaryScan) > LOG_SUMMARY_TIME) {
+        lastSummaryScan = millis();
+        for (int i = 0; i < LOG_SITE_COUNT; i++) {
+            if (sites[i].suppressed > 0 && (lastSummaryScan - sites[i].lastSummary) > LOG_SUMMARY_TIME) {
+                queueSummary(&sites[i], lastSummaryScan);
+            }
+        }
+    }
+
+    pending = ringHead - ringTail;
+    start = ringTail & (LOG_BUFFER_SIZE - 1);
+    if (pending == 0) {
+        return;
+    }
+    if (pending > LOG_DRAIN_CHUNK) {
+        pending = LOG_DRAIN_CHUNK;
+    }
+    if (pending > LOG_BUFFER_SIZE - start) {
+        pending = LOG_BUFFER_SIZE - start; //don't wrap, the rest goes out next time
+    }
+    //the SAM core's availableForWrite() is a constant, it doesn't know if the host is reading
+    room = SerialUSB.availableForWrite();
+    if (room <= 0) {
+        return;
+    }
+    if (pending > (uint16_t) room) {
+        pending = (uint16_t) room;
+    }
+#if defined(__SAM3X8E__)
+    //USBD_Send() spins until the CDC IN endpoint has a free bank, which is forever if the host
+    //opened the port but isn't reading. Only write when a bank is free so write() can't wait.
+    //A port that isn't open at all doesn't block, write() just throws the bytes away.
+    if (!(UOTGHS->UOTGHS_DEVEPTISR[LOG_CDC_ENDPOINT] & UOTGHS_DEVEPTISR_TXINI)) {
+        return;
+    }
+#endif
+
+    SerialUSB.write((const uint8_t *) &ringBuffer[start], pending);
+    ringTail += pending;
+}
+
+/*
+ * Switch between human readable log lines and compact binary records.
+ * Binary records are turned back into text by the host side decoder in
+ * host/tools. Console output is always text.
+ */
+void Logger::setBinaryMode(boolean binary)
+{
+    binaryMode = binary;
+}
+
+boolean Logger::isBinaryMode()
+{
+    return binaryMode;
+}
+
+/*
+ * Show what every call site has logged and how much of it was held back.
+ */
+void Logger::printSiteStats()
+{
+    static const char *levelNames[] = { "DEBUG", "INFO", "WARN", "ERROR" };
+    int used = 0;
+
+    for (int i = 0; i < LOG_SITE_COUNT; i++) {
+        if (sites[i].format == NULL) {
+            continue;
+        }
+        used++;
+        SerialUSB.print(levelNames[sites[i].level & 3]);
+        SerialUSB.print(" logged: ");
+        SerialUSB.print(sites[i].totalLogged);
+        SerialUSB.print(" suppressed: ");
+        SerialUSB.print(sites[i].totalSuppressed);
+        SerialUSB.print(" \"");
+        SerialUSB.print(sites[i].format);
+        SerialUSB.println("\"");
+    }
+    Logger::console("%i of %i call sites tracked, %i messages dropped by a full buffer", used, LOG_SITE_COUNT, totalDropped);
+}
+
+/*
+ * Return how many log messages have been thrown away because the ring buffer was full.
+ */
+uint32_t Logger::getDroppedCount()
+{
+    return totalDropped;
+}
+
+/*
+ * True while there is still output in the ring waiting for loop() to send it.
+ */
+boolean Logger::hasPending()
+{
+    return ringHead != ringTail;
+}
+
+/*
+ * Put already framed binary data (telemetry for instance) into the ring buffer so it
+ * goes out in order with the log. All or nothing, returns false if it didn't fit.
+ */
+boolean Logger::queueRaw(const uint8_t *data, uint16_t length)
+{
+    return queue((const char *) data, length);
+}
+
+/*
+ * Copy a complete message into the ring buffer. Either the whole message fits
+ * or nothing is copied at all.
  */
-boolean Logger::isDebug()
+boolean Logger::queue(const char *data, uint16_t length)
 {
-    return logLevel == Debug;
+    uint16_t head = ringHead;
+
+    if ((uint16_t)(LOG_BUFFER_SIZE - (uint16_t)(head - ringTail)) < length) {
+        return false;
+    }
+    for (uint16_t i = 0; i < length; i++) {
+        ringBuffer[(head + i) & (LOG_BUFFER_SIZE - 1)] = data[i];
+    }
+    ringHead = head + length; //publish only after the data is in place
+    return true;
 }
 
 /*
@@ -165,35 +294,54 @@ boolean Logger::isDebug()
  */
 void Logger::log(LogLevel level, char *format, va_list args)
 {
-    lastLogTime = millis();
-    SerialUSB.print(lastLogTime);
-    SerialUSB.print(" - ");
+    LogLine line;
+    LogSite *site;
 
-    switch (level) {
-        case Debug:
-            SerialUSB.print("DEBUG");
-            break;
-
-        case Info:
-            SerialUSB.print("INFO");
-            break;
+    lastLogTime = millis(); //a new site starts its bucket at this time
+    site = getSite(format, level);
 
-        case Warn:
-            SerialUSB.print("WARNING");
-            break;
+    //a call site that is flooding the log is held back before any formatting is done. Debug
+    //output is only on when someone asked for all of it, so it isn't limited.
+    if (site != NULL && level != Debug && !allowSite(site)) {
+        return;
+    }
 
-        case Error:
-            SerialUSB.print("ERROR");
-            break;
+    if (binaryMode) {
+        logBinary(line, level, site != NULL ? site->id : logFormatId(format), format, args);
+    } else {
+        printPrefix(line, lastLogTime, level);
+        logMessage(line, format, args);
+        if (line.truncated) { //make sure a truncated line still ends the line
+            line.buffer[LOG_LINE_SIZE - 2] = '\r';
+            line.buffer[LOG_LINE_SIZE - 1] = '\n';
+        }
+    }
+    if (line.length == 0) {
+        return;
     }
 
-    SerialUSB.print(": ");
+    //let the reader know that messages went missing before this one
+    if (droppedMessages > 0) {
+        LogLine marker;
+        marker.print("*** ");
+        marker.print(droppedMessages);
+        marker.println(" log messages dropped ***");
+        if (!queue(marker.buffer, marker.length)) {
+            droppedMessages++;
+            totalDropped++;
+            return;
+        }
+        droppedMessages = 0;
+    }
 
-    logMessage(format, args);
+    if (!queue(line.buffer, line.length)) {
+        droppedMessages++;
+        totalDropped++;
+    }
 }
 
 /*
- * Output a log message (called by log(), console())
+ * Output a log message (called by log(), console()) to the given output.
  *
  * Supports printf() like syntax:
  *
@@ -210,7 +358,7 @@ void Logger::log(LogLevel level, char *format, va_list args)
  * %t - prints the next parameter as boolean ('T' or 'F')
  * %T - prints the next parameter as boolean ('true' or 'false')
  */
-void Logger::logMessage(char *format, va_list args)
+void Logger::logMessage(Print &out, char *format, va_list args)
 {
     for (; *format != 0; ++format) {
         if (*format == '%') {
@@ -221,63 +369,63 @@ void Logger::logMessage(char *format, va_list args)
             }
 
             if (*format == '%') {
-                SerialUSB.print(*format);
+                out.print(*format);
                 continue;
             }
 
             if (*format == 's') {
-                register char *s = (char *) va_arg(args, int);
-                SerialUSB.print(s);
+                register char *s = va_arg(args, char *);
+                out.print(s);
                 continue;
             }
 
             if (*format == 'd' || *format == 'i') {
-                SerialUSB.print(va_arg(args, int), DEC);
+                out.print(va_arg(args, int), DEC);
                 continue;
             }
 
             if (*format == 'f') {
-                SerialUSB.print(va_arg(args, double), 8);
+                out.print(va_arg(args, double), 8);
                 continue;
             }
 
             if (*format == 'x') {
-                SerialUSB.print(va_arg(args, int), HEX);
+                out.print(va_arg(args, int), HEX);
                 continue;
             }
 
             if (*format == 'X') {
-                SerialUSB.print("0x");
-                SerialUSB.print(va_arg(args, int), HEX);
+                out.print("0x");
+                out.print(va_arg(args, int), HEX);
                 continue;
             }
 
             if (*format == 'b') {
-                SerialUSB.print(va_arg(args, int), BIN);
+                out.print(va_arg(args, int), BIN);
                 continue;
             }
 
             if (*format == 'B') {
-                SerialUSB.print("0b");
-                SerialUSB.print(va_arg(args, int), BIN);
+                out.print("0b");
+                out.print(va_arg(args, int), BIN);
                 continue;
             }
 
             if (*format == 'l') {
-                SerialUSB.print(va_arg(args, long), DEC);
+                out.print(va_arg(args, int32_t), DEC); //32 bits on the Due and on the host
                 continue;
             }
 
             if (*format == 'c') {
-                SerialUSB.print(va_arg(args, int));
+                out.print((char) va_arg(args, int));
                 continue;
             }
 
             if (*format == 't') {
                 if (va_arg(args, int) == 1) {
-                    SerialUSB.print("T");
+                    out.print("T");
                 } else {
-                    SerialUSB.print("F");
+                    out.print("F");
                 }
 
                 continue;
@@ -285,9 +433,9 @@ void Logger::logMessage(char *format, va_list args)
 
             if (*format == 'T') {
                 if (va_arg(args, int) == 1) {
-                    SerialUSB.print("TRUE");
+                    out.print("TRUE");
                 } else {
-                    SerialUSB.print("FALSE");
+                    out.print("FALSE");
                 }
 
                 continue;
@@ -295,9 +443,156 @@ void Logger::logMessage(char *format, va_list args)
 
         }
 
-        SerialUSB.print(*format);
+        out.print(*format);
     }
 
-    SerialUSB.println();
+    out.println();
 }
 
+/*
+ * Build a binary log record (see LogFormat.h) instead of formatting the text.
+ * Only the raw argument words are stored so none of the number formatting in
+ * logMessage() has to happen on the device.
+ */
+void Logger::logBinary(LogLine &out, LogLevel level, uint16_t id, char *format, va_list args)
+{
+    uint32_t word;
+    float floatVal;
+    uint8_t sum = 0;
+    char *s;
+    uint8_t len;
+
+    out.write(LOG_SYNC);
+    out.write(LOG_RECORD_TEXT);
+    out.write((uint8_t) level);
+    out.write(0); //argument length, filled in below
+    out.write(id & 0xFF);
+    out.write(id >> 8);
+    for (int i = 0; i < 4; i++) {
+        out.write((lastLogTime >> (8 * i)) & 0xFF);
+    }
+
+    for (; *format != 0; ++format) {
+        if (*format != '%') {
+            continue;
+        }
+        ++format;
+        if (*format == '\0') {
+            break;
+        }
+        if (*format == '%') {
+            continue;
+        }
+
+        if (*format == 's') {
+            s = (char *) va_arg(args, char *);
+            len = strlen(s) > LOG_MAX_STRING ? LOG_MAX_STRING : strlen(s);
+            out.write(len);
+            out.write((const uint8_t *) s, len);
+            continue;
+        }
+
+        if (*format == 'f') {
+            floatVal = (float) va_arg(args, double);
+            memcpy(&word, &floatVal, 4);
+        } else if (*format == 'l') {
+            word = (uint32_t) va_arg(args, int32_t);
+        } else {
+            word = (uint32_t) va_arg(args, int);
+        }
+        for (int i = 0; i < 4; i++) {
+            out.write((word >> (8 * i)) & 0xFF);
+        }
+    }
+
+    if (out.truncated || out.length + 1 > LOG_LINE_SIZE) {
+        out.length = 0; //too many arguments to fit, don't send half a record
+        return;
+    }
+    out.buffer[3] = out.length - LOG_RECORD_HEADER;
+    for (int i = 0; i < out.length; i++) {
+        sum += out.buffer[i];
+    }
+    out.write((uint8_t) -sum);
+}
+
+/*
+ * Find the entry for a call site, making one the first time the site logs. Returns
+ * NULL if the table is full, such a call site just isn't rate limited.
+ * The format id used by binary records is worked out here once per call site since
+ * hashing the string every time would cost more than the record is worth.
+ */
+LogSite *Logger::getSite(const char *format, LogLevel level)
+{
+    uint8_t slot = (((uintptr_t) format) >> 2) & (LOG_SITE_COUNT - 1);
+
+    for (int i = 0; i < LOG_SITE_COUNT; i++) {
+        LogSite *site = &sites[(slot + i) & (LOG_SITE_COUNT - 1)];
+        if (site->format == format) {
+            return site;
+        }
+        if (site->format == NULL) {
+            site->format = format;
+            site->id = logFormatId(format);
+            site->level = level;
+            site->tokens = LOG_SITE_BURST;
+            site->lastRefill = lastLogTime;
+            site->lastSummary = lastLogTime;
+            return site;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Token bucket per call site. Each message uses a token and a token comes back every
+ * LOG_SITE_REFILL ms, so a site can burst LOG_SITE_BURST messages and after that gets
+ * one a second. Anything over that is counted instead of logged.
+ */
+boolean Logger::allowSite(LogSite *site)
+{
+    uint32_t refill = (lastLogTime - site->lastRefill) / LOG_SITE_REFILL;
+
+    if (refill > 0) {
+        site->tokens = (refill + site->tokens > LOG_SITE_BURST) ? LOG_SITE_BURST : site->tokens + refill;
+        site->lastRefill += refill * LOG_SITE_REFILL;
+    }
+    if (site->tokens == 0) {
+        site->suppressed++;
+        site->totalSuppressed++;
+        return false;
+    }
+    site->tokens--;
+    site->totalLogged++;
+
+    //say how many went missing before this one goes out
+    if (site->suppressed > 0) {
+        queueSummary(site, lastLogTime);
+    }
+    return true;
+}
+
+/*
+ * Queue a "repeated N times" line for a call site. The format string is shown
+ * as-is since the arguments of the suppressed messages are long gone.
+ * This is always text, the host decoder passes it straight through.
+ */
+void Logger::queueSummary(LogSite *site, uint32_t now)
+{
+    LogLine line;
+
+    printPrefix(line, now, (LogLevel) site->level);
+    line.print("message repeated ");
+    line.print(site->suppressed);
+    line.print(" more times: ");
+    line.print(site->format);
+    if (line.truncated) {
+        line.length = LOG_LINE_SIZE - 2;
+    }
+    line.println();
+
+    site->lastSummary = now;
+    if (queue(line.buffer, line.length)) {
+        site->suppressed = 0;
+    }
+}
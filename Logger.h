@@ -29,27 +29,142 @@
 
 #include <Arduino.h>
 
+/*
+ * Log calls below this level are compiled out completely, arguments and all.
+ * Production builds should set this to 1 (Info) so the debug calls in the hot
+ * paths cost nothing. The runtime log level still filters everything above it.
+ */
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL	0
+#endif
+
+#define LOG_BUFFER_SIZE	2048 //must be a power of two
+#define LOG_LINE_SIZE	160 //longest single log line. Longer ones get truncated
+#define LOG_DRAIN_CHUNK	64 //most bytes handed to SerialUSB per call to loop(). One USB packet.
+#define LOG_CDC_ENDPOINT	3 //CDC_ENDPOINT_IN in the SAM core's USBDesc.h. SerialUSB output goes out here
+#define LOG_SITE_COUNT	64 //call sites tracked for rate limiting. Must be a power of two
+#define LOG_SITE_BURST	5 //messages a call site may log back to back
+#define LOG_SITE_REFILL	1000 //ms per extra message once the burst is used up
+#define LOG_SUMMARY_TIME	5000 //ms between "repeated N times" summaries for a suppressed call site
+
+//Holds a single formatted log line until it is copied into the ring buffer as a whole
+class LogLine : public Print
+{
+public:
+    LogLine();
+    size_t write(uint8_t c);
+    using Print::write;
+    char buffer[LOG_LINE_SIZE];
+    uint16_t length;
+    boolean truncated;
+};
+
+/*
+ * Everything known about one log call. The format string pointer is the key since every
+ * call site has its own literal. (Identical literals may be merged by the linker in which
+ * case those call sites share one entry - that's fine, they say the same thing.)
+ */
+struct LogSite
+{
+    const char *format;
+    uint16_t id; //format id for binary records, see LogFormat.h
+    uint8_t level;
+    uint8_t tokens; //messages that may still go out right now
+    uint32_t lastRefill;
+    uint32_t lastSummary;
+    uint32_t suppressed; //not logged since the last summary
+    uint32_t totalLogged;
+    uint32_t totalSuppressed;
+};
+
 class Logger
 {
 public:
     enum LogLevel {
         Debug = 0, Info = 1, Warn = 2, Error = 3, Off = 4
     };
-    static void debug(char *, ...);
-    static void info(char *, ...);
-    static void warn(char *, ...);
-    static void error(char *, ...);
+
+    /*
+     * debug(), info(), warn() and error() are inline so the level checks happen at
+     * the call site. Anything below LOG_MIN_LEVEL folds away to nothing at compile time.
+     * printf() style, see Logger::log()
+     */
+    template<typename... Args> static inline void debug(char *message, Args... args)
+    {
+        if (LOG_MIN_LEVEL <= Debug && logLevel <= Debug) {
+            output(Debug, message, args...);
+        }
+    }
+
+    template<typename... Args> static inline void info(char *message, Args... args)
+    {
+        if (LOG_MIN_LEVEL <= Info && logLevel <= Info) {
+            output(Info, message, args...);
+        }
+    }
+
+    template<typename... Args> static inline void warn(char *message, Args... args)
+    {
+        if (LOG_MIN_LEVEL <= Warn && logLevel <= Warn) {
+            output(Warn, message, args...);
+        }
+    }
+
+    template<typename... Args> static inline void error(char *message, Args... args)
+    {
+        if (LOG_MIN_LEVEL <= Error && logLevel <= Error) {
+            output(Error, message, args...);
+        }
+    }
+
+    /*
+     * Returns if debug log level is enabled. This can be used in time critical
+     * situations to prevent unnecessary argument evaluation (if the message won't
+     * be logged in the end). With LOG_MIN_LEVEL above Debug the whole block is
+     * removed by the compiler.
+     *
+     * Example:
+     * if (Logger::isDebug()) {
+     *    Logger::debug("current time: %d", millis());
+     * }
+     */
+    static inline boolean isDebug()
+    {
+        return LOG_MIN_LEVEL <= Debug && logLevel == Debug;
+    }
+
     static void console(char *, ...);
     static void setLoglevel(LogLevel);
     static LogLevel getLogLevel();
     static uint32_t getLastLogTime();
-    static boolean isDebug();
+    static void loop();
+    static uint32_t getDroppedCount();
+    static boolean hasPending();
+    static void setBinaryMode(boolean);
+    static boolean isBinaryMode();
+    static void printSiteStats();
+    static boolean queueRaw(const uint8_t *data, uint16_t length);
 private:
+    friend class Benchmark; //times logMessage() on its own
     static LogLevel logLevel;
     static uint32_t lastLogTime;
+    static char ringBuffer[LOG_BUFFER_SIZE];
+    static volatile uint16_t ringHead; //free running, only the producer moves it
+    static volatile uint16_t ringTail; //free running, only loop() moves it
+    static uint32_t droppedMessages; //dropped since the last marker was queued
+    static uint32_t totalDropped;
+    static boolean binaryMode;
+    static LogSite sites[LOG_SITE_COUNT];
+    static uint32_t lastSummaryScan;
 
+    static void output(LogLevel, char *format, ...);
     static void log(LogLevel, char *format, va_list);
-    static void logMessage(char *format, va_list args);
+    static void logMessage(Print &out, char *format, va_list args);
+    static void logBinary(LogLine &out, LogLevel level, uint16_t id, char *format, va_list args);
+    static LogSite *getSite(const char *format, LogLevel level);
+    static boolean allowSite(LogSite *site);
+    static void queueSummary(LogSite *site, uint32_t now);
+    static boolean queue(const char *data, uint16_t length);
 };
 
 #endif /* LOGGER_H_ */
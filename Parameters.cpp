@@ -0,0 +1,527 @@
+/*
+ * Parameters.cpp - Table of every setting that can be changed from the console
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stddef.h>
+#include "Parameters.h"
+#include "Logger.h"
+#include "CanbusHandler.h"
+#include "Telemetry.h"
+#include "TelemetryFormat.h"
+#include "SOCJournal.h"
+
+extern EEPROMSettings settings;
+
+static void applyTermination(uint32_t raw)
+{
+	if (raw) CANBusHandler::getInstance()->canbusTermEnable();
+	else CANBusHandler::getInstance()->canbusTermDisable();
+}
+
+static void applyCanSpeed(uint32_t raw)
+{
+	CANBusHandler::getInstance()->setSpeed(raw);
+}
+
+static void applyLogLevel(uint32_t raw)
+{
+	Logger::setLoglevel((Logger::LogLevel) raw);
+}
+
+//a pack AH the user typed in shouldn't wait for the next journal record
+static void applyCurrentAH(uint32_t)
+{
+	SOCJournal::getInstance()->save();
+}
+
+static void applyLogBinary(uint32_t raw)
+{
+	Logger::setBinaryMode(raw == 1);
+}
+
+static uint32_t getTelemetry()
+{
+	return Telemetry::getInstance()->getSubscribed();
+}
+
+static void applyTelemSubscribe(uint32_t raw)
+{
+	Telemetry::getInstance()->subscribe(raw);
+}
+
+static void applyTelemUnsubscribe(uint32_t raw)
+{
+	Telemetry::getInstance()->unsubscribe(raw);
+}
+
+#define SETTING(field)	offsetof(EEPROMSettings, field)
+
+#define PARAM_VMULT(bank) \
+	{ "VMULT" #bank, PARAM_FLOAT, (bank == 4) ? PARAM_BREAK : 0, SETTING(vMultiplier[bank - 1]), 0, 0, 1, NULL, NULL, "Set voltage multiplier for bank " #bank }
+
+#define PARAM_TMULT(bank) \
+	{ "TMULT" #bank "A", PARAM_FLOAT, 0, SETTING(tMultiplier[bank - 1].A), 0, 0, 1, NULL, NULL, "Set temperature coefficient A for bank " #bank }, \
+	{ "TMULT" #bank "B", PARAM_FLOAT, 0, SETTING(tMultiplier[bank - 1].B), 0, 0, 1, NULL, NULL, "Set temperature coefficient B for bank " #bank }, \
+	{ "TMULT" #bank "C", PARAM_FLOAT, 0, SETTING(tMultiplier[bank - 1].C), 0, 0, 1, NULL, NULL, "Set temperature coefficient C for bank " #bank }, \
+	{ "TMULT" #bank "D", PARAM_FLOAT, 0, SETTING(tMultiplier[bank - 1].D), 0, 0, 1, NULL, NULL, "Set temperature coefficient D for bank " #bank }, \
+	{ "TMULT" #bank "V", PARAM_FLOAT, PARAM_BREAK, SETTING(tMultiplier[bank - 1].adcToVolts), 0, 0, 1, NULL, NULL, "Set temperature conversion factor for bank " #bank }
+
+#define PARAM_QCELLS(quad) \
+	{ "Q" #quad "CELLS", PARAM_UINT8, (quad == 4) ? PARAM_BREAK : 0, SETTING(numQuadCells[quad - 1]), 0, 120, 1, NULL, NULL, "Set number of series cells in quadrant " #quad }
+
+//everything for one expansion board channel, as its own block of the menu
+#define PARAM_CHANNEL(chan) \
+	PARAM_QCELLS(chan), PARAM_VMULT(chan), PARAM_TMULT(chan)
+
+/*
+The menu is printed in this order. Lookups go through sorted[] so the order here doesn't matter
+to find(). Names must be upper case.
+*/
+static constexpr PARAM_DESC paramTable[] =
+{
+	{ "LOGLEVEL", PARAM_UINT8, 0, SETTING(logLevel), 0, 4, 1, applyLogLevel, NULL, "set log level (0=debug, 1=info, 2=warn, 3=error, 4=off)" },
+	{ "LOGBIN", PARAM_UINT8, 0, SETTING(logBinary), 0, 1, 1, applyLogBinary, NULL, "Log as binary records for the host decoder (0 = text, 1 = binary)" },
+	{ "TELEMSUB", PARAM_UINT8, PARAM_RUNTIME | PARAM_HEX, 0, 0, 0xFF, 1, applyTelemSubscribe, getTelemetry, "Start binary telemetry streams (bitmask: 1 = ADC samples, 2 = quads, 4 = current, 8 = status, 16 = expansion channels)" },
+	{ "TELEMUNSUB", PARAM_UINT8, PARAM_RUNTIME | PARAM_HEX | PARAM_BREAK, 0, 0, 0xFF, 1, applyTelemUnsubscribe, getTelemetry, "Stop telemetry streams (same bitmask)" },
+
+	{ "TERMEN", PARAM_UINT8, 0, SETTING(TermEnabled), 0, 1, 1, applyTermination, NULL, "Enable/Disable CAN Termination (0 = Disable, 1 = Enable)" },
+	{ "CANSPEED", PARAM_UINT32, PARAM_BREAK, SETTING(CANSpeed), 1, 1000000, 1, applyCanSpeed, NULL, "Set speed of CAN in baud (125000, 250000, etc)" },
+
+	{ "CABADDR", PARAM_INT32, PARAM_HEX | PARAM_BREAK, SETTING(cab300Address), 0, 0x7FF, 1, NULL, NULL, "Set address of CAB300 sensor (0 if there isn't one)" },
+
+	{ "BASEADDR", PARAM_INT32, PARAM_HEX | PARAM_BREAK, SETTING(bmsBaseAddress), 1, 0x1FFFFFFF, 1, NULL, NULL, "Set base address for status messages" },
+
+	{ "BALTHR", PARAM_UINT16, 0, SETTING(balanceThreshold), 1, 0xFFFF, 1, NULL, NULL, "Set balancing threshold (millivolts)" },
+	{ "LOWTHR", PARAM_UINT16, 0, SETTING(lowThreshold), 1, 0xFFFF, 1, NULL, NULL, "Set low cell voltage threshold (millivolts)" },
+	{ "HIGHTHR", PARAM_UINT16, 0, SETTING(highThreshold), 1, 0xFFFF, 1, NULL, NULL, "Set high cell voltage (millivolts)" },
+	{ "LOWTEMP", PARAM_INT16, 0, SETTING(lowTempThresh), -400, 1000, 1, NULL, NULL, "Set lowest acceptable temperature (In tenths of deg C)" },
+	{ "HIGHTEMP", PARAM_INT16, PARAM_BREAK, SETTING(highTempThresh), -400, 1000, 1, NULL, NULL, "Set highest acceptable temperature (In tenths of a deg C)" },
+
+	{ "CHARGEV", PARAM_UINT16, 0, SETTING(chargingVoltage), 0, 5000, 1, NULL, NULL, "Set voltage to charge to (Elcon Charger)" },
+	{ "CHARGEA", PARAM_UINT16, PARAM_BREAK, SETTING(chargingAmperage), 0, 400, 1, NULL, NULL, "Set maximum charge amperage (Elcon Charger)" },
+
+	PARAM_QCELLS(1), PARAM_QCELLS(2), PARAM_QCELLS(3), PARAM_QCELLS(4),
+
+	//stored in tenths of a microAH, entered in tenths of an AH
+	{ "MAXAH", PARAM_UINT32, 0, SETTING(maxPackAH), 1, 4294, 1000000, NULL, NULL, "Set pack AH capacity (in tenths of an AH)" },
+	{ "CURRAH", PARAM_UINT32, PARAM_NO_EXPORT | PARAM_BREAK, SETTING(currentPackAH), 0, 4294, 1000000, applyCurrentAH, NULL, "Set current AH state of pack (tenths of AH)" },
+
+	PARAM_VMULT(1), PARAM_VMULT(2), PARAM_VMULT(3), PARAM_VMULT(4),
+
+	PARAM_TMULT(1),
+	PARAM_TMULT(2),
+	PARAM_TMULT(3),
+	PARAM_TMULT(4),
+
+	//expansion board channels go last so the parameter numbers used over canbus are the same in every build
+#if BMS_NUM_CHANNELS > 4
+	PARAM_CHANNEL(5), PARAM_CHANNEL(6), PARAM_CHANNEL(7), PARAM_CHANNEL(8),
+#endif
+#if BMS_NUM_CHANNELS > 8
+	PARAM_CHANNEL(9), PARAM_CHANNEL(10), PARAM_CHANNEL(11), PARAM_CHANNEL(12),
+#endif
+#if BMS_NUM_CHANNELS > 12
+	PARAM_CHANNEL(13), PARAM_CHANNEL(14), PARAM_CHANNEL(15), PARAM_CHANNEL(16),
+#endif
+};
+
+#define PARAM_COUNT	(sizeof(paramTable) / sizeof(paramTable[0]))
+
+uint8_t Parameters::sorted[PARAM_COUNT];
+uint8_t Parameters::touched[(PARAM_COUNT + 7) / 8];
+boolean Parameters::isSorted = false;
+EEPROMSettings Parameters::staged;
+boolean Parameters::importing = false;
+uint16_t Parameters::importCount = 0;
+uint16_t Parameters::importErrors = 0;
+uint16_t Parameters::importCrc = 0xFFFF;
+
+int Parameters::count()
+{
+	return PARAM_COUNT;
+}
+
+const PARAM_DESC *Parameters::get(int index)
+{
+	if (index < 0 || index >= (int)PARAM_COUNT) return NULL;
+	return &paramTable[index];
+}
+
+//binary search by name. name must already be upper case. Returns the table index or -1
+int Parameters::find(const char *name)
+{
+	int low = 0, high = PARAM_COUNT - 1, mid, diff;
+
+	if (!isSorted) sortNames();
+	while (low <= high)
+	{
+		mid = (low + high) / 2;
+		diff = strcmp(name, paramTable[sorted[mid]].name);
+		if (diff == 0) return sorted[mid];
+		if (diff < 0) high = mid - 1;
+		else low = mid + 1;
+	}
+	return -1;
+}
+
+/*
+The value as the user sees it: integers are unscaled, floats are the bits of the float.
+*/
+uint32_t Parameters::getRaw(const PARAM_DESC *param)
+{
+	if (param->flags & PARAM_RUNTIME) return param->get();
+	return readField(param, settings);
+}
+
+uint32_t Parameters::readField(const PARAM_DESC *param, const EEPROMSettings &from)
+{
+	const uint8_t *field = (const uint8_t *)&from + param->offset;
+	uint32_t raw = 0;
+
+	switch (param->type)
+	{
+	case PARAM_UINT8:
+		raw = *field;
+		break;
+	case PARAM_UINT16:
+		raw = *(const uint16_t *)field;
+		break;
+	case PARAM_INT16:
+		raw = (int32_t)*(const int16_t *)field;
+		break;
+	case PARAM_UINT32:
+	case PARAM_INT32:
+	case PARAM_FLOAT:
+		memcpy(&raw, field, 4);
+		break;
+	}
+	if (param->type != PARAM_FLOAT && param->scale > 1) raw /= param->scale;
+	return raw;
+}
+
+uint8_t Parameters::fieldSize(const PARAM_DESC *param)
+{
+	switch (param->type)
+	{
+	case PARAM_UINT8:
+		return 1;
+	case PARAM_UINT16:
+	case PARAM_INT16:
+		return 2;
+	}
+	return 4;
+}
+
+/*
+Check the value against the limits then store it and call the apply hook. Doesn't touch
+EEPROM, the caller decides when to save.
+*/
+PARAM_RESULT Parameters::setRaw(const PARAM_DESC *param, uint32_t raw)
+{
+	PARAM_RESULT result = PARAM_OK;
+
+	if (!(param->flags & PARAM_RUNTIME)) result = store(param, raw, settings);
+	else if ((int32_t)raw < param->min || (int32_t)raw > param->max) result = PARAM_OUT_OF_RANGE;
+	if (result == PARAM_OK && param->apply) param->apply(raw);
+	return result;
+}
+
+PARAM_RESULT Parameters::store(const PARAM_DESC *param, uint32_t raw, EEPROMSettings &to)
+{
+	uint8_t *field = (uint8_t *)&to + param->offset;
+	int32_t value = (int32_t)raw;
+
+	if (param->type == PARAM_FLOAT)
+	{
+		float f;
+		memcpy(&f, &raw, 4);
+		if (f != f) return PARAM_BAD_VALUE; //NaN
+	}
+	else
+	{
+		//UINT32 limits are all well under 2^31 so comparing signed is fine
+		if (value < param->min || value > param->max) return PARAM_OUT_OF_RANGE;
+		raw *= param->scale;
+	}
+
+	switch (param->type)
+	{
+	case PARAM_UINT8:
+		*field = (uint8_t)raw;
+		break;
+	case PARAM_UINT16:
+	case PARAM_INT16:
+		*(uint16_t *)field = (uint16_t)raw;
+		break;
+	default:
+		memcpy(field, &raw, 4);
+		break;
+	}
+	return PARAM_OK;
+}
+
+PARAM_RESULT Parameters::setFromString(const PARAM_DESC *param, const char *text)
+{
+	char *end;
+	uint32_t raw;
+
+	if (param->type == PARAM_FLOAT)
+	{
+		float f = strtof(text, &end);
+		memcpy(&raw, &f, 4);
+	}
+	else raw = (uint32_t)strtol(text, &end, 0); //0x... works too
+	if (end == text) return PARAM_BAD_VALUE;
+	return setRaw(param, raw);
+}
+
+void Parameters::printMenu()
+{
+	const PARAM_DESC *param;
+	uint32_t raw;
+	float f;
+
+	for (unsigned int i = 0; i < PARAM_COUNT; i++)
+	{
+		param = &paramTable[i];
+		raw = getRaw(param);
+		if (param->type == PARAM_FLOAT)
+		{
+			memcpy(&f, &raw, 4);
+			Logger::console("%s=%f - %s", param->name, f, param->description);
+		}
+		else if (param->flags & PARAM_HEX) Logger::console("%s=%X - %s", param->name, raw, param->description);
+		else Logger::console("%s=%i - %s", param->name, raw, param->description);
+		if (param->flags & PARAM_BREAK) SerialUSB.println();
+	}
+}
+
+void Parameters::printSet(const PARAM_DESC *param)
+{
+	uint32_t raw = getRaw(param);
+	float f;
+
+	if (param->type == PARAM_FLOAT)
+	{
+		memcpy(&f, &raw, 4);
+		Logger::console("Setting %s to %f", param->name, f);
+	}
+	else if (param->flags & PARAM_HEX) Logger::console("Setting %s to %X", param->name, raw);
+	else Logger::console("Setting %s to %i", param->name, raw);
+}
+
+/*
+Dump every stored parameter as NAME=value lines that can be fed straight back to the
+import. The last line is #END <number of lines> <CRC16 of the lines> so the importing
+side can tell that nothing was lost on the way. Floats get enough digits to come back
+exactly.
+*/
+void Parameters::exportAll(Print &out)
+{
+	const PARAM_DESC *param;
+	uint16_t crc = 0xFFFF;
+	uint16_t lines = 0;
+	uint32_t raw;
+	float f;
+
+	out.print("#BMS config build ");
+	out.print(CFG_BUILD_NUM);
+	out.print(" eeprom ");
+	out.println(CFG_EEPROM_VER);
+
+	for (unsigned int i = 0; i < PARAM_COUNT; i++)
+	{
+		LogLine line;
+		param = &paramTable[i];
+		if (param->flags & (PARAM_RUNTIME | PARAM_NO_EXPORT)) continue;
+
+		raw = getRaw(param);
+		line.print(param->name);
+		line.print('=');
+		if (param->type == PARAM_FLOAT)
+		{
+			memcpy(&f, &raw, 4);
+			line.print(f, PARAM_EXPORT_FLOAT_DIGITS);
+		}
+		else if (param->flags & PARAM_HEX)
+		{
+			line.print("0x");
+			line.print(raw, HEX);
+		}
+		else if (param->type == PARAM_INT16 || param->type == PARAM_INT32) line.print((int32_t)raw);
+		else line.print(raw);
+
+		line.write('\n');
+		crc = telemCrc16Update(crc, (const uint8_t *)line.buffer, line.length);
+		out.write((const uint8_t *)line.buffer, line.length - 1);
+		out.println();
+		lines++;
+	}
+	out.print("#END ");
+	out.print(lines);
+	out.print(' ');
+	out.println(crc, HEX);
+}
+
+/*
+Importing works on a copy of the settings. Nothing real changes until commitImport()
+and then only if every value was good.
+*/
+void Parameters::beginImport()
+{
+	staged = settings;
+	memset(touched, 0, sizeof(touched));
+	importing = true;
+	importCount = 0;
+	importErrors = 0;
+	importCrc = 0xFFFF;
+}
+
+PARAM_RESULT Parameters::importValue(int index, uint32_t raw)
+{
+	const PARAM_DESC *param = get(index);
+	PARAM_RESULT result;
+
+	if (!importing) return PARAM_NO_IMPORT;
+	if (param == NULL) result = PARAM_UNKNOWN;
+	else if (param->flags & PARAM_RUNTIME) result = PARAM_NOT_STORED;
+	else if (param->flags & PARAM_NO_EXPORT) result = PARAM_OK; //older exports have CURRAH. The pack here keeps its own
+	else
+	{
+		result = store(param, raw, staged);
+		if (result == PARAM_OK) touched[index / 8] |= 1 << (index % 8);
+	}
+
+	importCount++;
+	if (result != PARAM_OK) importErrors++;
+	return result;
+}
+
+//one NAME=value line from an export. The name is upper cased in place.
+PARAM_RESULT Parameters::importLine(char *line)
+{
+	const PARAM_DESC *param;
+	char *value, *end;
+	uint32_t raw;
+	int index;
+
+	if (!importing) return PARAM_NO_IMPORT;
+	importCrc = telemCrc16Update(importCrc, (const uint8_t *)line, strlen(line));
+	importCrc = telemCrc16Update(importCrc, (const uint8_t *)"\n", 1);
+
+	value = strchr(line, '=');
+	if (value == NULL) return importValue(-1, 0);
+	*value++ = 0;
+	for (char *c = line; *c; c++) *c = toupper(*c);
+	index = find(line);
+	param = get(index);
+	if (param == NULL) return importValue(-1, 0);
+
+	if (param->type == PARAM_FLOAT)
+	{
+		float f = strtof(value, &end);
+		memcpy(&raw, &f, 4);
+	}
+	else raw = (uint32_t)strtol(value, &end, 0);
+	if (end == value)
+	{
+		importCount++;
+		importErrors++;
+		return PARAM_BAD_VALUE;
+	}
+	return importValue(index, raw);
+}
+
+//does what came in match the #END line of the export?
+boolean Parameters::checkImport(uint16_t count, uint16_t crc)
+{
+	return importing && count == importCount && crc == importCrc;
+}
+
+/*
+Copy the values that were imported over the real ones and run the apply hooks for anything
+that changed. Only those fields are copied since the rest of the settings (the pack AH the
+CAB300 keeps counting, a console edit) may have moved on while the import came in.
+Returns the number of bad values, in which case nothing was changed at all.
+Saving to EEPROM is left to the caller so it happens once for the whole import.
+*/
+int Parameters::commitImport()
+{
+	const PARAM_DESC *param;
+	uint32_t before;
+	int errors = importErrors;
+
+	if (!importing) return -1;
+	importing = false;
+	if (errors > 0) return errors;
+
+	for (unsigned int i = 0; i < PARAM_COUNT; i++)
+	{
+		if (!(touched[i / 8] & (1 << (i % 8)))) continue;
+		param = &paramTable[i];
+		before = readField(param, settings);
+		memcpy((uint8_t *)&settings + param->offset, (const uint8_t *)&staged + param->offset, fieldSize(param));
+		if (param->apply != NULL && before != readField(param, settings)) param->apply(readField(param, settings));
+	}
+	return 0;
+}
+
+void Parameters::abortImport()
+{
+	importing = false;
+}
+
+boolean Parameters::isImporting()
+{
+	return importing;
+}
+
+uint16_t Parameters::getImportCount()
+{
+	return importCount;
+}
+
+uint16_t Parameters::getImportErrors()
+{
+	return importErrors;
+}
+
+//insertion sort, only done once
+void Parameters::sortNames()
+{
+	uint8_t temp;
+	int j;
+
+	for (unsigned int i = 0; i < PARAM_COUNT; i++)
+	{
+		temp = i;
+		for (j = i; j > 0 && strcmp(paramTable[sorted[j - 1]].name, paramTable[temp].name) > 0; j--)
+		{
+			sorted[j] = sorted[j - 1];
+		}
+		sorted[j] = temp;
+	}
+	isSorted = true;
+}
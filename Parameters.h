@@ -0,0 +1,122 @@
+/*
+ * Parameters.h - Table of every setting that can be changed from the console
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <Arduino.h>
+#include "config.h"
+
+#ifndef PARAMETERS_H_
+#define PARAMETERS_H_
+
+enum PARAM_TYPE
+{
+	PARAM_UINT8,
+	PARAM_UINT16,
+	PARAM_INT16,
+	PARAM_UINT32,
+	PARAM_INT32,
+	PARAM_FLOAT
+};
+
+enum PARAM_FLAGS
+{
+	PARAM_HEX = 1, //show the value in hex
+	PARAM_RUNTIME = 2, //not stored in EEPROMSettings. get() and apply() do all the work
+	PARAM_BREAK = 4, //blank line after this one in the menu
+	PARAM_NO_EXPORT = 8 //pack state rather than configuration. Left out of exports and skipped by imports
+};
+
+enum PARAM_RESULT
+{
+	PARAM_OK,
+	PARAM_BAD_VALUE, //not a number
+	PARAM_OUT_OF_RANGE,
+	PARAM_UNKNOWN, //no parameter by that name or index
+	PARAM_NOT_STORED, //runtime parameters can't be imported
+	PARAM_NO_IMPORT //importValue() without beginImport()
+};
+
+#define PARAM_EXPORT_FLOAT_DIGITS	15 //enough that strtof() gets back exactly the same float
+
+/*
+One entry per setting. Integer values entered by the user are multiplied by scale before
+being stored (MAXAH is entered in tenths of an AH but stored in tenths of a microAH).
+min and max are checked before scaling and aren't used for floats.
+apply is called with the new value (as entered, before scaling) after it has been stored.
+get is only used by runtime parameters to find their current value.
+*/
+struct PARAM_DESC
+{
+	const char *name;
+	uint8_t type;
+	uint8_t flags;
+	uint16_t offset; //into EEPROMSettings
+	int32_t min, max;
+	uint32_t scale;
+	void (*apply)(uint32_t raw);
+	uint32_t (*get)();
+	const char *description;
+};
+
+class Parameters
+{
+public:
+	static int count();
+	static const PARAM_DESC *get(int index);
+	static int find(const char *name);
+	static uint32_t getRaw(const PARAM_DESC *param);
+	static PARAM_RESULT setRaw(const PARAM_DESC *param, uint32_t raw);
+	static PARAM_RESULT setFromString(const PARAM_DESC *param, const char *text);
+	static void printMenu();
+	static void printSet(const PARAM_DESC *param);
+
+	static void exportAll(Print &out);
+	static void beginImport();
+	static PARAM_RESULT importValue(int index, uint32_t raw);
+	static PARAM_RESULT importLine(char *line);
+	static boolean checkImport(uint16_t count, uint16_t crc);
+	static int commitImport();
+	static void abortImport();
+	static boolean isImporting();
+	static uint16_t getImportCount();
+	static uint16_t getImportErrors();
+
+private:
+	static uint8_t sorted[]; //table indexes in name order for find()
+	static boolean isSorted;
+	static EEPROMSettings staged; //import goes here until it is all checked
+	static uint8_t touched[]; //bit per table entry that the import set, so nothing else gets rolled back
+	static boolean importing;
+	static uint16_t importCount;
+	static uint16_t importErrors;
+	static uint16_t importCrc;
+
+	static void sortNames();
+	static uint32_t readField(const PARAM_DESC *param, const EEPROMSettings &from);
+	static uint8_t fieldSize(const PARAM_DESC *param);
+	static PARAM_RESULT store(const PARAM_DESC *param, uint32_t raw, EEPROMSettings &to);
+};
+
+#endif
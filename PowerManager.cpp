@@ -0,0 +1,110 @@
+/*
+ * PowerManager.cpp - Sleeps between ticks and slows the pack scan down while the car is parked
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include "PowerManager.h"
+#include "Scheduler.h"
+#include "CanbusHandler.h"
+#include "ChargeRecorder.h"
+
+PowerManager *PowerManager::instance = NULL;
+
+PowerManager::PowerManager()
+{
+	adcTask = -1;
+	standby = false;
+	lastBusy = 0;
+	resetStats();
+}
+
+PowerManager *PowerManager::getInstance()
+{
+	if (instance == NULL)
+	{
+		instance = new PowerManager();
+	}
+	return instance;
+}
+
+void PowerManager::setup(int adcTask)
+{
+	this->adcTask = adcTask;
+	lastBusy = millis();
+	resetStats();
+}
+
+//runs once a second from the scheduler
+void PowerManager::loop()
+{
+	CANBusHandler *cbHandler = CANBusHandler::getInstance();
+	int32_t amps = cbHandler->getAmps();
+
+	if (!cbHandler->hasCurrentSensor() || ChargeRecorder::getInstance()->isCharging() || amps > STANDBY_CURRENT || amps < -STANDBY_CURRENT)
+	{
+		lastBusy = millis();
+		if (standby) setStandby(false);
+		return;
+	}
+
+	if (!standby && (millis() - lastBusy) > STANDBY_DELAY) setStandby(true);
+}
+
+void PowerManager::idle()
+{
+	uint32_t start = micros();
+
+	__WFI(); //the host build skips ahead to the next timer instead
+	idleMicros += micros() - start;
+	sleeps++;
+}
+
+bool PowerManager::isStandby()
+{
+	return standby;
+}
+
+void PowerManager::printStats()
+{
+	uint32_t elapsed = millis() - statsStart;
+	uint32_t percent = elapsed ? (uint32_t)(idleMicros / 10 / elapsed) : 0;
+
+	Logger::console("Idle %i%% of the last %i ms, %i sleeps. Standby: %s", percent, elapsed, sleeps, standby ? "yes" : "no");
+}
+
+void PowerManager::resetStats()
+{
+	idleMicros = 0;
+	sleeps = 0;
+	statsStart = millis();
+}
+
+void PowerManager::setStandby(bool enable)
+{
+	standby = enable;
+	if (adcTask >= 0) Scheduler::getInstance()->setPeriod(adcTask, enable ? ADC_STANDBY_PERIOD : ADC_NORMAL_PERIOD);
+	Scheduler::getInstance()->setTickLength(enable ? STANDBY_TICK : 1);
+	if (enable) Logger::info("Pack current has been low for a while, scanning slower");
+	else Logger::info("Pack current back up, normal scanning");
+}
@@ -0,0 +1,72 @@
+/*
+ * PowerManager.h - Sleeps between ticks and slows the pack scan down while the car is parked
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <Arduino.h>
+#include "Logger.h"
+#include "config.h"
+
+#ifndef POWERMANAGER_H_
+#define POWERMANAGER_H_
+
+#define STANDBY_CURRENT		1000 //mA. Below this either way counts as parked
+#define STANDBY_DELAY		60000 //ms the current has to stay low before going into standby
+#define ADC_NORMAL_PERIOD	125 //ms between ADC ticks normally
+#define ADC_STANDBY_PERIOD	1000 //and in standby. A full scan takes five ticks
+#define STANDBY_TICK		10 //ms per scheduler interrupt in standby, it's every ms otherwise
+
+/*
+idle() is called from loop() when there was nothing to do on that pass. It stops the CPU
+with WFI until the next interrupt. The scheduler tick (every ms, every STANDBY_TICK ms in
+standby), canbus reception and USB all have interrupts so nothing waits longer than it would
+have anyway.
+Standby is decided once a second from the current sensor. Without a sensor there is no way
+to know the car is parked so standby never happens.
+*/
+class PowerManager
+{
+public:
+	PowerManager();
+	static PowerManager *getInstance();
+	void setup(int adcTask);
+	void loop();
+	void idle();
+	bool isStandby();
+	void printStats();
+	void resetStats();
+
+private:
+	static PowerManager *instance;
+	int adcTask; //scheduler task number for the ADC
+	bool standby;
+	uint32_t lastBusy; //millis() when the pack current was last above STANDBY_CURRENT
+	uint64_t idleMicros; //time spent in WFI since resetStats(). 32 bits would wrap after 71 minutes
+	uint32_t statsStart; //millis() at resetStats()
+	uint32_t sleeps;
+
+	void setStandby(bool enable);
+};
+
+#endif
@@ -0,0 +1,165 @@
+/*
+ * Profiler.cpp - Cycle counting probes around named pieces of code
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include "Profiler.h"
+#include "due_can.h"
+#include "Logger.h"
+
+extern EEPROMSettings settings;
+
+PROFILE_PROBE Profiler::probes[PROFILE_MAX_PROBES];
+int8_t Profiler::probeCount = 0;
+
+//the cycle counter is part of the debug unit and is off until something turns it on
+void Profiler::setup()
+{
+#if defined(__SAM3X8E__)
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+	reset();
+}
+
+//called once per PROFILE_SCOPE, the first time it runs. -1 if the table is full
+int8_t Profiler::addProbe(const char *name)
+{
+	if (probeCount >= PROFILE_MAX_PROBES) return -1;
+	probes[probeCount].name = name;
+	probes[probeCount].count = 0;
+	probes[probeCount].minTicks = 0xFFFFFFFF;
+	probes[probeCount].maxTicks = 0;
+	probes[probeCount].totalTicks = 0;
+	memset(probes[probeCount].histogram, 0, sizeof(probes[probeCount].histogram));
+	return probeCount++;
+}
+
+void Profiler::record(int8_t probe, uint32_t ticks)
+{
+	uint8_t bucket = 0;
+
+	if (probe < 0) return;
+	PROFILE_PROBE &p = probes[probe];
+	p.count++;
+	p.totalTicks += ticks;
+	if (ticks < p.minTicks) p.minTicks = ticks;
+	if (ticks > p.maxTicks) p.maxTicks = ticks;
+
+	if (ticks > 0) bucket = 31 - __builtin_clz(ticks);
+	if (bucket >= PROFILE_BUCKETS) bucket = PROFILE_BUCKETS - 1;
+	p.histogram[bucket]++;
+}
+
+/*
+One line of totals per probe in microseconds, then the histogram. Histogram entries are
+"2^n:count" where 2^n ticks is the bottom of the bucket. Empty buckets are left out.
+*/
+void Profiler::printStats()
+{
+	char buff[100];
+
+	if (probeCount == 0)
+	{
+		Logger::console("No profile probes have run%s", CFG_PROFILE ? "" : " (compiled out, see CFG_PROFILE)");
+		return;
+	}
+
+	SerialUSB.println("Probe           count  min us  avg us  max us");
+	for (int x = 0; x < probeCount; x++)
+	{
+		PROFILE_PROBE &p = probes[x];
+		if (p.count == 0) continue;
+		sprintf(buff, "%-12s %8lu %7lu %7lu %7lu", p.name, (unsigned long)p.count,
+			(unsigned long)(p.minTicks / PROFILE_TICKS_PER_US),
+			(unsigned long)(p.totalTicks / p.count / PROFILE_TICKS_PER_US),
+			(unsigned long)(p.maxTicks / PROFILE_TICKS_PER_US));
+		SerialUSB.println(buff);
+		SerialUSB.print("  ");
+		for (int b = 0; b < PROFILE_BUCKETS; b++)
+		{
+			if (p.histogram[b] == 0) continue;
+			sprintf(buff, " 2^%i:%lu", b, (unsigned long)p.histogram[b]);
+			SerialUSB.print(buff);
+		}
+		SerialUSB.println();
+	}
+}
+
+void Profiler::reset()
+{
+	for (int x = 0; x < probeCount; x++)
+	{
+		probes[x].count = 0;
+		probes[x].minTicks = 0xFFFFFFFF;
+		probes[x].maxTicks = 0;
+		probes[x].totalTicks = 0;
+		memset(probes[x].histogram, 0, sizeof(probes[x].histogram));
+	}
+}
+
+/*
+Answer a canbus profile query on base + 5, like the configuration replies.
+0x40 index      Reply 0x40, index, count (16 bit, saturates), avg us (16 bit), max us (16 bit).
+                index 0xFF (or past the end) gets 0x40, 0xFF, probe count
+0x41 index      Reply 0x41, index, first 6 characters of the probe name
+0x42            reset all probes. Reply 0x42
+*/
+void Profiler::sendProbe(uint8_t command, uint8_t index)
+{
+	CAN_FRAME frame;
+	uint32_t value;
+
+	frame.id = settings.bmsBaseAddress + 5;
+	frame.extended = (settings.bmsBaseAddress < 0x7E0) ? false : true;
+	frame.length = 8;
+	frame.rtr = 0;
+	frame.data.value = 0;
+	frame.data.bytes[0] = command;
+	frame.data.bytes[1] = index;
+
+	if (command == 0x42) reset();
+	else if (index >= probeCount)
+	{
+		frame.data.bytes[1] = 0xFF;
+		frame.data.bytes[2] = probeCount;
+	}
+	else if (command == 0x41)
+	{
+		//not a C string, the name is cut at 6 bytes and the rest of the payload is already zero
+		size_t length = strlen(probes[index].name);
+		memcpy(&frame.data.bytes[2], probes[index].name, (length < 6) ? length : 6);
+	}
+	else
+	{
+		PROFILE_PROBE &p = probes[index];
+		frame.data.s1 = (p.count > 0xFFFF) ? 0xFFFF : p.count;
+		value = p.count ? (uint32_t)(p.totalTicks / p.count / PROFILE_TICKS_PER_US) : 0;
+		frame.data.s2 = (value > 0xFFFF) ? 0xFFFF : value;
+		value = p.maxTicks / PROFILE_TICKS_PER_US;
+		frame.data.s3 = (value > 0xFFFF) ? 0xFFFF : value;
+	}
+	Can0.sendFrame(frame);
+}
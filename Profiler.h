@@ -0,0 +1,104 @@
+/*
+ * Profiler.h - Cycle counting probes around named pieces of code
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <Arduino.h>
+#include "config.h"
+
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+#define PROFILE_MAX_PROBES	16
+#define PROFILE_BUCKETS		24 //bucket n counts runs of 2^n to 2^(n+1) - 1 ticks. The last one takes everything longer
+
+/*
+Put PROFILE_SCOPE("name") at the top of a block and the time until the block ends is added
+to the probe with that name. On the Due a tick is one CPU cycle from the DWT cycle counter
+(84 per microsecond). On the host it is a nanosecond from hostProfileClock().
+With CFG_PROFILE set to 0 in config.h the probes are gone completely, not just turned off.
+*/
+#if defined(__SAM3X8E__)
+#define PROFILE_TICKS_PER_US	(F_CPU / 1000000)
+#else
+#define PROFILE_TICKS_PER_US	1000
+#endif
+
+#if CFG_PROFILE
+#define PROFILE_JOIN2(a, b)		a##b
+#define PROFILE_JOIN(a, b)		PROFILE_JOIN2(a, b)
+#define PROFILE_SCOPE(name) \
+	static int8_t PROFILE_JOIN(profileProbe, __LINE__) = Profiler::addProbe(name); \
+	ProfileScope PROFILE_JOIN(profileScope, __LINE__)(PROFILE_JOIN(profileProbe, __LINE__))
+#else
+#define PROFILE_SCOPE(name)
+#endif
+
+struct PROFILE_PROBE
+{
+	const char *name;
+	uint32_t count;
+	uint32_t minTicks;
+	uint32_t maxTicks;
+	uint64_t totalTicks;
+	uint32_t histogram[PROFILE_BUCKETS];
+};
+
+class Profiler
+{
+public:
+	static void setup();
+	static int8_t addProbe(const char *name);
+	static void record(int8_t probe, uint32_t ticks);
+	static void printStats();
+	static void reset();
+	static void sendProbe(uint8_t command, uint8_t index);
+
+	static inline uint32_t now()
+	{
+#if defined(__SAM3X8E__)
+		return DWT->CYCCNT;
+#else
+		return hostProfileClock();
+#endif
+	}
+
+private:
+	static PROFILE_PROBE probes[PROFILE_MAX_PROBES];
+	static int8_t probeCount;
+};
+
+//adds the time from construction to destruction to a probe
+class ProfileScope
+{
+public:
+	inline ProfileScope(int8_t probe) : probe(probe), start(Profiler::now()) {}
+	inline ~ProfileScope() { Profiler::record(probe, Profiler::now() - start); }
+
+private:
+	int8_t probe;
+	uint32_t start;
+};
+
+#endif
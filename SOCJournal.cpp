@@ -0,0 +1,142 @@
+/*
+ * SOCJournal.cpp - Append only record of the pack amp hours so the state of charge
+ * survives a power cycle without rewriting the whole settings struct
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include "SOCJournal.h"
+#include "TelemetryFormat.h"
+
+extern EEPROMSettings settings;
+
+SOCJournal *SOCJournal::instance = NULL;
+
+SOCJournal::SOCJournal()
+{
+	sequence = 0;
+	slot = SOC_JOURNAL_RECORDS - 1; //so the first record goes in slot 0
+	lastAH = 0;
+	lastSave = 0;
+}
+
+SOCJournal *SOCJournal::getInstance()
+{
+	if (instance == NULL)
+	{
+		instance = new SOCJournal();
+	}
+	return instance;
+}
+
+/*
+Find the newest good record and use its amp hours. The copy in the settings struct only gets
+saved when a setting changes so the journal is always at least as new. Returns false if the
+journal is empty, in which case settings.currentPackAH is left as it was.
+*/
+bool SOCJournal::setup()
+{
+	SOC_RECORD record;
+	bool found = false;
+
+	for (uint16_t x = 0; x < SOC_JOURNAL_RECORDS; x++)
+	{
+		EEPROM.read(EE_SOCJOURNAL_ADDR + x * sizeof(SOC_RECORD), record);
+		if (!validRecord(record)) continue;
+		if (!found || (int32_t)(record.sequence - sequence) > 0)
+		{
+			found = true;
+			sequence = record.sequence;
+			slot = x;
+			lastAH = record.currentPackAH;
+		}
+	}
+
+	lastSave = millis();
+	if (!found)
+	{
+		lastAH = settings.currentPackAH;
+		return false;
+	}
+	settings.currentPackAH = lastAH;
+	Logger::info("Restored pack AH from SOC journal record %l", sequence);
+	return true;
+}
+
+/*
+For when the settings went back to defaults. The records belong to whatever pack the old
+settings described, so instead of restoring from them write one that supersedes them all
+with the amp hours the settings have now.
+*/
+void SOCJournal::reset()
+{
+	uint32_t packAH = settings.currentPackAH;
+
+	setup(); //finds the newest record so the next one goes after it
+	settings.currentPackAH = packAH;
+	save();
+	Logger::info("SOC journal reset");
+}
+
+//write a record if the amp hours have moved far enough since the last one
+void SOCJournal::loop()
+{
+	uint32_t moved;
+
+	if ((millis() - lastSave) < SOC_JOURNAL_INTERVAL) return;
+	lastSave = millis();
+	moved = (settings.currentPackAH > lastAH) ? settings.currentPackAH - lastAH : lastAH - settings.currentPackAH;
+	if (moved >= SOC_JOURNAL_MIN_CHANGE) save();
+}
+
+//write a record right now. For when the AH count was set rather than counted.
+void SOCJournal::save()
+{
+	PROFILE_SCOPE("eeJournal");
+	SOC_RECORD record;
+
+	sequence++;
+	if (sequence == 0xFFFFFFFF) sequence = 1;
+	slot = (slot + 1) % SOC_JOURNAL_RECORDS;
+
+	record.sequence = sequence;
+	record.currentPackAH = settings.currentPackAH;
+	record.uptime = millis() / 1000;
+	record.reserved = 0;
+	record.crc = telemCrc16((uint8_t *)&record, sizeof(SOC_RECORD) - 2);
+	EEPROM.write(EE_SOCJOURNAL_ADDR + slot * sizeof(SOC_RECORD), record);
+
+	lastAH = record.currentPackAH;
+	lastSave = millis();
+}
+
+uint32_t SOCJournal::getSequence()
+{
+	return sequence;
+}
+
+bool SOCJournal::validRecord(SOC_RECORD &record)
+{
+	if (record.sequence == 0 || record.sequence == 0xFFFFFFFF) return false;
+	return record.crc == telemCrc16((uint8_t *)&record, sizeof(SOC_RECORD) - 2);
+}
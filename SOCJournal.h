@@ -0,0 +1,79 @@
+/*
+ * SOCJournal.h - Append only record of the pack amp hours so the state of charge
+ * survives a power cycle without rewriting the whole settings struct
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <Arduino.h>
+#include <Wire_EEPROM.h>
+#include "Logger.h"
+#include "config.h"
+#include "Profiler.h"
+
+#ifndef SOCJOURNAL_H_
+#define SOCJOURNAL_H_
+
+#define SOC_JOURNAL_RECORDS		256 //16 bytes each, 4K of EEPROM
+#define SOC_JOURNAL_INTERVAL	30000 //ms between records while the AH count is changing
+#define SOC_JOURNAL_MIN_CHANGE	1000000 //0.1AH in settings.currentPackAH units. Smaller moves wait
+
+/*
+Each record goes in the slot after the previous one so every slot only gets written once
+per trip around the ring. Records are 16 bytes so one never crosses an EEPROM page, and
+the four records in a 64 byte page cost that page four write cycles per trip. At one
+record every 30 seconds that is a cycle every 32 minutes, so a 1M cycle part lasts over
+60 years of the AH count moving non stop. A power loss costs at most 30 seconds or 0.1AH
+of counting.
+*/
+struct SOC_RECORD
+{
+	uint32_t sequence; //one higher than the previous record. 0 and 0xFFFFFFFF are never used
+	uint32_t currentPackAH; //same units as settings.currentPackAH
+	uint32_t uptime; //seconds since power up when this was written
+	uint16_t reserved;
+	uint16_t crc; //CRC16 of the first 14 bytes
+};
+
+class SOCJournal
+{
+public:
+	SOCJournal();
+	static SOCJournal *getInstance();
+	bool setup();
+	void reset();
+	void loop();
+	void save();
+	uint32_t getSequence();
+
+private:
+	static SOCJournal *instance;
+	uint32_t sequence; //of the newest record
+	uint16_t slot; //of the newest record
+	uint32_t lastAH; //what the newest record holds
+	uint32_t lastSave;
+
+	static bool validRecord(SOC_RECORD &record);
+};
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * Scheduler.cpp - Runs the periodic jobs from one timer tick and keeps timing stats on them
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include "Scheduler.h"
+#include "Logger.h"
+
+Scheduler *Scheduler::instance = NULL;
+volatile uint32_t schedTicks = 0;
+volatile uint16_t schedTickStep = 1; //ticks each Timer3 interrupt stands for
+
+void schedTickBounce()
+{
+	schedTicks += schedTickStep;
+}
+
+Scheduler::Scheduler()
+{
+	taskCount = 0;
+}
+
+Scheduler *Scheduler::getInstance()
+{
+	if (instance == NULL)
+	{
+		instance = new Scheduler();
+	}
+	return instance;
+}
+
+void Scheduler::setup()
+{
+	Timer3.attachInterrupt(schedTickBounce);
+	Timer3.start(SCHED_TICK_US);
+}
+
+/*
+Add a periodic task. offset delays the first release so tasks with the same period don't
+all land on the same tick. Returns the task number or -1 if the table is full.
+*/
+int Scheduler::addTask(const char *name, void (*run)(), uint16_t period, uint16_t deadline, uint8_t priority, uint16_t offset)
+{
+	if (taskCount >= SCHED_MAX_TASKS || period == 0)
+	{
+		Logger::error("Can't add task %s", name);
+		return -1;
+	}
+
+	SCHED_TASK &task = tasks[taskCount];
+
+	task.name = name;
+	task.run = run;
+	task.period = period;
+	task.deadline = deadline;
+	task.priority = priority;
+	task.release = schedTicks + offset;
+	taskCount++;
+	resetStats();
+	return taskCount - 1;
+}
+
+/*
+Run everything that is due, most important first. Each task runs at most once per call.
+Returns false if nothing was due.
+*/
+bool Scheduler::loop()
+{
+	uint32_t ran = 0;
+	int best;
+
+	while (true)
+	{
+		best = -1;
+		for (int x = 0; x < taskCount; x++)
+		{
+			if ((ran & (1ul << x)) || (int32_t)(schedTicks - tasks[x].release) < 0) continue;
+			if (best < 0 || tasks[x].priority < tasks[best].priority) best = x;
+		}
+		if (best < 0) return (ran != 0);
+		ran |= (1ul << best);
+		runTask(tasks[best]);
+	}
+}
+
+//change how often a task runs. Takes effect from its next release.
+void Scheduler::setPeriod(int task, uint16_t period)
+{
+	if (task < 0 || task >= taskCount || period == 0) return;
+	tasks[task].period = period;
+}
+
+/*
+Have Timer3 interrupt once every so many ticks instead of every tick, each interrupt moving
+the count on by that many. Task times stay in ms but a release can be up to ticks - 1 late,
+and the CPU only wakes that often when nothing else is going on.
+*/
+void Scheduler::setTickLength(uint16_t ticks)
+{
+	if (ticks == 0) ticks = 1;
+	if (ticks == schedTickStep) return;
+	Timer3.stop();
+	schedTickStep = ticks;
+	Timer3.start(SCHED_TICK_US * (long)ticks);
+}
+
+uint32_t Scheduler::getTicks()
+{
+	return schedTicks;
+}
+
+//ticks until the next release, 0 if something is due now. Lets an idle loop know how long it could sleep.
+uint32_t Scheduler::getIdleTicks()
+{
+	uint32_t idle = UINT32_MAX;
+	int32_t wait;
+
+	for (int x = 0; x < taskCount; x++)
+	{
+		wait = (int32_t)(tasks[x].release - schedTicks);
+		if (wait <= 0) return 0;
+		if ((uint32_t)wait < idle) idle = wait;
+	}
+	return idle;
+}
+
+void Scheduler::printStats()
+{
+	SerialUSB.println("Task        period prio    runs    late skipped maxjit  avg us  max us");
+	for (int x = 0; x < taskCount; x++)
+	{
+		char buff[90];
+		SCHED_TASK &task = tasks[x];
+		sprintf(buff, "%-10s %7u %4u %7lu %7lu %7lu %6lu %7lu %7lu", task.name, task.period, task.priority,
+			(unsigned long)task.runs, (unsigned long)task.overruns, (unsigned long)task.skipped, (unsigned long)task.maxJitter,
+			(unsigned long)(task.runs ? task.totalTime / task.runs : 0), (unsigned long)task.maxTime);
+		SerialUSB.println(buff);
+	}
+}
+
+void Scheduler::resetStats()
+{
+	for (int x = 0; x < taskCount; x++)
+	{
+		tasks[x].runs = 0;
+		tasks[x].overruns = 0;
+		tasks[x].skipped = 0;
+		tasks[x].maxJitter = 0;
+		tasks[x].totalTime = 0;
+		tasks[x].maxTime = 0;
+	}
+}
+
+void Scheduler::runTask(SCHED_TASK &task)
+{
+	uint32_t jitter = schedTicks - task.release;
+	uint32_t start = micros();
+	uint32_t elapsed, late;
+
+	task.run();
+
+	elapsed = micros() - start;
+	task.runs++;
+	task.totalTime += elapsed;
+	if (elapsed > task.maxTime) task.maxTime = elapsed;
+	if (jitter > task.maxJitter) task.maxJitter = jitter;
+	if ((schedTicks - task.release) > task.deadline) task.overruns++;
+
+	//keep the original phase. If more than one release has gone by only the newest one is kept.
+	task.release += task.period;
+	late = schedTicks - task.release;
+	if ((int32_t)late >= (int32_t)task.period)
+	{
+		task.skipped += late / task.period;
+		task.release += (late / task.period) * task.period;
+	}
+}
@@ -0,0 +1,83 @@
+/*
+ * Scheduler.h - Runs the periodic jobs from one timer tick and keeps timing stats on them
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <Arduino.h>
+#include <DueTimer.h>
+
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#define SCHED_MAX_TASKS		12
+#define SCHED_TICK_US		1000 //Timer3 period. All task times are in these ticks (ms)
+
+/*
+Cooperative. The timer interrupt only counts ticks. loop() runs whatever is due, most important
+first, and each task runs to completion. A task that is still waiting when its next release
+comes along loses that release (counted as skipped) instead of running twice back to back.
+Things that have to be polled as fast as possible (serial, canbus reception, SD card) are
+not tasks, they stay in the main loop.
+*/
+struct SCHED_TASK
+{
+	const char *name;
+	void (*run)();
+	uint16_t period; //ticks between releases
+	uint16_t deadline; //ticks after release it has to be done by
+	uint8_t priority; //0 runs first when several are due
+
+	uint32_t release; //tick the pending run was due
+	uint32_t runs;
+	uint32_t overruns; //runs that finished after the deadline
+	uint32_t skipped; //releases lost because the task hadn't got to run yet
+	uint32_t maxJitter; //ticks from release to start, worst seen
+	uint32_t totalTime; //microseconds spent running
+	uint32_t maxTime; //microseconds, longest single run
+};
+
+class Scheduler
+{
+public:
+	Scheduler();
+	static Scheduler *getInstance();
+	void setup();
+	int addTask(const char *name, void (*run)(), uint16_t period, uint16_t deadline, uint8_t priority, uint16_t offset = 0);
+	bool loop();
+	void setPeriod(int task, uint16_t period);
+	void setTickLength(uint16_t ticks);
+	uint32_t getTicks();
+	uint32_t getIdleTicks();
+	void printStats();
+	void resetStats();
+
+private:
+	static Scheduler *instance;
+	SCHED_TASK tasks[SCHED_MAX_TASKS];
+	int taskCount;
+
+	void runTask(SCHED_TASK &task);
+};
+
+#endif
@@ -0,0 +1,48 @@
+/*
+ * SdCard.h - Minimal block device interface used by the SD card data logger.
+ * The firmware uses HsmciCard, host builds use a file backed image instead.
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stdint.h>
+
+#ifndef SDCARD_H_
+#define SDCARD_H_
+
+#define SD_BLOCK_SIZE	512
+
+class SdCard
+{
+public:
+	virtual ~SdCard() {}
+	virtual bool begin() = 0; //bring up the card. Only called from setup() so it may block
+	virtual uint32_t getBlockCount() = 0;
+	virtual bool readBlock(uint32_t block, uint8_t *data) = 0; //blocking. Only used at start up
+	//start writing one block and return right away. data must stay untouched until isBusy() is false
+	virtual bool startWrite(uint32_t block, const uint8_t *data) = 0;
+	virtual bool isBusy() = 0; //true while the last write is still going
+	virtual bool hadError() = 0; //true if the last write failed
+};
+
+#endif
@@ -34,6 +34,15 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "Wire_EEPROM.h"
 #include "i2c_adc.h"
 #include "CanbusHandler.h"
+#include "Telemetry.h"
+#include "Parameters.h"
+#include "Scheduler.h"
+#include "Profiler.h"
+#include "PowerManager.h"
+#include "Watchdog.h"
+#include "Benchmark.h"
+
+#define CONSOLE_BUFFER_SIZE	80 //longest line is one less, for the terminator
 
 class SerialConsole {
 public:
@@ -43,37 +52,33 @@ public:
 	bool rcvCharacter(uint8_t chr);
 
 protected:
+	//every state waits for the next line. Nothing in here ever blocks.
 	enum CONSOLE_STATE
 	{
-		STATE_ROOT_MENU, 
-		STATE_GET_CANBUSRATE,
-		STATE_GET_CANTERM,
-		STATE_GET_CAB300,
-		STATE_GET_BALANCE,
-		STATE_GET_LOWV,
-		STATE_GET_HIGHV,
-		STATE_GET_LOWT,
-		STATE_GET_HIGHT,
-		STATE_GET_QUAD1,
-		STATE_GET_QUAD2,
-		STATE_GET_QUAD3,
-		STATE_GET_QUAD4,
-		STATE_GET_MAXAH,
-		STATE_GET_CURRAH
+		STATE_ROOT_MENU,
+		STATE_WIZARD, //InitialConfig() questions, wizardStep says which one
+		STATE_CALIBRATE, //vCalibrate(), calibrateQuad says which one
+		STATE_IMPORT //lines of an export until #END
 	};
 
 private:
-	char cmdBuffer[80];
+	char cmdBuffer[CONSOLE_BUFFER_SIZE];
 	int ptrBuffer;
 	int state;
+	uint8_t wizardStep;
+	uint8_t calibrateQuad;
     
     void init();
 	void handleConsoleCmd();
 	void handleShortCmd();
     void handleConfigCmd();
+	bool setParameter(const PARAM_DESC *param, char *value);
 	void vCalibrate();
-	void getReply();
-	void appendCmd(String cmd);
+	void calibrateReply();
+	void askCalibrate();
+	void wizardReply();
+	void importReply();
+	void askWizard();
 };
 
 #endif /* SERIALCONSOLE_H_ */
@@ -0,0 +1,96 @@
+/*
+ * SettingsMigration.cpp - Brings settings saved by older firmware up to the current layout
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include "SettingsMigration.h"
+
+#if BMS_NUM_CHANNELS == 4
+//13 to 14 - binary logging became a saved setting. Old units keep logging text.
+static void upgradeTo14(uint8_t *image)
+{
+	image[offsetof(EEPROMSettings, logBinary)] = 0;
+	image[offsetof(EEPROMSettings, version)] = 14;
+}
+#endif
+
+/*
+Builds with expansion boards have bigger per channel arrays, so nothing a plain board wrote
+lines up with them. They only know the current layout and anything else gets defaults.
+*/
+static const SETTINGS_LAYOUT layouts[] =
+{
+#if BMS_NUM_CHANNELS == 4
+	{ 13, 148, upgradeTo14 },
+#endif
+	{ 14, sizeof(EEPROMSettings), NULL }
+};
+
+#define LAYOUT_COUNT	(sizeof(layouts) / sizeof(layouts[0]))
+
+#if BMS_NUM_CHANNELS == 4
+static_assert(offsetof(EEPROMSettings, logBinary) == 148, "version 14 added logBinary right after the version 13 fields");
+#endif
+static_assert(sizeof(EEPROMSettings) <= SETTINGS_MAX_LENGTH, "settings no longer fit in a slot");
+
+/*
+Upgrade a settings image in place. image must have room for SETTINGS_MAX_LENGTH bytes and
+length is how much of it was loaded. Returns false if the version is unknown (newer firmware
+wrote it, or it isn't settings at all) or the length doesn't match what that version used.
+The caller falls back to defaults then.
+*/
+bool SettingsMigration::upgrade(uint8_t *image, uint16_t &length)
+{
+	const SETTINGS_LAYOUT *layout = find(image[offsetof(EEPROMSettings, version)]);
+
+	if (layout == NULL || layout->length != length) return false;
+
+	while (layout->upgrade != NULL)
+	{
+		const SETTINGS_LAYOUT *next = layout + 1;
+		if (next->length > length) memset(image + length, 0, next->length - length);
+		layout->upgrade(image);
+		length = next->length;
+		layout = next;
+	}
+	return layout->version == CFG_EEPROM_VER;
+}
+
+//how long settings of the given version are. 0 if it isn't a version this firmware knows
+uint16_t SettingsMigration::getLength(uint8_t version)
+{
+	const SETTINGS_LAYOUT *layout = find(version);
+	return (layout == NULL) ? 0 : layout->length;
+}
+
+const SETTINGS_LAYOUT *SettingsMigration::find(uint8_t version)
+{
+	for (unsigned int x = 0; x < LAYOUT_COUNT; x++)
+	{
+		if (layouts[x].version == version) return &layouts[x];
+	}
+	return NULL;
+}
@@ -0,0 +1,65 @@
+/*
+ * SettingsMigration.h - Brings settings saved by older firmware up to the current layout
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <stdint.h>
+#include "config.h"
+
+#ifndef SETTINGSMIGRATION_H_
+#define SETTINGSMIGRATION_H_
+
+/*
+Every layout EEPROMSettings has had gets an entry in the table in SettingsMigration.cpp,
+oldest first, ending with CFG_EEPROM_VER. An entry knows how long that layout was and how
+to turn it into the next one. Loading old settings runs the steps one after another until
+the image is current, so a unit that skipped a few updates still keeps its calibration.
+
+When adding a field: put it at the end of EEPROMSettings, bump CFG_EEPROM_VER, give the
+old version its real length and an upgrade function that fills in the new field.
+*/
+struct SETTINGS_LAYOUT
+{
+	uint8_t version;
+	uint16_t length; //sizeof(EEPROMSettings) as that version had it
+	void (*upgrade)(uint8_t *image); //fill in what the next version added and set its version. NULL for the current one
+};
+
+#if BMS_NUM_CHANNELS > 4
+#define SETTINGS_MAX_LENGTH	496
+#else
+#define SETTINGS_MAX_LENGTH	240 //room in a settings slot, and the most any layout can ever take
+#endif
+
+class SettingsMigration
+{
+public:
+	static bool upgrade(uint8_t *image, uint16_t &length);
+	static uint16_t getLength(uint8_t version);
+
+private:
+	static const SETTINGS_LAYOUT *find(uint8_t version);
+};
+
+#endif
@@ -0,0 +1,217 @@
+/*
+ * SettingsStore.cpp - Keeps two CRC protected copies of the settings in EEPROM and
+ * updates them a few bytes at a time from the main loop
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include "SettingsStore.h"
+#include "TelemetryFormat.h"
+#include "SettingsMigration.h"
+
+extern EEPROMSettings settings;
+
+SettingsStore *SettingsStore::instance = NULL;
+
+SettingsStore::SettingsStore()
+{
+	generation = 0;
+	current = 1; //so the first save goes into slot 0
+	writing = false;
+	saveRequested = false;
+	cursor = 0;
+	lastWrite = 0;
+}
+
+SettingsStore *SettingsStore::getInstance()
+{
+	if (instance == NULL)
+	{
+		instance = new SettingsStore();
+	}
+	return instance;
+}
+
+/*
+Fill in settings from the newest good slot, upgrading them first if older firmware wrote them.
+If neither slot is good the settings are read from address 0 where older firmware kept them
+and written into the slots right away. Returns false if nothing usable was found, including
+settings from a version this firmware doesn't know. The caller then sets defaults and saves.
+*/
+bool SettingsStore::load()
+{
+	uint8_t image[2][SETTINGS_MAX_LENGTH];
+	uint16_t length[2];
+	uint32_t gen[2];
+	bool good[2];
+	uint8_t oldVersion;
+
+	good[0] = readSlot(0, image[0], length[0], gen[0]);
+	good[1] = readSlot(1, image[1], length[1], gen[1]);
+
+	if (good[0] || good[1])
+	{
+		if (good[0] && good[1]) current = ((int32_t)(gen[1] - gen[0]) > 0) ? 1 : 0;
+		else current = good[0] ? 0 : 1;
+		generation = gen[current];
+
+		oldVersion = image[current][0];
+		if (!SettingsMigration::upgrade(image[current], length[current])) return false;
+		memcpy(&settings, image[current], sizeof(EEPROMSettings));
+		if (oldVersion != CFG_EEPROM_VER)
+		{
+			//goes into the other slot so the old copy stays put until this one is whole
+			Logger::info("Settings upgraded from version %i to %i", oldVersion, CFG_EEPROM_VER);
+			save();
+		}
+		return true;
+	}
+
+	EEPROM.read(0, image[0]);
+	oldVersion = image[0][0];
+	length[0] = SettingsMigration::getLength(oldVersion);
+	if (length[0] == 0 || !SettingsMigration::upgrade(image[0], length[0])) return false;
+	memcpy(&settings, image[0], sizeof(EEPROMSettings));
+	if (settings.valid != 0xDE) return false;
+	Logger::info("Moving version %i settings from the old location into the A/B store", oldVersion);
+	save();
+	flush();
+	return true;
+}
+
+/*
+Ask for the current settings to be saved. Nothing is written here, loop() does that a chunk
+at a time. Calling this again while a save is going just means another save afterward.
+*/
+void SettingsStore::save()
+{
+	if (writing) saveRequested = true;
+	else startWrite();
+}
+
+void SettingsStore::loop()
+{
+	if (!writing || (millis() - lastWrite) < SETTINGS_WRITE_GAP) return;
+	lastWrite = millis();
+	if (writeChunk()) return;
+
+	//that was the header. The other slot is now the current one.
+	writing = false;
+	current ^= 1;
+	generation++;
+	if (saveRequested)
+	{
+		saveRequested = false;
+		startWrite();
+	}
+}
+
+//finish any save in progress. Blocks, only for start up and before a reset.
+void SettingsStore::flush()
+{
+	while (writing)
+	{
+		loop();
+	}
+}
+
+bool SettingsStore::isBusy()
+{
+	return writing;
+}
+
+uint32_t SettingsStore::getGeneration()
+{
+	return generation;
+}
+
+uint16_t SettingsStore::getCrc(const uint8_t *body, uint16_t length, uint32_t gen)
+{
+	uint16_t crc = telemCrc16(body, length);
+	return telemCrc16Update(crc, (const uint8_t *)&gen, 4);
+}
+
+/*
+Read a whole slot into image and check it. The length in the header is whatever the firmware
+that wrote it used, so it can be shorter than EEPROMSettings is now.
+*/
+bool SettingsStore::readSlot(uint8_t slot, uint8_t *image, uint16_t &length, uint32_t &gen)
+{
+	SETTINGS_HEADER header;
+	uint32_t base = EE_SETTINGS_ADDR + slot * SETTINGS_SLOT_SIZE;
+
+	EEPROM.read(base, header);
+	for (uint16_t x = 0; x < SETTINGS_MAX_LENGTH; x++) image[x] = EEPROM.read(base + SETTINGS_BODY_OFFSET + x);
+	memcpy(&slotImage[slot], image, sizeof(EEPROMSettings)); //what is really there, for the next save
+	length = header.length;
+	gen = header.generation;
+	if (header.magic != SETTINGS_MAGIC || length == 0 || length > SETTINGS_MAX_LENGTH) return false;
+	return header.crc == getCrc(image, length, header.generation);
+}
+
+void SettingsStore::startWrite()
+{
+	pending = settings; //later changes wait for the next save so this copy can't tear
+	cursor = 0;
+	writing = true;
+}
+
+/*
+Write the next run of bytes that differ between pending and what the target slot holds.
+Returns false once there was nothing left to write and the header went out instead.
+*/
+bool SettingsStore::writeChunk()
+{
+	PROFILE_SCOPE("eeSettings");
+	uint8_t target = current ^ 1;
+	uint32_t base = EE_SETTINGS_ADDR + target * SETTINGS_SLOT_SIZE;
+	uint8_t *want = (uint8_t *)&pending;
+	uint8_t *have = (uint8_t *)&slotImage[target];
+	uint16_t start, end, pageEnd;
+	SETTINGS_HEADER header;
+
+	while (cursor < sizeof(EEPROMSettings) && want[cursor] == have[cursor]) cursor++;
+	if (cursor < sizeof(EEPROMSettings))
+	{
+		start = cursor;
+		pageEnd = ((SETTINGS_BODY_OFFSET + start) / SETTINGS_PAGE + 1) * SETTINGS_PAGE - SETTINGS_BODY_OFFSET;
+		end = start + SETTINGS_CHUNK;
+		if (end > pageEnd) end = pageEnd;
+		if (end > sizeof(EEPROMSettings)) end = sizeof(EEPROMSettings);
+		for (uint16_t x = start; x < end; x++)
+		{
+			EEPROM.write(base + SETTINGS_BODY_OFFSET + x, want[x]);
+			have[x] = want[x];
+		}
+		cursor = end;
+		return true;
+	}
+
+	header.magic = SETTINGS_MAGIC;
+	header.length = sizeof(EEPROMSettings);
+	header.generation = generation + 1;
+	header.crc = getCrc((const uint8_t *)&pending, sizeof(EEPROMSettings), header.generation);
+	header.reserved = 0;
+	EEPROM.write(base, header);
+	return false;
+}
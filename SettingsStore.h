@@ -0,0 +1,94 @@
+/*
+ * SettingsStore.h - Keeps two CRC protected copies of the settings in EEPROM and
+ * updates them a few bytes at a time from the main loop
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <Arduino.h>
+#include <Wire_EEPROM.h>
+#include "Logger.h"
+#include "config.h"
+#include "Profiler.h"
+
+#ifndef SETTINGSSTORE_H_
+#define SETTINGSSTORE_H_
+
+#define SETTINGS_MAGIC			0x5354 //"ST"
+#if BMS_NUM_CHANNELS > 4
+#define SETTINGS_SLOT_SIZE		0x200 //expansion boards bring their own calibration along
+#else
+#define SETTINGS_SLOT_SIZE		0x100 //header plus settings, per copy. Leaves SETTINGS_MAX_LENGTH for settings
+#endif
+#define SETTINGS_BODY_OFFSET	16 //settings start this far into a slot
+#define SETTINGS_CHUNK			16 //most bytes written per call to loop()
+#define SETTINGS_PAGE			64 //EEPROM page size. A chunk never crosses a page
+#define SETTINGS_WRITE_GAP		6 //ms to leave between chunks so the EEPROM write cycle is done
+
+/*
+There are two slots, at EE_SETTINGS_ADDR and EE_SETTINGS_ADDR + SETTINGS_SLOT_SIZE.
+A save goes into the slot that isn't current. Only the bytes that differ from what that slot
+already holds get written. The header goes in last with the next generation number and
+that is the commit: until the header is written the slot still fails its CRC (or has the
+older generation) so a brown out part way through leaves the other copy in charge.
+At start up the valid slot with the highest generation wins.
+*/
+struct SETTINGS_HEADER
+{
+	uint16_t magic;
+	uint16_t length; //sizeof(EEPROMSettings) when it was written
+	uint32_t generation;
+	uint16_t crc; //CRC16 of the settings bytes then the generation
+	uint16_t reserved;
+};
+
+class SettingsStore
+{
+public:
+	SettingsStore();
+	static SettingsStore *getInstance();
+	bool load();
+	void save();
+	void loop();
+	void flush();
+	bool isBusy();
+	uint32_t getGeneration();
+
+private:
+	static SettingsStore *instance;
+	EEPROMSettings slotImage[2]; //what is in each slot right now
+	EEPROMSettings pending; //what is being written
+	uint32_t generation; //of the current slot
+	uint8_t current; //slot that holds the newest settings
+	bool writing; //pending is going into the other slot
+	bool saveRequested; //settings changed again while writing
+	uint16_t cursor; //where to look for the next changed byte
+	uint32_t lastWrite;
+
+	static uint16_t getCrc(const uint8_t *body, uint16_t length, uint32_t gen);
+	bool readSlot(uint8_t slot, uint8_t *image, uint16_t &length, uint32_t &gen);
+	void startWrite();
+	bool writeChunk();
+};
+
+#endif
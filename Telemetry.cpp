@@ -0,0 +1,160 @@
+/*
+ * Telemetry.cpp - Framed binary stream of pack measurements for live plotting on a PC
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include "Telemetry.h"
+#include "i2c_adc.h"
+#include "ChargeRecorder.h"
+
+extern EEPROMSettings settings;
+extern STATUS status;
+
+Telemetry *Telemetry::instance = NULL;
+
+Telemetry::Telemetry()
+{
+	subscribed = 0;
+	sequence = 0;
+	dropped = 0;
+}
+
+Telemetry *Telemetry::getInstance()
+{
+	if (instance == NULL)
+	{
+		instance = new Telemetry();
+	}
+	return instance;
+}
+
+void Telemetry::subscribe(uint8_t streams)
+{
+	subscribed |= streams & ((1 << TELEM_STREAM_COUNT) - 1);
+}
+
+void Telemetry::unsubscribe(uint8_t streams)
+{
+	subscribed &= ~streams;
+}
+
+uint8_t Telemetry::getSubscribed()
+{
+	return subscribed;
+}
+
+uint32_t Telemetry::getDroppedCount()
+{
+	return dropped;
+}
+
+void Telemetry::sendSample(uint8_t channel, int16_t raw, int16_t filtered)
+{
+	TELEM_SAMPLE sample;
+
+	if (!isSubscribed(TELEM_STREAM_SAMPLE)) return;
+	sample.channel = channel;
+	sample.raw = raw;
+	sample.filtered = filtered;
+	send(TELEM_STREAM_SAMPLE, &sample, sizeof(sample));
+}
+
+void Telemetry::sendCurrent(int32_t milliAmps)
+{
+	TELEM_CURRENT current;
+
+	if (!isSubscribed(TELEM_STREAM_CURRENT)) return;
+	current.milliAmps = milliAmps;
+	send(TELEM_STREAM_CURRENT, &current, sizeof(current));
+}
+
+//called after each fault check, once the next voltage and thermistor channel have been read
+void Telemetry::sendScan()
+{
+	ADCClass *adc = ADCClass::getInstance();
+
+	if (isSubscribed(TELEM_STREAM_QUADS))
+	{
+		TELEM_QUADS quads;
+		for (int x = 0; x < 4; x++)
+		{
+			quads.volts[x] = adc->getVoltage(x);
+			quads.temps[x] = adc->getTemperature(x);
+		}
+		send(TELEM_STREAM_QUADS, &quads, sizeof(quads));
+	}
+
+#if BMS_NUM_CHANNELS > 4
+	if (isSubscribed(TELEM_STREAM_CHANNELS))
+	{
+		TELEM_CHANNELS channels;
+		for (int group = 1; group < BMS_CHANNEL_GROUPS; group++)
+		{
+			channels.group = group;
+			for (int x = 0; x < 4; x++)
+			{
+				channels.volts[x] = adc->getVoltage(group * 4 + x);
+				channels.temps[x] = adc->getTemperature(group * 4 + x);
+			}
+			send(TELEM_STREAM_CHANNELS, &channels, sizeof(channels));
+		}
+	}
+#endif
+
+	if (isSubscribed(TELEM_STREAM_STATUS))
+	{
+		TELEM_STATUS stat;
+		stat.packVolts = adc->getPackVoltage();
+		stat.currentPackAH = settings.currentPackAH;
+		stat.soc = ChargeRecorder::getSOC();
+		stat.status = status.value;
+		send(TELEM_STREAM_STATUS, &stat, sizeof(stat));
+	}
+}
+
+/*
+Frames go into the same ring buffer as the log so they never hold up the loop waiting on USB.
+If the ring is full the frame is lost. The sequence number still moves on so the host sees the gap.
+*/
+void Telemetry::send(uint8_t stream, const void *payload, uint8_t length)
+{
+	uint8_t frame[TELEM_HEADER + TELEM_MAX_PAYLOAD + 2];
+	uint32_t now = millis();
+	uint16_t crc;
+
+	frame[0] = TELEM_SYNC;
+	frame[1] = TELEM_RECORD;
+	frame[2] = stream;
+	frame[3] = length;
+	frame[4] = sequence & 0xFF;
+	frame[5] = sequence >> 8;
+	for (int i = 0; i < 4; i++) frame[6 + i] = (now >> (8 * i)) & 0xFF;
+	memcpy(&frame[TELEM_HEADER], payload, length);
+	crc = telemCrc16(frame, TELEM_HEADER + length);
+	frame[TELEM_HEADER + length] = crc & 0xFF;
+	frame[TELEM_HEADER + length + 1] = crc >> 8;
+	sequence++;
+
+	if (!Logger::queueRaw(frame, TELEM_HEADER + length + 2)) dropped++;
+}
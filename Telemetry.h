@@ -0,0 +1,63 @@
+/*
+ * Telemetry.h - Framed binary stream of pack measurements for live plotting on a PC
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <Arduino.h>
+#include "Logger.h"
+#include "config.h"
+#include "TelemetryFormat.h"
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+class Telemetry
+{
+public:
+	Telemetry();
+	static Telemetry *getInstance();
+	void subscribe(uint8_t streams); //bitmask of (1 << TELEM_STREAM)
+	void unsubscribe(uint8_t streams);
+	uint8_t getSubscribed();
+	uint32_t getDroppedCount();
+	void sendSample(uint8_t channel, int16_t raw, int16_t filtered);
+	void sendCurrent(int32_t milliAmps);
+	void sendScan();
+
+	//cheap enough to call before building a frame in the hot paths
+	inline boolean isSubscribed(uint8_t stream)
+	{
+		return (subscribed & (1 << stream)) != 0;
+	}
+
+private:
+	static Telemetry *instance;
+	uint8_t subscribed;
+	uint16_t sequence;
+	uint32_t dropped;
+
+	void send(uint8_t stream, const void *payload, uint8_t length);
+};
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * TelemetryFormat.h - Layout of binary telemetry frames. Shared by the firmware
+ * and the host side decoder (host/tools/telemdecode.cpp) so keep it plain C.
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef TELEMETRYFORMAT_H_
+#define TELEMETRYFORMAT_H_
+
+#include <stdint.h>
+
+/*
+ * Telemetry frames share the serial stream with log output so they start with the
+ * same sync byte as binary log records and use their own record type.
+ * Multi byte values are little endian:
+ *
+ * byte 0       TELEM_SYNC
+ * byte 1       TELEM_RECORD
+ * byte 2       stream (TELEM_STREAM)
+ * byte 3       payload length
+ * bytes 4-5    sequence number. One counter for all streams so a gap means frames were lost
+ * bytes 6-9    millis() when the frame was made
+ * payload
+ * last 2 bytes CRC16 (telemCrc16()) of everything before it
+ */
+#define TELEM_SYNC			0xA5
+#define TELEM_RECORD		0x54
+#define TELEM_HEADER		10
+#define TELEM_MAX_PAYLOAD	48
+
+enum TELEM_STREAM
+{
+	TELEM_STREAM_SAMPLE = 0, //TELEM_SAMPLE for every ADC reading
+	TELEM_STREAM_QUADS = 1, //TELEM_QUADS after each full scan of the pack
+	TELEM_STREAM_CURRENT = 2, //TELEM_CURRENT for every CAB300 reading
+	TELEM_STREAM_STATUS = 3, //TELEM_STATUS after each full scan of the pack
+	TELEM_STREAM_CHANNELS = 4, //TELEM_CHANNELS per expansion board after each scan. Only builds with more than four channels
+	TELEM_STREAM_COUNT
+};
+
+//one ADS1110 reading. The first BMS_NUM_CHANNELS channels are voltages, the rest thermistors.
+//So with the plain board 0-3 are quad voltages and 4-7 are thermistors
+struct TELEM_SAMPLE
+{
+	uint8_t channel;
+	int16_t raw; //the reading as it came from the ADC
+	int16_t filtered; //running average over the last SAMPLES readings
+} __attribute__((packed));
+
+struct TELEM_QUADS
+{
+	float volts[4];
+	float temps[4]; //degrees C
+} __attribute__((packed));
+
+//TELEM_QUADS for channels 4 * group to 4 * group + 3
+struct TELEM_CHANNELS
+{
+	uint8_t group; //1 and up
+	float volts[4];
+	float temps[4];
+} __attribute__((packed));
+
+struct TELEM_CURRENT
+{
+	int32_t milliAmps; //positive is discharge
+} __attribute__((packed));
+
+struct TELEM_STATUS
+{
+	float packVolts;
+	uint32_t currentPackAH; //same units as settings.currentPackAH
+	uint8_t soc; //0 - 255 like BMS_STATUS_1
+	uint8_t status; //STATUS bitfield
+} __attribute__((packed));
+
+//CRC-16/CCITT-FALSE (poly 0x1021, starts at 0xFFFF). Update can be used to CRC data in pieces.
+static inline uint16_t telemCrc16Update(uint16_t crc, const uint8_t *data, uint16_t length)
+{
+	while (length--) {
+		crc ^= (uint16_t) *data++ << 8;
+		for (int i = 0; i < 8; i++) {
+			crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	}
+	return crc;
+}
+
+static inline uint16_t telemCrc16(const uint8_t *data, uint16_t length)
+{
+	return telemCrc16Update(0xFFFF, data, length);
+}
+
+#endif /* TELEMETRYFORMAT_H_ */
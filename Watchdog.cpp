@@ -0,0 +1,96 @@
+/*
+ * Watchdog.cpp - Only lets the hardware watchdog be kicked while every subsystem is still checking in
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include "Watchdog.h"
+#include "Logger.h"
+
+volatile uint32_t Watchdog::beats = 0;
+uint32_t Watchdog::lastStall = 0;
+uint32_t Watchdog::lastStallTime = 0;
+
+static const char *heartbeatNames[HB_COUNT] = { "ADC", "CAN", "CHARGER" };
+
+void watchdogCheckBounce()
+{
+	Watchdog::check();
+}
+
+/*
+The WDT itself is turned on by watchdogSetup() in bms.ino, which the core calls before setup().
+This picks up what the last stall left behind and starts the checks.
+*/
+void Watchdog::setup()
+{
+#if defined(__SAM3X8E__)
+	if ((RSTC->RSTC_SR & RSTC_SR_RSTTYP_Msk) == RSTC_SR_RSTTYP_WatchdogReset && (GPBR->SYS_GPBR[0] & 0xFFFF0000) == WATCHDOG_MAGIC)
+	{
+		lastStall = GPBR->SYS_GPBR[0] & 0xFFFF;
+		lastStallTime = GPBR->SYS_GPBR[1];
+		printStall();
+	}
+	GPBR->SYS_GPBR[0] = 0;
+	watchdogReset();
+#endif
+	beats = 0;
+	Timer4.attachInterrupt(watchdogCheckBounce);
+	Timer4.start(WATCHDOG_WINDOW * 1000ul);
+}
+
+void Watchdog::check()
+{
+#if defined(__SAM3X8E__)
+	uint32_t missing = ((1ul << HB_COUNT) - 1) & ~beats;
+
+	beats = 0;
+	if (missing == 0)
+	{
+		watchdogReset();
+		GPBR->SYS_GPBR[0] = 0; //it came back, whatever was missing before doesn't matter
+	}
+	else
+	{
+		GPBR->SYS_GPBR[0] = WATCHDOG_MAGIC | missing;
+		GPBR->SYS_GPBR[1] = millis();
+	}
+#else
+	beats = 0;
+#endif
+}
+
+void Watchdog::printStatus()
+{
+	if (lastStall == 0) Logger::console("No watchdog reset since power up");
+	else printStall();
+}
+
+void Watchdog::printStall()
+{
+	Logger::console("Watchdog reset after %i ms. Stopped checking in:", lastStallTime);
+	for (int x = 0; x < HB_COUNT; x++)
+	{
+		if (lastStall & (1ul << x)) Logger::console("  %s", heartbeatNames[x]);
+	}
+}
@@ -0,0 +1,67 @@
+/*
+ * Watchdog.h - Only lets the hardware watchdog be kicked while every subsystem is still checking in
+ *
+Copyright (c) 2015 Collin Kidder
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be included
+in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+*/
+
+#include <Arduino.h>
+#include <DueTimer.h>
+
+#ifndef WATCHDOG_H_
+#define WATCHDOG_H_
+
+#define WATCHDOG_TIMEOUT	4000 //ms without a kick before the WDT resets the chip
+#define WATCHDOG_WINDOW		1500 //ms. Every subsystem has to beat at least once per window. Standby ADC is 1000ms
+#define WATCHDOG_MAGIC		0x57440000 //"WD" in the top half of GPBR 0, missing heartbeats in the bottom
+
+enum HEARTBEAT
+{
+	HB_ADC = 0, //a pack scan step finished
+	HB_CAN = 1, //the status frame task ran
+	HB_CHARGER = 2, //the charger task ran
+	HB_COUNT
+};
+
+/*
+beat() is all the fast path does, one OR into a word. Timer4 checks the word once per window
+from its interrupt so a hung main loop can't keep the check from happening. If everything
+beat the WDT is kicked. If not, the missing ones are written to the general purpose backup
+registers, which keep their value through a reset, and the WDT is left to run out.
+setup() looks there after a watchdog reset to say what stalled.
+*/
+class Watchdog
+{
+public:
+	static void setup();
+	static inline void beat(HEARTBEAT which) { beats |= (1ul << which); }
+	static void check();
+	static void printStatus();
+
+private:
+	static volatile uint32_t beats;
+	static uint32_t lastStall; //missing heartbeats before the last watchdog reset, 0 if there wasn't one
+	static uint32_t lastStallTime; //millis() they were seen missing
+	static void printStall();
+};
+
+#endif
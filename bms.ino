@@ -38,6 +38,14 @@ This is the golden combo.
 #include "config.h"
 #include "SerialConsole.h"
 #include "CanbusHandler.h"
+#include "HsmciCard.h"
+#include "DataLogger.h"
+#include "SOCJournal.h"
+#include "SettingsStore.h"
+#include "Scheduler.h"
+#include "Profiler.h"
+#include "PowerManager.h"
+#include "Watchdog.h"
 
 EEPROMSettings settings;
 STATUS status;
@@ -45,6 +53,8 @@ SerialConsole	console;
 CANBusHandler *cbHandler;
 ADCClass *adc;
 FirmwareReceiver *fwReceiver;
+HsmciCard sdCard;
+DataLogger *sdLogger;
 
 bool firstConnect = true;
 bool needInitialConfig = false;
@@ -52,8 +62,9 @@ bool needInitialConfig = false;
 /*Load settings from EEPROM. Fill out settings if not initialized yet*/
 void loadEEPROM()
 {
-	EEPROM.read(0,settings);
-	if (settings.valid != 0xDE || settings.version != CFG_EEPROM_VER)
+	bool defaults = false;
+
+	if (!SettingsStore::getInstance()->load() || settings.valid != 0xDE || settings.version != CFG_EEPROM_VER)
 	{
 		settings.balanceThreshold = 0x200; //512 mv
 		settings.currentPackAH  = 0;
@@ -68,7 +79,8 @@ void loadEEPROM()
 		settings.CANSpeed = 500000;
 		settings.TermEnabled = true;
 		settings.logLevel = 1;
-		for (int x = 0; x < 4; x++) 
+		settings.logBinary = 0;
+		for (int x = 0; x < BMS_NUM_CHANNELS; x++) 
 		{ 
 			settings.tMultiplier[x].adcToVolts = 0.0000625609f;
 			settings.tMultiplier[x].A = 1.8794f;
@@ -80,43 +92,185 @@ void loadEEPROM()
 		}
 		settings.valid = 0xDE;
 		settings.version = CFG_EEPROM_VER;		
-		EEPROM.write(0, settings);		
+		SettingsStore::getInstance()->save();
+		SettingsStore::getInstance()->flush();
+		defaults = true;
 	}
 
+	Logger::setLoglevel((Logger::LogLevel)settings.logLevel);
+	Logger::setBinaryMode(settings.logBinary == 1);
+	watchdogReset(); //SettingsStore::load() and the journal scan both read the whole of their EEPROM area
+	if (defaults) SOCJournal::getInstance()->reset(); //after a factory reset the old pack AH means nothing
+	else SOCJournal::getInstance()->setup(); //newer pack AH than the settings struct has
+
 	//do some sanity checks to see if things seem to be set up
-	if (settings.numQuadCells[0] == 0 || settings.maxPackAH == 0)
+	if (settings.maxPackAH == 0) needInitialConfig = true;
+	for (int x = 0; x < BMS_NUM_CHANNELS; x++)
+	{
+		if (settings.numQuadCells[x] == 0) needInitialConfig = true;
+	}
+}
+
+//write one record to the SD card for every full scan of the pack
+void logSnapshot()
+{
+	static uint32_t lastScan = 0;
+	SDLOG_SNAPSHOT snap;
+
+	if (!sdLogger->isActive() || adc->getScanCount() == lastScan) return;
+	lastScan = adc->getScanCount();
+
+	snap.packVolts = (uint16_t)(adc->getPackVoltage() * 100);
+	snap.packMilliAmps = cbHandler->getAmps();
+	snap.currentPackAH = settings.currentPackAH;
+	snap.soc = ChargeRecorder::getSOC();
+	snap.status = status.value;
+	for (int x = 0; x < 4; x++)
+	{
+		snap.quadVolts[x] = (uint16_t)(adc->getVoltage(x) * 100);
+		snap.quadTemps[x] = (int16_t)(adc->getTemperature(x) * 10);
+	}
+	sdLogger->logSnapshot(millis(), snap);
+
+#if BMS_NUM_CHANNELS > 4
+	SDLOG_CHANNELS chans;
+	for (int group = 1; group < BMS_CHANNEL_GROUPS; group++)
+	{
+		chans.group = group;
+		for (int x = 0; x < 4; x++)
+		{
+			chans.volts[x] = (uint16_t)(adc->getVoltage(group * 4 + x) * 100);
+			chans.temps[x] = (int16_t)(adc->getTemperature(group * 4 + x) * 10);
+		}
+		sdLogger->logChannels(millis(), chans);
+	}
+#endif
+}
+
+//the jobs the scheduler runs. Anything that must be polled flat out stays in loop()
+void adcTask()
+{
+	adc->handleTick();
+	Watchdog::beat(HB_ADC);
+	logSnapshot();
+}
+
+void statusTask()
+{
+	//beats even if the frame couldn't be queued. With nobody else on the bus to ACK the mailboxes
+	//fill up, and that is no reason to reset the BMS
+	cbHandler->sendStatus();
+	Watchdog::beat(HB_CAN);
+}
+
+void quadStatusTask()
+{
+	cbHandler->sendQuadStatus();
+}
+
+void chargerTask()
+{
+	ChargeRecorder::getInstance()->loop();
+	Watchdog::beat(HB_CHARGER);
+}
+
+void settingsTask()
+{
+	SettingsStore::getInstance()->loop();
+}
+
+void socJournalTask()
+{
+	SOCJournal::getInstance()->loop();
+}
+
+void powerTask()
+{
+	PowerManager::getInstance()->loop();
+}
+
+void logStatsTask()
+{
+	Logger::info("V0: %f V1: %f V2: %f V3: %f", adc->getVoltage(0), adc->getVoltage(1), adc->getVoltage(2), adc->getVoltage(3));
+	Logger::info("AV0: %f AV1: %f AV2: %f AV3: %f", adc->getCellAvgVoltage(0), 
+		adc->getCellAvgVoltage(1), adc->getCellAvgVoltage(2), adc->getCellAvgVoltage(3));
+	Logger::info("T0: %f T1: %f T2: %f T3: %f", adc->getTemperature(0), adc->getTemperature(1), adc->getTemperature(2), adc->getTemperature(3));
+#if BMS_NUM_CHANNELS > 4
+	for (int x = 4; x < BMS_NUM_CHANNELS; x++)
 	{
-		needInitialConfig = true; 
+		Logger::info("V%i: %f AV%i: %f T%i: %f", x, adc->getVoltage(x), x, adc->getCellAvgVoltage(x), x, adc->getTemperature(x));
 	}
+#endif
+	Logger::info(" ");
+}
+
+//period, deadline and offset in ms. Offsets keep the tasks from all landing on the same tick.
+void setupTasks()
+{
+	Scheduler *sched = Scheduler::getInstance();
+
+	int adcTaskId = sched->addTask("ADC", adcTask, ADC_NORMAL_PERIOD, 20, 0);
+	sched->addTask("STATUS", statusTask, 100, 20, 1, 5);
+	sched->addTask("QUADSTAT", quadStatusTask, 400, 50, 2, 55);
+	sched->addTask("CHARGER", chargerTask, 100, 100, 3, 30);
+	sched->addTask("SETTINGS", settingsTask, 10, 50, 4);
+	sched->addTask("SOCJRNL", socJournalTask, 1000, 200, 5, 70);
+	sched->addTask("POWER", powerTask, 1000, 200, 6, 80);
+	sched->addTask("LOGSTATS", logStatsTask, 10000, 1000, 7, 90);
+	sched->setup();
+	PowerManager::getInstance()->setup(adcTaskId);
 }
 
 void setupHardware()
 {
+	//the WDT is already running (see watchdogSetup) and Watchdog::setup() doesn't start kicking it
+	//until the end of setup(), so kick it by hand after each stage that can block for a while
 	loadEEPROM();
+	watchdogReset();
 
 	pinModeNonDue(CAN_TERM_1, OUTPUT );  
 	pinModeNonDue(CAN_TERM_2, OUTPUT );
 
+	ChargeRecorder::getInstance()->setup();
+	watchdogReset();
+
+	sdLogger = new DataLogger(&sdCard); //HsmciCard::readBlock() kicks it during the segment scan
+	if (sdLogger->begin(millis(), CFG_BUILD_NUM)) Logger::info("SD card logging to segment %i", sdLogger->getSequence());
+	else Logger::info("No SD card found. SD logging disabled");
+	watchdogReset();
+
 	cbHandler = CANBusHandler::getInstance();
 	cbHandler->setup();
 
 	 fwReceiver = new FirmwareReceiver(&Can0, 0x1FDA4C36, 0x100);
 }
 
+//the core calls this before setup(). The WDT mode register can only be written once.
+void watchdogSetup()
+{
+	watchdogEnable(WATCHDOG_TIMEOUT);
+}
+
 void setup()
 {
+  Profiler::setup();
   Wire.begin(); // wake up I2C bus
   SerialUSB.begin(115200);
 
   setupHardware();
 
+  //the ADC runs even before the BMS is configured. The setup wizard doesn't hold up the loop.
   adc = ADCClass::getInstance();
-  if (!needInitialConfig) adc->setup();
+  adc->setup();
+  watchdogReset();
+
+  setupTasks();
+  Watchdog::setup();
 }
 
 void loop()
 {
-	static uint32_t lastStamp = 0;
+	PROFILE_SCOPE("loop");
 	if (firstConnect)	
 	{
 		if (SerialUSB)
@@ -126,24 +280,22 @@ void loop()
 			if (!needInitialConfig)
 				console.printMenu();			
 			else
-				console.InitialConfig(); //Locks out the sketch for a while
-				adc->setup(); //this was deferred but now must be done.
+				console.InitialConfig(); //asks the first question, answers come in through rcvCharacter
 		}
 	}
 	if (SerialUSB.available()) 
 	{
 		console.rcvCharacter((uint8_t)SerialUSB.read());
 	}
-	adc->loop();
+	bool busy = Scheduler::getInstance()->loop();
 	cbHandler->loop();
-
-	if ((millis() - lastStamp) > 10000)
+	Logger::loop();
+	if (sdLogger->isActive())
 	{
-		lastStamp = millis();
-		Logger::info("V0: %f V1: %f V2: %f V3: %f", adc->getVoltage(0), adc->getVoltage(1), adc->getVoltage(2), adc->getVoltage(3));
-		Logger::info("AV0: %f AV1: %f AV2: %f AV3: %f", adc->getCellAvgVoltage(0), 
-			adc->getCellAvgVoltage(1), adc->getCellAvgVoltage(2), adc->getCellAvgVoltage(3));
-		Logger::info("T0: %f T1: %f T2: %f T3: %f", adc->getTemperature(0), adc->getTemperature(1), adc->getTemperature(2), adc->getTemperature(3));
-		Logger::info(" ");
+		sdLogger->loop(millis());
+		if (!sdLogger->isActive()) Logger::error("SD card stopped responding, logging to it is off until restart");
 	}
+
+	//nothing to do until the next interrupt. The scheduler tick (1ms, 10ms in standby) is the longest that can be
+	if (!busy && !Can0.available() && !SerialUSB.available() && !Logger::hasPending()) PowerManager::getInstance()->idle();
 }
@@ -25,6 +25,7 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
 #include "cab300.h"
+#include "Telemetry.h"
 
 extern EEPROMSettings settings;
 
@@ -74,9 +75,10 @@ void CAB300::processFrame(CAN_FRAME &frame)
 			tempCurr += frame.data.byte[3];
 			tempCurr -= (int64_t)0x80000000;
 			amperageReading = (int32_t)(tempCurr);
+			Telemetry::getInstance()->sendCurrent(amperageReading);
 			float currentValue = amperageReading / 1000.0f;
 			//Logger::debug("CAB300 - Current %f", currentValue);
-			Logger::debug("CAB300 - Curr AH %i", settings.currentPackAH);
+			if (Logger::isDebug()) Logger::debug("CAB300 - Curr AH %i", settings.currentPackAH);
 			if (lastMillis > 0)
 			{			
 			    //currentReading is in milliamps but currentPackAH is in tenths of a microamp so * 10,000 but our time interval
@@ -85,17 +87,20 @@ void CAB300::processFrame(CAN_FRAME &frame)
 				//this is subtracted from the current number of AH left in the pack.
 				//Which means that negative current really does charge.
 
-				int32_t deltaAH;
+				//64 bits - a few seconds between frames at a few hundred amps is more than 32 bits holds,
+				//and so is a pack over 214AH
+				int64_t deltaAH;
 				//if (amperageReading > 100) {
-					deltaAH = (amperageReading * (int32_t)(currentMillis - lastMillis)) / 360;
+					deltaAH = ((int64_t)amperageReading * (int32_t)(currentMillis - lastMillis)) / 360;
 				//}
 				//else deltaAH = 0;
-				Logger::debug("CAB300 - ar: %l, delta = %l", amperageReading, deltaAH);
+				if (Logger::isDebug()) Logger::debug("CAB300 - ar: %l, delta = %l", amperageReading, (int32_t)deltaAH);
 
 				if ((deltaAH < 0) || (deltaAH <= settings.currentPackAH))
 				{
-					int32_t temp = settings.currentPackAH;
+					int64_t temp = settings.currentPackAH;
 					temp -= deltaAH;
+					if (temp > settings.maxPackAH) temp = settings.maxPackAH; //before it goes back into 32 bits
 					settings.currentPackAH = temp;
 				}
 				else 
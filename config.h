@@ -30,7 +30,31 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define CONFIG_H_
 
 #define CFG_BUILD_NUM	0x20
-#define CFG_EEPROM_VER	13
+#define CFG_EEPROM_VER	14 //older versions are upgraded, see SettingsMigration
+#define CFG_PROFILE		1 //set to 0 to compile out the PROFILE_SCOPE probes
+#define CFG_BENCHMARK		0 //1 adds the B console command that runs the Benchmark suite. Bench units only
+#define CFG_CANTRACE_FRAMES	256 //received frames kept in RAM for the T console command (20 bytes each). 0 for none
+
+/*
+Voltage / thermistor channels. The board itself has four (the quadrants). Each expansion board
+adds four more and sits behind an I2C mux with its own pair of ADS1110s and an I2C port expander
+driving its switches. 4 builds exactly what a plain board always ran, nothing extra is compiled in.
+*/
+#define BMS_NUM_CHANNELS	4 //4, 8, 12 or 16
+#define BMS_CHANNEL_GROUPS	(BMS_NUM_CHANNELS / 4) //group 0 is the board, 1 and up the expansion boards
+
+#if BMS_NUM_CHANNELS < 4 || BMS_NUM_CHANNELS > 16 || (BMS_NUM_CHANNELS % 4) != 0
+#error "BMS_NUM_CHANNELS must be 4, 8, 12 or 16"
+#endif
+
+//EEPROM layout. Settings used to live at address 0. Now there are two copies, see SettingsStore
+#if BMS_NUM_CHANNELS > 4
+#define EE_SETTINGS_ADDR	0x2000 //two slots of 512 bytes. Per channel settings outgrew 0x100 - 0x400
+#else
+#define EE_SETTINGS_ADDR	0x100 //two slots of 256 bytes, header then settings
+#endif
+#define EE_CHARGELOG_ADDR	0x400 //ring of charge session records (see ChargeRecorder)
+#define EE_SOCJOURNAL_ADDR	0x1000 //ring of pack AH records, 4K (see SOCJournal)
 
 #define VIN_ADDR		0x48 // ADS1110-A0 the device address is 0x48  Voltage input
 #define THERM_ADDR		0x4A // ADS1110-A2 the device address is 0x4A  Thermistor input
@@ -47,6 +71,8 @@ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define SWITCH_THERM2	X18
 #define SWITCH_THERM3	X19
 #define SWITCH_THERM4	X20
+#define CHANNEL_MUX_ADDR	0x70 //TCA9548A style I2C mux. Expansion board n is on mux port n - 1
+#define CHANNEL_GPIO_ADDR	0x20 //PCA9555 style port expander on each expansion board
 #define CAN_TERM_1		X21
 #define CAN_TERM_2		X22
 
@@ -90,10 +116,10 @@ struct EEPROMSettings {
 	//these two turn the ADC readings into volts/degrees.
 	//Apparently first gen hardware actually has non-linearity for temp so handle specially.
 	//Each ADC channel has its own multipler because the hardware used could have some differences in resistance
-	float vMultiplier[4];
-	POLYNOMIAL tMultiplier[4];
+	float vMultiplier[BMS_NUM_CHANNELS];
+	POLYNOMIAL tMultiplier[BMS_NUM_CHANNELS];
 
-	uint8_t numQuadCells[4]; //number of series cells for each quadrant - allows for asymmetric quadrants
+	uint8_t numQuadCells[BMS_NUM_CHANNELS]; //number of series cells for each quadrant - allows for asymmetric quadrants
 
 	uint32_t maxPackAH; //number of amp hours in tenths of a microamp
 	uint32_t currentPackAH; //number of amp hours in tenths of a micro amp - The top for 32bit int is approx 4 billion which gives top pack size of 4B/10M = 400AH
@@ -104,7 +130,10 @@ struct EEPROMSettings {
 
 	uint16_t chargingVoltage; //in tenths of a volt
 	uint16_t chargingAmperage; //in tenths of an amp
-	//should be 139 bytes in this struct
+
+	//version 14
+	uint8_t logBinary; //log as binary records instead of text
+	//new fields go down here, and need an entry in SettingsMigration.cpp
 };
 
 union STATUS
@@ -171,5 +200,26 @@ union BMS_STATUS_4
 	};
 };
 
+//channels past the first four - broadcast at base address + 6, only by builds with expansion boards
+//Several frames go out per update, byte 0 says which channels and what is in this one
+union BMS_STATUS_5
+{
+	uint64_t value;
+	struct {
+		uint8_t channel; //channel (0 based) of value1. value2 and value3 are the next two
+		uint8_t kind; //BMS_CHANNEL_KIND
+		uint16_t value1; //same scaling as the matching quad field in BMS_STATUS_2 to 4
+		uint16_t value2;
+		uint16_t value3;
+	};
+};
+
+enum BMS_CHANNEL_KIND
+{
+	CHANNEL_VOLTS = 0, //like BMS_STATUS_2
+	CHANNEL_CELLAVG = 1, //like BMS_STATUS_3
+	CHANNEL_TEMP = 2 //like BMS_STATUS_4, read the values as signed
+};
+
 
 #endif
\ No newline at end of file
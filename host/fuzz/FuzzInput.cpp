@@ -0,0 +1,58 @@
+/*
+ * FuzzInput.cpp - Firmware set up shared by the fuzz harnesses
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stdio.h>
+#include "FuzzInput.h"
+#include "HostHal.h"
+#include "config.h"
+#include "Logger.h"
+#include "Parameters.h"
+
+extern EEPROMSettings settings;
+
+void setup();
+
+static bool setUp = false;
+static EEPROMSettings initialSettings;
+
+void fuzzSetup()
+{
+	if (!setUp)
+	{
+		setUp = true;
+		if (!freopen("/dev/null", "w", stdout)) perror("stdout");
+		hostSetDeterministic(true);
+		setup();
+		//the wizard would have asked for these. Without them most of the SOC and fault code is skipped
+		for (int x = 0; x < 4; x++) settings.numQuadCells[x] = 12;
+		settings.maxPackAH = 1000000000;
+		settings.currentPackAH = 900000000;
+		initialSettings = settings;
+	}
+	settings = initialSettings;
+	Parameters::abortImport();
+	Logger::loop();
+}
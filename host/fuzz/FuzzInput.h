@@ -0,0 +1,91 @@
+/*
+ * FuzzInput.h - Shared by the fuzz harnesses: walks the input bytes and sets up the firmware
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <due_can.h>
+
+#ifndef FUZZINPUT_H_
+#define FUZZINPUT_H_
+
+/*
+Hands out the fuzzer's bytes in order. Reading past the end gives zeros so a harness never
+has to check lengths in the middle of building something.
+*/
+class FuzzInput
+{
+public:
+	FuzzInput(const uint8_t *data, size_t size) : data(data), size(size), pos(0) {}
+	bool empty() { return pos >= size; }
+	uint8_t byte() { return (pos < size) ? data[pos++] : 0; }
+	uint32_t word()
+	{
+		uint32_t value = 0;
+		for (int i = 0; i < 4; i++) value = (value << 8) | byte();
+		return value;
+	}
+	void bytes(uint8_t *out, size_t length)
+	{
+		for (size_t i = 0; i < length; i++) out[i] = byte();
+	}
+
+	/*
+	One canbus frame: a selector byte, then with bit 7 of it set a raw 29 bit id (bit 6 makes
+	it extended) or else one of ids[selector % count], then a length byte (the DLC, so up to
+	15 like the controller can report) and eight data bytes.
+	*/
+	void frame(CAN_FRAME &frame, const uint32_t *ids, int count)
+	{
+		uint8_t selector = byte();
+
+		memset(&frame, 0, sizeof(frame));
+		if ((selector & 0x80) || count == 0)
+		{
+			frame.extended = (selector & 0x40) ? 1 : 0;
+			frame.id = word() & (frame.extended ? 0x1FFFFFFF : 0x7FF);
+		}
+		else
+		{
+			frame.id = ids[selector % count];
+			frame.extended = (frame.id > 0x7FF) ? 1 : 0;
+		}
+		frame.rtr = (selector & 0x20) ? 1 : 0;
+		frame.length = byte() & 0x0F;
+		bytes(frame.data.bytes, 8);
+	}
+
+private:
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+};
+
+//runs setup() once with the console quiet and a configured pack, then puts the settings
+//back the way setup() left them before every input so one input can't steer the next
+void fuzzSetup();
+
+#endif
@@ -0,0 +1,44 @@
+/*
+ * console.cpp - Fuzzes the serial console: short commands, NAME=value lines, the wizard and imports
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include "FuzzInput.h"
+#include "SerialConsole.h"
+
+/*
+Every byte goes to rcvCharacter() of a console of its own. If the first byte is odd the
+console starts in the set up wizard the way a blank EEPROM does. I, V and the rest get
+there from the root menu on their own.
+*/
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	FuzzInput in(data, size);
+	SerialConsole console;
+
+	fuzzSetup();
+	if (in.byte() & 1) console.InitialConfig();
+	while (!in.empty()) console.rcvCharacter(in.byte());
+	return 0;
+}
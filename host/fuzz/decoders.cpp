@@ -0,0 +1,59 @@
+/*
+ * decoders.cpp - Fuzzes the CAB300 and Elcon decoders on their own
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include "FuzzInput.h"
+#include "HostHal.h"
+#include "cab300.h"
+#include "ElconCharger.h"
+
+extern EEPROMSettings settings;
+
+/*
+Same input layout as frames.cpp but straight into a CAB300 and an ElconCharger of their
+own, without the rest of gotFrame() in the way. Bit 4 of the first byte picks the decoder
+for the whole input, so a corpus entry stays about one of them.
+*/
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	FuzzInput in(data, size);
+	CAN_FRAME frame;
+	CAB300 cab300;
+	ElconCharger elcon;
+	bool toElcon;
+
+	fuzzSetup();
+	const uint32_t ids[] = { (uint32_t)settings.cab300Address, 0x18FF50E5 };
+
+	toElcon = (in.byte() & 0x10) != 0;
+	while (!in.empty())
+	{
+		in.frame(frame, ids, sizeof(ids) / sizeof(ids[0]));
+		hostAdvance(in.byte() * 1000ull);
+		if (toElcon) elcon.processFrame(frame);
+		else cab300.processFrame(frame);
+	}
+	return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ * standalone.cpp - main() for the fuzz harnesses when the compiler has no libFuzzer (gcc)
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+/*
+Takes the same arguments libFuzzer would for the things that make sense without coverage:
+  harness [-runs=N] [-seed=S] [-max_len=L] [FILE or DIR ...]
+Files (and every file in a directory) are run once each, which is how a corpus or a crash
+found elsewhere gets checked. -runs adds that many random inputs up to max_len bytes long.
+The sanitizers do the catching either way.
+*/
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static uint64_t randomState;
+
+static uint64_t nextRandom()
+{
+	randomState ^= randomState << 13;
+	randomState ^= randomState >> 7;
+	randomState ^= randomState << 17;
+	return randomState;
+}
+
+static bool runFile(const char *path)
+{
+	std::vector<uint8_t> data;
+	FILE *file = fopen(path, "rb");
+	int c;
+
+	if (!file)
+	{
+		fprintf(stderr, "Can't open %s\n", path);
+		return false;
+	}
+	while ((c = fgetc(file)) != EOF) data.push_back(c);
+	fclose(file);
+	fprintf(stderr, "Running %s (%zu bytes)\n", path, data.size());
+	LLVMFuzzerTestOneInput(data.empty() ? NULL : &data[0], data.size());
+	return true;
+}
+
+static int runPath(const char *path)
+{
+	struct stat info;
+	struct dirent *entry;
+	DIR *dir;
+	int count = 0;
+
+	if (stat(path, &info) != 0 || !S_ISDIR(info.st_mode)) return runFile(path) ? 1 : 0;
+	dir = opendir(path);
+	if (!dir) return 0;
+	while ((entry = readdir(dir)) != NULL)
+	{
+		std::string file = std::string(path) + "/" + entry->d_name;
+		if (entry->d_name[0] == '.' || stat(file.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) continue;
+		count += runFile(file.c_str()) ? 1 : 0;
+	}
+	closedir(dir);
+	return count;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long runs = 0, maxLength = 256, files = 0;
+	std::vector<uint8_t> data;
+
+	randomState = 0x9E3779B97F4A7C15ull;
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strncmp(argv[i], "-runs=", 6)) runs = strtoul(argv[i] + 6, NULL, 10);
+		else if (!strncmp(argv[i], "-seed=", 6)) randomState = strtoull(argv[i] + 6, NULL, 10) | 1;
+		else if (!strncmp(argv[i], "-max_len=", 9)) maxLength = strtoul(argv[i] + 9, NULL, 10);
+		else if (argv[i][0] == '-') fprintf(stderr, "Ignoring %s, it needs libFuzzer\n", argv[i]);
+		else files += runPath(argv[i]);
+	}
+
+	for (unsigned long run = 0; run < runs; run++)
+	{
+		data.resize(maxLength ? nextRandom() % (maxLength + 1) : 0);
+		for (size_t i = 0; i < data.size(); i++) data[i] = nextRandom();
+		LLVMFuzzerTestOneInput(data.empty() ? NULL : &data[0], data.size());
+	}
+	fprintf(stderr, "Ran %lu files and %lu random inputs\n", files, runs);
+	return 0;
+}
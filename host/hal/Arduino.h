@@ -0,0 +1,181 @@
+/*
+ * Arduino.h - Just enough of the Arduino Due core for the firmware to build and
+ * run on Linux. Time is virtual, see HostHal.h.
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+#include <string>
+
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH	1
+#define LOW		0
+#define INPUT	0
+#define OUTPUT	1
+#define DEC		10
+#define HEX		16
+#define OCT		8
+#define BIN		2
+
+#define highByte(w)	((uint8_t)((w) >> 8))
+#define lowByte(w)	((uint8_t)((w) & 0xff))
+
+uint32_t millis();
+uint32_t micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void watchdogEnable(uint32_t timeout);
+void watchdogReset();
+void __WFI(); //sleeps until the next virtual timer or incoming data
+uint32_t hostProfileClock(); //nanoseconds for Profiler, wall clock unless the run is deterministic
+
+class String
+{
+public:
+	String() {}
+	String(const char *str) : s(str) {}
+	String(char c) : s(1, c) {}
+	void concat(const String &other) { s += other.s; }
+	void toUpperCase() { for (size_t i = 0; i < s.size(); i++) s[i] = toupper(s[i]); }
+	const char *c_str() const { return s.c_str(); }
+	unsigned int length() const { return s.size(); }
+	bool operator==(const String &other) const { return s == other.s; }
+	String &operator+=(const String &other) { s += other.s; return *this; }
+
+private:
+	std::string s;
+};
+
+class Print
+{
+public:
+	virtual ~Print() {}
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t *buffer, size_t size)
+	{
+		for (size_t i = 0; i < size; i++) write(buffer[i]);
+		return size;
+	}
+
+	size_t print(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+	size_t print(const String &str) { return print(str.c_str()); }
+	size_t print(char c) { return write((uint8_t)c); }
+	size_t print(unsigned char n, int base = DEC) { return printNumber(n, base, false); }
+	size_t print(int n, int base = DEC) { return printNumber((long long)n, base, true); }
+	size_t print(unsigned int n, int base = DEC) { return printNumber(n, base, false); }
+	size_t print(long n, int base = DEC) { return printNumber((long long)n, base, true); }
+	size_t print(unsigned long n, int base = DEC) { return printNumber(n, base, false); }
+	size_t print(double n, int digits = 2)
+	{
+		char buff[64];
+		snprintf(buff, sizeof(buff), "%.*f", digits, n);
+		return print(buff);
+	}
+
+	size_t println() { return print("\r\n"); }
+	template<typename T> size_t println(T value) { size_t n = print(value); return n + println(); }
+	template<typename T> size_t println(T value, int format) { size_t n = print(value, format); return n + println(); }
+
+private:
+	//same rules as the real core: only base 10 gets a sign, other bases print the bits as unsigned
+	size_t printNumber(long long n, int base, bool isSigned)
+	{
+		char buff[72];
+		char *out = &buff[sizeof(buff) - 1];
+		unsigned long long value;
+		bool negative = false;
+
+		if (base < 2) base = 10;
+		if (isSigned && base == 10 && n < 0)
+		{
+			negative = true;
+			value = (unsigned long long)(-n);
+		}
+		else if (isSigned) value = (uint32_t)n; //the Due is 32 bit, so is a negative int printed in hex
+		else value = (unsigned long long)n;
+
+		*out = 0;
+		do
+		{
+			uint8_t digit = value % base;
+			*--out = (digit < 10) ? ('0' + digit) : ('A' + digit - 10);
+			value /= base;
+		} while (value);
+		if (negative) *--out = '-';
+		return print(out);
+	}
+};
+
+/*
+SerialUSB reads stdin without blocking and writes to stdout. Serial (the programming
+port) goes to stderr so it doesn't get mixed into what SerialUSB sends.
+*/
+class Serial_ : public Print
+{
+public:
+	Serial_(FILE *output) : out(output) {}
+	void begin(uint32_t baud) {}
+	int available();
+	int read();
+	int peek();
+	int availableForWrite() { return 512; }
+	size_t write(uint8_t c) { return fwrite(&c, 1, 1, out); }
+	size_t write(const uint8_t *buffer, size_t size) { return fwrite(buffer, 1, size, out); }
+	void flush() { fflush(out); }
+	operator bool() { return true; }
+
+private:
+	FILE *out;
+};
+
+extern Serial_ SerialUSB;
+extern Serial_ Serial;
+
+//only here so SamNonDuePin.h builds. The pins themselves are in HostHal.cpp
+struct PinDescription
+{
+	void *pPort;
+	uint32_t ulPin;
+	uint32_t ulPeripheralId;
+	int ulPinType;
+	uint32_t ulPinConfiguration;
+	uint32_t ulPinAttribute;
+	int ulAnalogChannel;
+	int ulADCChannelNumber;
+	int ulPWMChannel;
+	int ulTCChannel;
+};
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * DueTimer.h - Host stand-in for the DueTimer library. Handlers run on the virtual
+ * clock in HostHal.cpp, from inside whatever call moved time past them.
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <Arduino.h>
+
+#ifndef HOST_DUETIMER_H_
+#define HOST_DUETIMER_H_
+
+#define HOST_TIMER_COUNT	9
+
+void hostTimersChanged(); //HostHal.cpp caches which timer fires next
+
+class DueTimer
+{
+public:
+	DueTimer() : callback(NULL), period(1000), nextFire(0), running(false) {}
+	DueTimer &attachInterrupt(void (*isr)()) { callback = isr; hostTimersChanged(); return *this; }
+	DueTimer &detachInterrupt() { stop(); callback = NULL; return *this; }
+	DueTimer &start(long microseconds = -1);
+	DueTimer &stop() { running = false; hostTimersChanged(); return *this; }
+	DueTimer &setPeriod(unsigned long microseconds) { period = microseconds ? microseconds : 1; return *this; }
+	DueTimer &setFrequency(double frequency) { return setPeriod((unsigned long)(1000000.0 / frequency)); }
+	double getFrequency() const { return 1000000.0 / period; }
+	long getPeriod() const { return period; }
+
+	//host side
+	bool isRunning() const { return running && callback != NULL; }
+	uint64_t getNextFire() const { return nextFire; }
+	void fire(); //run the handler and schedule the next one
+
+private:
+	void (*callback)();
+	unsigned long period; //microseconds
+	uint64_t nextFire; //virtual micros
+	bool running;
+};
+
+extern DueTimer Timer, Timer0, Timer1, Timer2, Timer3, Timer4, Timer5, Timer6, Timer7, Timer8;
+
+#endif
@@ -0,0 +1,234 @@
+/*
+ * HostDevices.cpp - Device models for the host build: the ADS1110 ADCs and a
+ * canbus backend that works from candump style logs
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <inttypes.h>
+#include "HostHal.h"
+
+//conversion time in micros for each ADS1110 data rate (240, 60, 30, 15 samples per second)
+static const uint32_t adsConversionTime[4] = { 4167, 16667, 33333, 66667 };
+
+Ads1110Model::Ads1110Model(uint8_t address)
+{
+	this->address = address;
+	config = 0x8C; //power up default: continuous, 15 SPS, gain 1
+	value = 0;
+	readyAt = 0;
+	fresh = false;
+}
+
+void Ads1110Model::receive(const uint8_t *data, uint8_t length)
+{
+	if (length == 0) return;
+	config = data[0];
+	//single conversion mode only converts when asked to, continuous always does
+	if ((config & 0x10) && !(config & 0x80)) return;
+	value = sample();
+	readyAt = hostGetMicros() + adsConversionTime[(config >> 2) & 3];
+	fresh = true;
+}
+
+uint8_t Ads1110Model::request(uint8_t *data, uint8_t length)
+{
+	uint8_t reply[3];
+	bool ready = fresh && hostGetMicros() >= readyAt;
+
+	reply[0] = (uint8_t)(value >> 8);
+	reply[1] = (uint8_t)value;
+	reply[2] = (config & 0x7F) | (ready ? 0 : 0x80);
+	if (ready) fresh = false;
+	if (length > 3) length = 3;
+	memcpy(data, reply, length);
+	return length;
+}
+
+ScriptedAds1110::ScriptedAds1110(uint8_t address) : Ads1110Model(address)
+{
+}
+
+//only the lines for this chip's address are kept
+bool ScriptedAds1110::load(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	char line[128];
+	unsigned long timeMs;
+	long lineAddress;
+	int pin, raw;
+
+	if (!file) return false;
+	while (fgets(line, sizeof(line), file))
+	{
+		if (line[0] == '#') continue;
+		if (sscanf(line, "%lu %li %i %i", &timeMs, &lineAddress, &pin, &raw) != 4) continue;
+		if (lineAddress == address) set(timeMs, pin, raw);
+	}
+	fclose(file);
+	return true;
+}
+
+void ScriptedAds1110::set(uint32_t timeMs, int pin, int16_t raw)
+{
+	RULE rule;
+
+	rule.time = timeMs;
+	rule.pin = pin;
+	rule.raw = raw;
+	rules.push_back(rule);
+}
+
+int16_t ScriptedAds1110::sample()
+{
+	int16_t raw = 0;
+	uint32_t best = 0;
+	bool found = false;
+
+	for (size_t i = 0; i < rules.size(); i++)
+	{
+		if (rules[i].time > millis()) continue;
+		if (rules[i].pin >= 0 && hostPinState(rules[i].pin) != HIGH) continue;
+		if (found && rules[i].time < best) continue;
+		raw = rules[i].raw;
+		best = rules[i].time;
+		found = true;
+	}
+	return raw;
+}
+
+LogCanBackend::LogCanBackend()
+{
+	in = NULL;
+	out = NULL;
+	havePending = false;
+	pendingTime = 0;
+	timeShift = 0;
+}
+
+LogCanBackend::~LogCanBackend()
+{
+	if (in) fclose(in);
+	if (out) fclose(out);
+}
+
+bool LogCanBackend::open(const char *inPath, const char *outPath)
+{
+	if (inPath)
+	{
+		in = fopen(inPath, "r");
+		if (!in) return false;
+		readNext();
+	}
+	if (outPath)
+	{
+		out = (strcmp(outPath, "-") == 0) ? stdout : fopen(outPath, "w");
+		if (!out) return false;
+	}
+	return true;
+}
+
+bool LogCanBackend::send(const CAN_FRAME &frame)
+{
+	if (out) formatFrame(out, hostGetMicros(), frame);
+	return true;
+}
+
+void LogCanBackend::poll(CANRaw &bus)
+{
+	while (havePending && pendingTime <= hostGetMicros())
+	{
+		bus.inject(pending);
+		readNext();
+	}
+}
+
+void LogCanBackend::setStart(uint64_t micros)
+{
+	if (!havePending) return;
+	timeShift = (int64_t)micros - (int64_t)(pendingTime - timeShift);
+	pendingTime = micros;
+}
+
+uint64_t LogCanBackend::nextEvent()
+{
+	return havePending ? pendingTime : UINT64_MAX;
+}
+
+void LogCanBackend::readNext()
+{
+	char line[128];
+
+	havePending = false;
+	while (in && fgets(line, sizeof(line), in))
+	{
+		if (parseLine(line, pendingTime, pending))
+		{
+			pendingTime += timeShift;
+			havePending = true;
+			return;
+		}
+	}
+}
+
+//"(12.000100) can0 606#0102030405060708". Returns false for anything else
+bool LogCanBackend::parseLine(const char *line, uint64_t &time, CAN_FRAME &frame)
+{
+	unsigned long seconds, fraction;
+	char idText[16], dataText[40];
+	const char *hash;
+	unsigned int byte;
+
+	if (sscanf(line, " (%lu.%lu) %*s %39s", &seconds, &fraction, dataText) != 3) return false;
+	hash = strchr(dataText, '#');
+	if (hash == NULL || hash == dataText || (hash - dataText) > 8) return false;
+
+	memset(&frame, 0, sizeof(frame));
+	memcpy(idText, dataText, hash - dataText);
+	idText[hash - dataText] = 0;
+	frame.id = strtoul(idText, NULL, 16);
+	frame.extended = (hash - dataText) > 3;
+	hash++;
+	if (*hash == 'R')
+	{
+		frame.rtr = 1;
+		hash++;
+	}
+	while (frame.length < 8 && sscanf(hash, "%2x", &byte) == 1 && strlen(hash) >= 2)
+	{
+		frame.data.bytes[frame.length++] = byte;
+		hash += 2;
+	}
+	time = (uint64_t)seconds * 1000000ull + fraction;
+	return true;
+}
+
+void LogCanBackend::formatFrame(FILE *file, uint64_t time, const CAN_FRAME &frame)
+{
+	fprintf(file, "(%" PRIu64 ".%06" PRIu64 ") can0 ", time / 1000000, time % 1000000);
+	if (frame.extended) fprintf(file, "%08" PRIX32 "#", frame.id);
+	else fprintf(file, "%03" PRIX32 "#", frame.id);
+	if (frame.rtr) fputc('R', file);
+	for (int i = 0; i < frame.length && i < 8; i++) fprintf(file, "%02X", frame.data.bytes[i]);
+	fputc('\n', file);
+}
@@ -0,0 +1,556 @@
+/*
+ * HostHal.cpp - Virtual clock, timers, console, pins, EEPROM, I2C and canbus
+ * stand-ins for running the firmware on Linux
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include "HostHal.h"
+#include <DueTimer.h>
+#include <Wire_EEPROM.h>
+#include "SamNonDuePin.h"
+
+static uint64_t nowMicros = 0;
+static uint32_t loopCost = 20;
+static bool realtime = false;
+static bool deterministic = false;
+static uint64_t (*sleepLimit)() = NULL;
+static DueTimer *nextTimer = NULL; //the running timer that fires first
+static uint64_t secondFire = UINT64_MAX; //when the first of the others fires
+static bool timersChanged = true;
+static uint64_t wallStart = 0;
+static double speed = 1.0; //virtual us per wall clock us with realtime on
+static const char *sdImagePath = NULL;
+static uint8_t pinStates[PINS_C + 1];
+
+Serial_ SerialUSB(stdout);
+Serial_ Serial(stderr);
+CANRaw Can0, Can1;
+TwoWire Wire, Wire1;
+EEPROMCLASS EEPROM;
+DueTimer Timer, Timer0, Timer1, Timer2, Timer3, Timer4, Timer5, Timer6, Timer7, Timer8;
+
+static DueTimer *timers[] = { &Timer0, &Timer1, &Timer2, &Timer3, &Timer4, &Timer5, &Timer6, &Timer7, &Timer8 };
+
+//clock
+
+static uint64_t wallMicros()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+uint64_t hostGetMicros()
+{
+	return nowMicros;
+}
+
+uint32_t millis()
+{
+	hostAdvance(1);
+	return (uint32_t)(nowMicros / 1000);
+}
+
+uint32_t micros()
+{
+	hostAdvance(1);
+	return (uint32_t)nowMicros;
+}
+
+void hostTimersChanged()
+{
+	timersChanged = true;
+}
+
+static DueTimer *findNextTimer()
+{
+	if (!timersChanged) return nextTimer;
+	nextTimer = NULL;
+	secondFire = UINT64_MAX;
+	for (unsigned int i = 0; i < sizeof(timers) / sizeof(timers[0]); i++)
+	{
+		if (!timers[i]->isRunning()) continue;
+		if (nextTimer == NULL || timers[i]->getNextFire() < nextTimer->getNextFire())
+		{
+			if (nextTimer) secondFire = nextTimer->getNextFire();
+			nextTimer = timers[i];
+		}
+		else if (timers[i]->getNextFire() < secondFire) secondFire = timers[i]->getNextFire();
+	}
+	timersChanged = false;
+	return nextTimer;
+}
+
+/*
+Move virtual time forward, running timer handlers in order as their times come up.
+A handler that reads the clock moves time too, but handlers don't nest. A timer keeps
+firing without looking at the others until it passes the next one due, so long runs of
+1ms ticks are cheap.
+*/
+void hostAdvance(uint64_t microseconds)
+{
+	static bool inHandler = false;
+	uint64_t target = nowMicros + microseconds;
+	DueTimer *next;
+	int64_t ahead;
+
+	if (inHandler)
+	{
+		nowMicros = target;
+		return;
+	}
+
+	while (true)
+	{
+		next = findNextTimer();
+		if (next == NULL || next->getNextFire() > target) break;
+		if (next->getNextFire() > nowMicros) nowMicros = next->getNextFire();
+		inHandler = true;
+		next->fire();
+		inHandler = false;
+		if (nowMicros > target) target = nowMicros;
+		if (next->getNextFire() > secondFire) timersChanged = true;
+	}
+	nowMicros = target;
+
+	if (realtime)
+	{
+		ahead = (int64_t)(nowMicros / speed) - (int64_t)(wallMicros() - wallStart);
+		if (ahead > 0) usleep(ahead);
+	}
+}
+
+void hostSetLoopCost(uint32_t microseconds)
+{
+	loopCost = microseconds;
+}
+
+uint32_t hostGetLoopCost()
+{
+	return loopCost;
+}
+
+void hostSetRealtime(bool enable)
+{
+	realtime = enable;
+	wallStart = wallMicros() - (uint64_t)(nowMicros / speed);
+}
+
+void hostSetSpeed(double factor)
+{
+	speed = factor;
+	wallStart = wallMicros() - (uint64_t)(nowMicros / speed);
+}
+
+uint64_t hostWallToVirtual(uint64_t monotonicMicros)
+{
+	if (!realtime || monotonicMicros < wallStart) return nowMicros;
+	return (uint64_t)((monotonicMicros - wallStart) * speed);
+}
+
+void hostSetDeterministic(bool enable)
+{
+	deterministic = enable;
+	if (enable)
+	{
+		hostSetRealtime(false);
+		hostSetConsoleStdin(false);
+	}
+}
+
+uint32_t hostProfileClock()
+{
+	struct timespec ts;
+
+	if (deterministic) return (uint32_t)(nowMicros * 1000);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec);
+}
+
+void hostSetSleepLimit(uint64_t (*wakeBy)())
+{
+	sleepLimit = wakeBy;
+}
+
+uint64_t hostNextEvent()
+{
+	uint64_t next = UINT64_MAX;
+	DueTimer *timer = findNextTimer();
+
+	if (timer) next = timer->getNextFire();
+	if (Can0.getBackend() && Can0.getBackend()->nextEvent() < next) next = Can0.getBackend()->nextEvent();
+	return next;
+}
+
+void delay(uint32_t ms)
+{
+	hostAdvance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us)
+{
+	hostAdvance(us);
+}
+
+/*
+Nothing pending wakes the core before the next timer, scripted frame or console byte.
+With a sleep limit the core sleeps straight through timer interrupts until that time (or
+the next canbus frame) since the main loop would have nothing to do for them, so long
+quiet stretches go by quickly.
+*/
+void __WFI()
+{
+	uint64_t next;
+
+	if (SerialUSB.available()) return;
+	if (sleepLimit)
+	{
+		next = sleepLimit();
+		if (Can0.getBackend() && Can0.getBackend()->nextEvent() < next) next = Can0.getBackend()->nextEvent();
+	}
+	else next = hostNextEvent();
+	if (next == UINT64_MAX) next = nowMicros + 1000;
+	if (next > nowMicros) hostAdvance(next - nowMicros);
+}
+
+void watchdogEnable(uint32_t timeout)
+{
+}
+
+void watchdogReset()
+{
+}
+
+//timers
+
+DueTimer &DueTimer::start(long microseconds)
+{
+	if (microseconds > 0) setPeriod(microseconds);
+	nextFire = nowMicros + period;
+	running = true;
+	timersChanged = true;
+	return *this;
+}
+
+void DueTimer::fire()
+{
+	nextFire += period;
+	if (callback) callback();
+}
+
+//console. stdin is read without blocking, whatever is there is buffered. Text from
+//hostConsoleType() goes first.
+
+static char inBuffer[256];
+static int inLength = 0;
+static int inPos = 0;
+static bool readStdin = true;
+static std::string typed;
+
+static void fillInput()
+{
+	static bool setup = false;
+	struct pollfd fd;
+	ssize_t count;
+
+	if (inPos < inLength) return;
+	if (!typed.empty())
+	{
+		inLength = typed.copy(inBuffer, sizeof(inBuffer));
+		typed.erase(0, inLength);
+		inPos = 0;
+		return;
+	}
+	if (!readStdin) return;
+	if (!setup)
+	{
+		fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+		setup = true;
+	}
+	fd.fd = STDIN_FILENO;
+	fd.events = POLLIN;
+	if (poll(&fd, 1, 0) <= 0 || !(fd.revents & POLLIN)) return;
+	count = ::read(STDIN_FILENO, inBuffer, sizeof(inBuffer));
+	inPos = 0;
+	inLength = (count > 0) ? count : 0;
+	if (count == 0) readStdin = false; //end of file, nothing more will come
+}
+
+void hostConsoleType(const char *text)
+{
+	typed += text;
+}
+
+void hostSetConsoleStdin(bool enable)
+{
+	readStdin = enable;
+}
+
+int Serial_::available()
+{
+	if (out != stdout) return 0;
+	fillInput();
+	return inLength - inPos;
+}
+
+int Serial_::read()
+{
+	if (!available()) return -1;
+	return (uint8_t)inBuffer[inPos++];
+}
+
+int Serial_::peek()
+{
+	if (!available()) return -1;
+	return (uint8_t)inBuffer[inPos];
+}
+
+//pins on the SAM3X that the Due core doesn't know about
+
+void pinModeNonDue(uint32_t ulPin, uint32_t ulMode)
+{
+}
+
+void digitalWriteNonDue(uint32_t ulPin, uint32_t ulVal)
+{
+	if (ulPin <= PINS_C) pinStates[ulPin] = ulVal ? HIGH : LOW;
+}
+
+int digitalReadNonDue(uint32_t ulPin)
+{
+	return (ulPin <= PINS_C) ? pinStates[ulPin] : LOW;
+}
+
+void analogWriteNonDue(uint32_t ulPin, uint32_t ulValue)
+{
+}
+
+void analogOutputNonDue()
+{
+}
+
+void hsmciPinsinit()
+{
+}
+
+int hostPinState(uint32_t pin)
+{
+	return digitalReadNonDue(pin);
+}
+
+void hostSetSdImage(const char *path)
+{
+	sdImagePath = path;
+}
+
+const char *hostGetSdImage()
+{
+	return sdImagePath;
+}
+
+//EEPROM
+
+bool EEPROMCLASS::load(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	size_t count;
+
+	if (!file) return false;
+	count = fread(mem, 1, sizeof(mem), file);
+	fclose(file);
+	return count == sizeof(mem);
+}
+
+bool EEPROMCLASS::save(const char *path)
+{
+	FILE *file = fopen(path, "wb");
+	size_t count;
+
+	if (!file) return false;
+	count = fwrite(mem, 1, sizeof(mem), file);
+	fclose(file);
+	return count == sizeof(mem);
+}
+
+//I2C
+
+TwoWire::TwoWire()
+{
+	memset(devices, 0, sizeof(devices));
+	txAddress = 0;
+	txLength = 0;
+	rxLength = 0;
+	rxIndex = 0;
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+	txAddress = address & 0x7F;
+	txLength = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+	if (txLength >= WIRE_BUFFER_LENGTH) return 0;
+	txBuffer[txLength++] = data;
+	return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t length)
+{
+	for (size_t i = 0; i < length; i++)
+	{
+		if (!write(data[i])) return i;
+	}
+	return length;
+}
+
+//0 on success, 2 if nobody answered the address. Same codes as the real library
+uint8_t TwoWire::endTransmission(uint8_t sendStop)
+{
+	if (devices[txAddress] == NULL) return 2;
+	devices[txAddress]->receive(txBuffer, txLength);
+	return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop)
+{
+	I2CDevice *device = devices[address & 0x7F];
+
+	if (quantity > WIRE_BUFFER_LENGTH) quantity = WIRE_BUFFER_LENGTH;
+	rxIndex = 0;
+	rxLength = 0;
+	if (device != NULL) rxLength = device->request(rxBuffer, quantity);
+	return rxLength;
+}
+
+//canbus
+
+CANRaw::CANRaw()
+{
+	backend = NULL;
+	baud = 0;
+	memset(filters, 0, sizeof(filters));
+	filterVersion = 0;
+}
+
+uint32_t CANRaw::begin(uint32_t baudRate, uint8_t enablePin)
+{
+	baud = baudRate;
+	rx.clear();
+	memset(filters, 0, sizeof(filters));
+	filterVersion++;
+	return 1;
+}
+
+int CANRaw::setRXFilter(uint8_t mailbox, uint32_t id, uint32_t mask, bool extended)
+{
+	if (mailbox >= CAN_RX_MAILBOXES) return -1;
+	filters[mailbox].enabled = true;
+	filters[mailbox].extended = extended;
+	filters[mailbox].id = id;
+	filters[mailbox].mask = mask;
+	filterVersion++;
+	return mailbox;
+}
+
+//first mailbox that isn't receiving yet
+int CANRaw::setRXFilter(uint32_t id, uint32_t mask, bool extended)
+{
+	for (int mailbox = 0; mailbox < CAN_RX_MAILBOXES; mailbox++)
+	{
+		if (!filters[mailbox].enabled) return setRXFilter(mailbox, id, mask, extended);
+	}
+	return -1;
+}
+
+int CANRaw::watchFor()
+{
+	setRXFilter(0, 0, false);
+	return setRXFilter(0, 0, true);
+}
+
+int CANRaw::watchFor(uint32_t id)
+{
+	if (id > 0x7FF) return setRXFilter(id, 0x1FFFFFFF, true);
+	return setRXFilter(id, 0x7FF, false);
+}
+
+bool CANRaw::getFilter(uint8_t mailbox, uint32_t &id, uint32_t &mask, bool &extended)
+{
+	if (mailbox >= CAN_RX_MAILBOXES || !filters[mailbox].enabled) return false;
+	id = filters[mailbox].id;
+	mask = filters[mailbox].mask;
+	extended = filters[mailbox].extended;
+	return true;
+}
+
+bool CANRaw::accepts(const CAN_FRAME &frame)
+{
+	for (int mailbox = 0; mailbox < CAN_RX_MAILBOXES; mailbox++)
+	{
+		const RX_FILTER &filter = filters[mailbox];
+		if (!filter.enabled || filter.extended != (bool)frame.extended) continue;
+		if ((frame.id & filter.mask) == (filter.id & filter.mask)) return true;
+	}
+	return false;
+}
+
+uint32_t CANRaw::available()
+{
+	if (backend) backend->poll(*this);
+	return rx.size();
+}
+
+uint32_t CANRaw::read(CAN_FRAME &frame)
+{
+	if (rx.empty()) return 0;
+	frame = rx.front();
+	rx.pop_front();
+	return 1;
+}
+
+bool CANRaw::sendFrame(CAN_FRAME &frame)
+{
+	if (backend) return backend->send(frame);
+	return true;
+}
+
+void CANRaw::inject(const CAN_FRAME &frame)
+{
+	inject(frame, nowMicros);
+}
+
+//frames that don't match a mailbox never make it in. time is the mailbox timestamp, which
+//the hardware counts in bit times
+void CANRaw::inject(const CAN_FRAME &frame, uint64_t rxMicros)
+{
+	if (!accepts(frame)) return;
+	rx.push_back(frame);
+	rx.back().time = (uint16_t)(rxMicros * baud / 1000000ull);
+}
@@ -0,0 +1,192 @@
+/*
+ * HostHal.h - The host side of the hardware stand-ins: the virtual clock, pin states,
+ * I2C device models and the canbus log backend. Firmware code never includes this,
+ * only host programs that drive the firmware do.
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <Arduino.h>
+#include <due_can.h>
+#include <due_wire.h>
+#include <linux/can.h>
+#include <string>
+#include <vector>
+
+#ifndef HOST_HAL_H_
+#define HOST_HAL_H_
+
+/*
+Time only moves when something moves it:
+  - hostAdvance(), which host programs call. Each pass of loop() costs hostGetLoopCost() us
+  - every millis() or micros() call costs 1us, so code that spins waiting on them finishes
+  - delay() and delayMicroseconds()
+  - __WFI(), which skips ahead to the next timer (or the sleep limit) or scripted canbus frame
+Timer handlers run as time passes them, the same as interrupts would. With realtime on,
+hostAdvance() also sleeps so virtual time never gets ahead of the wall clock.
+*/
+uint64_t hostGetMicros();
+void hostAdvance(uint64_t microseconds);
+void hostSetLoopCost(uint32_t microseconds);
+uint32_t hostGetLoopCost();
+void hostSetRealtime(bool enable);
+void hostSetSpeed(double factor); //with realtime on, virtual time runs this many times the wall clock
+//virtual time that a CLOCK_MONOTONIC reading (in us) lines up with. Only follows the wall
+//clock with realtime on, otherwise it is just the current virtual time
+uint64_t hostWallToVirtual(uint64_t monotonicMicros);
+uint64_t hostNextEvent(); //virtual micros of the next timer or canbus event
+//__WFI() sleeps through timer interrupts until the virtual micros this returns. NULL (the
+//default) wakes on every one
+void hostSetSleepLimit(uint64_t (*wakeBy)());
+
+/*
+Deterministic runs give the same output every time for the same inputs: realtime and the
+console on stdin are turned off and the profiler counts virtual time instead of the wall
+clock. Use hostConsoleType() for console input.
+*/
+void hostSetDeterministic(bool enable);
+
+int hostPinState(uint32_t pin); //last value digitalWriteNonDue() gave it
+
+void hostConsoleType(const char *text); //queue text for SerialUSB to read, ahead of stdin
+void hostSetConsoleStdin(bool enable); //read stdin for the console (the default) or not
+
+void hostSetSdImage(const char *path); //file HsmciCard uses as the card. NULL for no card
+const char *hostGetSdImage();
+
+/*
+An ADS1110. Writing the config byte with the start bit set (or in continuous mode) takes
+a sample right away from sample() and reports it ready once the conversion time for the
+chosen data rate has gone by. Reads return the high byte, low byte and config, with bit 7
+of the config set until the conversion is done and again after it has been read once.
+*/
+class Ads1110Model : public I2CDevice
+{
+public:
+	Ads1110Model(uint8_t address);
+	void receive(const uint8_t *data, uint8_t length);
+	uint8_t request(uint8_t *data, uint8_t length);
+	virtual int16_t sample() = 0;
+
+protected:
+	uint8_t address;
+
+private:
+	uint8_t config;
+	int16_t value;
+	uint64_t readyAt;
+	bool fresh; //converted and not read yet
+};
+
+/*
+Ads1110Model whose readings come from a script file. Lines are
+  time_ms address pin raw
+and a line applies from time_ms on whenever pin is HIGH (pin -1 means always). Of the lines
+that apply the latest one wins, so a script can set one value per mux input and change it
+later. Blank lines and lines starting with # are skipped.
+*/
+class ScriptedAds1110 : public Ads1110Model
+{
+public:
+	ScriptedAds1110(uint8_t address);
+	bool load(const char *path);
+	void set(uint32_t timeMs, int pin, int16_t raw);
+	int16_t sample();
+
+private:
+	struct RULE
+	{
+		uint32_t time;
+		int pin;
+		int16_t raw;
+	};
+	std::vector<RULE> rules;
+};
+
+/*
+Reads frames for the firmware from a candump -l style log and writes what it sends out
+the same way:
+  (seconds.micros) can0 1A3#0011223344
+IDs with more than three hex digits are extended. Input times are virtual time since start
+unless setStart() moves them. Either file can be left out.
+*/
+class LogCanBackend : public HostCanBackend
+{
+public:
+	LogCanBackend();
+	~LogCanBackend();
+	bool open(const char *inPath, const char *outPath);
+	bool send(const CAN_FRAME &frame);
+	void poll(CANRaw &bus);
+	uint64_t nextEvent();
+
+	void setStart(uint64_t micros); //shift the input times so the first frame comes at micros
+
+	static bool parseLine(const char *line, uint64_t &time, CAN_FRAME &frame);
+	static void formatFrame(FILE *file, uint64_t time, const CAN_FRAME &frame);
+
+private:
+	FILE *in;
+	FILE *out;
+	bool havePending;
+	uint64_t pendingTime;
+	CAN_FRAME pending;
+	int64_t timeShift; //added to every input time
+
+	void readNext();
+};
+
+/*
+Bridges Can0 to a Linux SocketCAN interface, usually a vcan for trying the BMS against
+other tools on the same machine:
+  ip link add dev vcan0 type vcan && ip link set up vcan0
+The mailbox filters Can0 has set go into the socket as kernel filters so frames nobody
+would take are dropped before they are copied out. Received frames are read in batches
+with recvmmsg() and their kernel receive time becomes the mailbox timestamp. Sends are
+queued and go out together with sendmmsg() on the next poll, or once the queue fills.
+Only makes sense with realtime on since the bus runs on the wall clock.
+*/
+#define SOCKETCAN_BATCH		32 //frames per recvmmsg()/sendmmsg() call
+
+class SocketCanBackend : public HostCanBackend
+{
+public:
+	SocketCanBackend();
+	~SocketCanBackend();
+	bool open(const char *interfaceName);
+	bool send(const CAN_FRAME &frame);
+	void poll(CANRaw &bus);
+
+private:
+	int fd;
+	std::string name;
+	uint32_t filterVersion;
+	struct can_frame txFrames[SOCKETCAN_BATCH];
+	uint32_t txCount;
+	uint32_t txDropped; //queue full and the interface still wouldn't take any
+
+	void flush();
+	void setFilters(CANRaw &bus);
+};
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * HostHsmciCard.cpp - HsmciCard for the host build. The "card" is an image file
+ * (see bmssdlog create) given with --sd. Without one there is no card.
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include "HsmciCard.h"
+#include "FileImageCard.h"
+#include "HostHal.h"
+
+static FileImageCard *image = NULL;
+
+HsmciCard::HsmciCard()
+{
+	rca = 0;
+	blockCount = 0;
+	highCapacity = true;
+	writing = false;
+	error = false;
+}
+
+bool HsmciCard::begin()
+{
+	if (hostGetSdImage() == NULL) return false;
+	if (image == NULL) image = new FileImageCard(hostGetSdImage());
+	if (!image->begin()) return false;
+	blockCount = image->getBlockCount();
+	return true;
+}
+
+uint32_t HsmciCard::getBlockCount()
+{
+	return blockCount;
+}
+
+bool HsmciCard::readBlock(uint32_t block, uint8_t *data)
+{
+	return image && image->readBlock(block, data);
+}
+
+bool HsmciCard::startWrite(uint32_t block, const uint8_t *data)
+{
+	return image && image->startWrite(block, data);
+}
+
+bool HsmciCard::isBusy()
+{
+	return image && image->isBusy();
+}
+
+bool HsmciCard::hadError()
+{
+	return image && image->hadError();
+}
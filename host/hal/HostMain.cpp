@@ -0,0 +1,429 @@
+/*
+ * HostMain.cpp - main() for the host build of the firmware (bmshost). Runs setup()
+ * then loop() on the virtual clock until told to stop.
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <signal.h>
+#include "HostHal.h"
+#include <DueTimer.h>
+#include <Wire_EEPROM.h>
+#include "config.h"
+#include "Scenario.h"
+#include "Scheduler.h"
+#include "CanbusHandler.h"
+#include "ChargeRecorder.h"
+#include "i2c_adc.h"
+
+#define SIM_OUT_PERIOD	1000000 //us between rows of --sim-out
+#define REPLAY_START_US	1000000 //first frame of a --replay trace comes this long after start up
+#define REPLAY_TAIL_US	2000000 //keep running this long after the last frame of a replay
+#define REPLAY_REPORT_PERIOD	1000000 //us between rows of a replay report
+
+extern EEPROMSettings settings;
+extern STATUS status;
+extern CANBusHandler *cbHandler;
+
+void setup();
+void loop();
+
+static volatile bool stopRequested = false;
+static uint64_t wakeBy = UINT64_MAX; //the runner has something to do at this time
+
+static void handleSignal(int)
+{
+	stopRequested = true;
+}
+
+/*
+Keeps the last status frames (base address + 0 to 3) the BMS sent on their way to the
+backend behind it, for replay reports.
+*/
+class StatusTap : public HostCanBackend
+{
+public:
+	StatusTap() : next(NULL) { memset(last, 0, sizeof(last)); }
+	void setNext(HostCanBackend *backend) { next = backend; }
+	bool send(const CAN_FRAME &frame)
+	{
+		uint32_t offset = frame.id - (uint32_t)settings.bmsBaseAddress; //ids below the base wrap to huge
+
+		if (offset < 4) last[offset] = frame.data.value;
+		return next ? next->send(frame) : true;
+	}
+	void poll(CANRaw &bus) { if (next) next->poll(bus); }
+	uint64_t nextEvent() { return next ? next->nextEvent() : UINT64_MAX; }
+	uint64_t getLast(int offset) { return last[offset]; }
+
+private:
+	HostCanBackend *next;
+	uint64_t last[4];
+};
+
+//scenario runs sleep through timer ticks until a task is due or the runner has something to do
+static uint64_t sleepLimit()
+{
+	uint32_t idle = Scheduler::getInstance()->getIdleTicks();
+	uint64_t wake = wakeBy;
+
+	if (idle == 0) return hostGetMicros();
+	if (idle != UINT32_MAX && Timer3.getNextFire() + (uint64_t)(idle - 1) * SCHED_TICK_US < wake)
+	{
+		wake = Timer3.getNextFire() + (uint64_t)(idle - 1) * SCHED_TICK_US;
+	}
+	return wake;
+}
+
+static void usage()
+{
+	fprintf(stderr,
+		"usage: bmshost [options]\n"
+		"  --eeprom FILE     load the EEPROM from FILE if it exists, save it back at exit\n"
+		"  --can-in FILE     feed frames from a candump -l style log (times are since start)\n"
+		"  --can-out FILE    write frames the BMS sends to FILE (- for stdout)\n"
+		"  --can-if NAME     put Can0 on a SocketCAN interface (vcan0 say) instead of the logs.\n"
+		"                    Turns on --realtime\n"
+		"  --i2c FILE        ADC readings script, lines of: time_ms address pin raw\n"
+		"  --drive FILE      run the pack model instead, from a CSV of: time_s,current_a\n"
+		"                    (positive is discharge). The ADCs and CAB300 read the model\n"
+		"  --drive-repeat    start the drive cycle over once it runs out\n"
+		"  --pack FILE       pack model parameters, lines of: quad name value\n"
+		"  --sim-out FILE    write the pack model state as CSV once a second (- for stdout)\n"
+		"  --scenario FILE   run a scenario (see host/sim/Scenario.h) on the pack model with an\n"
+		"                    Elcon charger, as fast as possible and the same way every time\n"
+		"  --report FILE     scenario report CSV, one row per report interval (- for stdout)\n"
+		"  --golden FILE     compare the scenario report with FILE, exit 2 if they differ\n"
+		"  --replay FILE     feed a canbus trace (T on the console) or candump -l log through\n"
+		"                    the canbus handler, starting a second after start up. Runs as\n"
+		"                    fast as possible unless --realtime or --speed. --report and\n"
+		"                    --golden check the status frames and pack AH it leads to\n"
+		"  --speed X         run X times faster than the wall clock (1 = original timing)\n"
+		"  --sd FILE         SD card image (bmssdlog create) for the data logger\n"
+		"  --run MS          stop after MS milliseconds of virtual time\n"
+		"  --loop-cost US    virtual time each pass of loop() takes (default 20)\n"
+		"  --realtime        don't let virtual time run ahead of the wall clock\n");
+}
+
+static FILE *openOutput(const char *path)
+{
+	FILE *file = strcmp(path, "-") ? fopen(path, "w+") : stdout;
+	if (!file) fprintf(stderr, "Can't open %s\n", path);
+	return file;
+}
+
+//what the model says next to what the BMS thinks, for scenario reports
+static void printReportHeader(FILE *file)
+{
+	fprintf(file, "time_s,model_amps,model_soc,bms_amps,bms_soc,bms_ah,bms_volts,status,charge_amps,eeprom_writes\n");
+}
+
+static void printReport(FILE *file, PackModel &pack)
+{
+	float soc = 0.0f;
+
+	for (int q = 0; q < PACK_QUADS; q++) soc += pack.getSOC(q) / PACK_QUADS;
+	fprintf(file, "%.0f,%.2f,%.4f,%.2f,%u,%.2f,%.2f,%02X,%.2f,%lu\n", hostGetMicros() / 1e6,
+		pack.getCurrent(), soc, cbHandler->getAmps() / 1000.0, ChargeRecorder::getSOC(),
+		settings.currentPackAH / 10000000.0, ADCClass::getInstance()->getPackVoltage(),
+		status.value, pack.getChargeCurrent(), (unsigned long)EEPROM.getWriteCount());
+}
+
+//pack AH and the status frames as sent, for replays
+static void printReplayHeader(FILE *file)
+{
+	fprintf(file, "time_s,pack_ah,status1,status2,status3,status4\n");
+}
+
+static void printReplay(FILE *file, StatusTap &tap)
+{
+	fprintf(file, "%.0f,%lu", hostGetMicros() / 1e6, (unsigned long)settings.currentPackAH);
+	for (int i = 0; i < 4; i++)
+	{
+		uint64_t data = tap.getLast(i);
+		fputc(',', file);
+		for (int b = 0; b < 8; b++) fprintf(file, "%02X", ((uint8_t *)&data)[b]);
+	}
+	fputc('\n', file);
+}
+
+//line by line. Says where the first difference is
+static bool compareReport(FILE *report, const char *goldenPath)
+{
+	FILE *golden = fopen(goldenPath, "r");
+	char expected[256], actual[256];
+	bool haveExpected, haveActual;
+	int line = 0;
+
+	if (!golden)
+	{
+		fprintf(stderr, "Can't open %s\n", goldenPath);
+		return false;
+	}
+	rewind(report);
+	while (true)
+	{
+		haveExpected = fgets(expected, sizeof(expected), golden) != NULL;
+		haveActual = fgets(actual, sizeof(actual), report) != NULL;
+		line++;
+		if (!haveExpected && !haveActual) break;
+		if (haveExpected && haveActual && !strcmp(expected, actual)) continue;
+		fprintf(stderr, "Report differs from %s at line %i\n  expected: %s  got:      %s", goldenPath, line,
+			haveExpected ? expected : "(end)\n", haveActual ? actual : "(end)\n");
+		fclose(golden);
+		return false;
+	}
+	fclose(golden);
+	fprintf(stderr, "Report matches %s\n", goldenPath);
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	const char *eepromPath = NULL, *canIn = NULL, *canOut = NULL, *canIf = NULL, *i2cScript = NULL;
+	const char *drivePath = NULL, *packPath = NULL, *simOutPath = NULL;
+	const char *scenarioPath = NULL, *reportPath = NULL, *goldenPath = NULL, *replayPath = NULL;
+	uint64_t runFor = UINT64_MAX, nextSimOut = 0, nextReport = 0;
+	bool realtime = false, driveRepeat = false, matched = true;
+	double speed = 0.0;
+	FILE *simOut = NULL, *report = NULL;
+	LogCanBackend canBackend;
+	SocketCanBackend socketCan;
+	HostCanBackend *bus = &canBackend;
+	StatusTap statusTap;
+	ScriptedAds1110 voltageAdc(VIN_ADDR);
+	ScriptedAds1110 thermAdc(THERM_ADDR);
+	PackModel pack;
+	DriveCycle driveCycle;
+	PackVoltageAdc packVoltageAdc(VIN_ADDR, &pack);
+	PackThermAdc packThermAdc(THERM_ADDR, &pack);
+	Cab300Model cab300(0, &pack, &canBackend);
+	ElconModel charger(&pack, &cab300);
+	Scenario scenario(&pack, &charger);
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+		if (!strcmp(argv[i], "--realtime")) realtime = true;
+		else if (!strcmp(argv[i], "--drive-repeat")) driveRepeat = true;
+		else if (value == NULL) { usage(); return 1; }
+		else if (!strcmp(argv[i], "--eeprom")) eepromPath = argv[++i];
+		else if (!strcmp(argv[i], "--can-in")) canIn = argv[++i];
+		else if (!strcmp(argv[i], "--can-out")) canOut = argv[++i];
+		else if (!strcmp(argv[i], "--can-if")) canIf = argv[++i];
+		else if (!strcmp(argv[i], "--i2c")) i2cScript = argv[++i];
+		else if (!strcmp(argv[i], "--drive")) drivePath = argv[++i];
+		else if (!strcmp(argv[i], "--pack")) packPath = argv[++i];
+		else if (!strcmp(argv[i], "--sim-out")) simOutPath = argv[++i];
+		else if (!strcmp(argv[i], "--scenario")) scenarioPath = argv[++i];
+		else if (!strcmp(argv[i], "--report")) reportPath = argv[++i];
+		else if (!strcmp(argv[i], "--golden")) goldenPath = argv[++i];
+		else if (!strcmp(argv[i], "--replay")) replayPath = argv[++i];
+		else if (!strcmp(argv[i], "--speed")) speed = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--sd")) hostSetSdImage(argv[++i]);
+		else if (!strcmp(argv[i], "--run")) runFor = strtoull(argv[++i], NULL, 10) * 1000;
+		else if (!strcmp(argv[i], "--loop-cost")) hostSetLoopCost(strtoul(argv[++i], NULL, 10));
+		else { usage(); return 1; }
+	}
+
+	if ((i2cScript != NULL) + (drivePath != NULL) + (scenarioPath != NULL) > 1)
+	{
+		fprintf(stderr, "Only one of --i2c, --drive and --scenario can be used\n");
+		return 1;
+	}
+	if (replayPath && (canIn || canIf || drivePath || scenarioPath))
+	{
+		fprintf(stderr, "--replay can't be used with --can-in, --can-if, --drive or --scenario\n");
+		return 1;
+	}
+	if ((reportPath || goldenPath) && !scenarioPath && !replayPath)
+	{
+		fprintf(stderr, "--report and --golden need a --scenario or --replay\n");
+		return 1;
+	}
+	if (speed < 0.0 || (speed > 0.0 && scenarioPath))
+	{
+		fprintf(stderr, "--speed needs a positive factor and can't be used with --scenario\n");
+		return 1;
+	}
+	if (canIf && (canIn || canOut || scenarioPath))
+	{
+		fprintf(stderr, "--can-if can't be used with --can-in, --can-out or --scenario\n");
+		return 1;
+	}
+	if (goldenPath && reportPath && !strcmp(reportPath, "-"))
+	{
+		fprintf(stderr, "--golden can't read the report back from stdout\n");
+		return 1;
+	}
+
+	if (eepromPath) EEPROM.load(eepromPath); //a missing file just means a blank EEPROM
+	if (canIf)
+	{
+		if (!socketCan.open(canIf)) return 1;
+		bus = &socketCan;
+		cab300.setNext(bus);
+		realtime = true;
+	}
+	else if (!canBackend.open(replayPath ? replayPath : canIn, canOut))
+	{
+		fprintf(stderr, "Can't open the canbus logs\n");
+		return 1;
+	}
+	Can0.setBackend(bus);
+	if (replayPath)
+	{
+		if (canBackend.nextEvent() == UINT64_MAX)
+		{
+			fprintf(stderr, "No frames in %s\n", replayPath);
+			return 1;
+		}
+		canBackend.setStart(REPLAY_START_US);
+		statusTap.setNext(bus);
+		Can0.setBackend(&statusTap);
+		if (reportPath || goldenPath)
+		{
+			report = reportPath ? openOutput(reportPath) : tmpfile();
+			if (!report) return 1;
+			printReplayHeader(report);
+		}
+		if (!realtime && speed == 0.0) hostSetDeterministic(true);
+		hostSetSleepLimit(sleepLimit);
+	}
+
+	if (packPath && !pack.loadParams(packPath))
+	{
+		fprintf(stderr, "Can't open %s\n", packPath);
+		return 1;
+	}
+	if (drivePath)
+	{
+		if (!driveCycle.load(drivePath) || driveCycle.isEmpty())
+		{
+			fprintf(stderr, "Can't read a drive cycle from %s\n", drivePath);
+			return 1;
+		}
+		driveCycle.setRepeat(driveRepeat);
+		pack.setDriveCycle(&driveCycle);
+	}
+	if (scenarioPath)
+	{
+		if (!scenario.load(scenarioPath)) return 1;
+		if (scenario.getEnd() && scenario.getEnd() < runFor) runFor = scenario.getEnd();
+		if (runFor == UINT64_MAX)
+		{
+			fprintf(stderr, "The scenario needs an end (or use --run)\n");
+			return 1;
+		}
+		if (reportPath || goldenPath)
+		{
+			report = reportPath ? openOutput(reportPath) : tmpfile();
+			if (!report) return 1;
+			printReportHeader(report);
+		}
+		hostSetDeterministic(true);
+		hostSetSleepLimit(sleepLimit);
+	}
+
+	if (drivePath || scenarioPath)
+	{
+		Can0.setBackend(scenarioPath ? (HostCanBackend *)&charger : &cab300);
+		Wire.attach(VIN_ADDR, &packVoltageAdc);
+		Wire.attach(THERM_ADDR, &packThermAdc);
+		if (simOutPath)
+		{
+			simOut = openOutput(simOutPath);
+			if (!simOut) return 1;
+			pack.printHeader(simOut);
+		}
+	}
+	else
+	{
+		if (i2cScript && (!voltageAdc.load(i2cScript) || !thermAdc.load(i2cScript)))
+		{
+			fprintf(stderr, "Can't open %s\n", i2cScript);
+			return 1;
+		}
+		Wire.attach(VIN_ADDR, &voltageAdc);
+		Wire.attach(THERM_ADDR, &thermAdc);
+	}
+
+	signal(SIGINT, handleSignal);
+	signal(SIGTERM, handleSignal);
+	if (speed > 0.0)
+	{
+		hostSetSpeed(speed);
+		realtime = true;
+	}
+	hostSetRealtime(realtime && !scenarioPath);
+
+	setup();
+	cab300.setId(settings.cab300Address); //wherever the settings say it is
+	while (!stopRequested && hostGetMicros() < runFor)
+	{
+		if (scenarioPath)
+		{
+			scenario.run(hostGetMicros());
+			if (report && hostGetMicros() >= nextReport)
+			{
+				pack.update(hostGetMicros());
+				printReport(report, pack);
+				nextReport += scenario.getReportPeriod();
+			}
+			wakeBy = scenario.nextEvent();
+			if (report && nextReport < wakeBy) wakeBy = nextReport;
+			if (runFor < wakeBy) wakeBy = runFor;
+		}
+		if (replayPath)
+		{
+			if (report && hostGetMicros() >= nextReport)
+			{
+				printReplay(report, statusTap);
+				nextReport += REPLAY_REPORT_PERIOD;
+			}
+			//let the last frames play out then stop
+			if (runFor == UINT64_MAX && canBackend.nextEvent() == UINT64_MAX) runFor = hostGetMicros() + REPLAY_TAIL_US;
+			wakeBy = report ? nextReport : UINT64_MAX;
+			if (runFor < wakeBy) wakeBy = runFor;
+		}
+		loop();
+		hostAdvance(hostGetLoopCost());
+		if (simOut && hostGetMicros() >= nextSimOut)
+		{
+			pack.update(hostGetMicros());
+			pack.printState(simOut);
+			nextSimOut += SIM_OUT_PERIOD;
+		}
+	}
+	SerialUSB.flush();
+	if (simOut && simOut != stdout) fclose(simOut);
+	if (report)
+	{
+		fflush(report);
+		if (goldenPath) matched = compareReport(report, goldenPath);
+		if (report != stdout) fclose(report);
+	}
+
+	if (eepromPath && !EEPROM.save(eepromPath)) fprintf(stderr, "Can't save the EEPROM to %s\n", eepromPath);
+	return matched ? 0 : 2;
+}
@@ -0,0 +1,237 @@
+/*
+ * HostSocketCan.cpp - SocketCanBackend, which puts Can0 on a Linux SocketCAN interface
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <linux/can/raw.h>
+#include "HostHal.h"
+
+SocketCanBackend::SocketCanBackend()
+{
+	fd = -1;
+	filterVersion = 0;
+	txCount = 0;
+	txDropped = 0;
+}
+
+SocketCanBackend::~SocketCanBackend()
+{
+	if (fd < 0) return;
+	flush();
+	if (txDropped) fprintf(stderr, "%s: %u frames dropped, the interface wasn't taking them\n", name.c_str(), txDropped);
+	close(fd);
+}
+
+bool SocketCanBackend::open(const char *interfaceName)
+{
+	struct ifreq ifr;
+	struct sockaddr_can addr;
+	int on = 1;
+
+	name = interfaceName;
+	fd = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK, CAN_RAW);
+	if (fd < 0)
+	{
+		fprintf(stderr, "Can't open a SocketCAN socket: %s\n", strerror(errno));
+		return false;
+	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, interfaceName, IFNAMSIZ - 1);
+	if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0)
+	{
+		fprintf(stderr, "No canbus interface %s: %s\n", interfaceName, strerror(errno));
+		close(fd);
+		fd = -1;
+		return false;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = ifr.ifr_ifindex;
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+	{
+		fprintf(stderr, "Can't bind to %s: %s\n", interfaceName, strerror(errno));
+		close(fd);
+		fd = -1;
+		return false;
+	}
+
+	setsockopt(fd, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on));
+	//nothing comes in until the firmware sets up a mailbox
+	setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, NULL, 0);
+	return true;
+}
+
+bool SocketCanBackend::send(const CAN_FRAME &frame)
+{
+	struct can_frame *out;
+
+	if (txCount == SOCKETCAN_BATCH) flush();
+	if (txCount == SOCKETCAN_BATCH)
+	{
+		txDropped++;
+		return false; //like every TX mailbox being busy
+	}
+
+	out = &txFrames[txCount++];
+	memset(out, 0, sizeof(struct can_frame));
+	if (frame.extended) out->can_id = (frame.id & CAN_EFF_MASK) | CAN_EFF_FLAG;
+	else out->can_id = frame.id & CAN_SFF_MASK;
+	if (frame.rtr) out->can_id |= CAN_RTR_FLAG;
+	out->can_dlc = (frame.length > 8) ? 8 : frame.length;
+	memcpy(out->data, frame.data.bytes, 8);
+	return true;
+}
+
+/*
+Sends go out first so anything the firmware answers with leaves in the same pass. Then
+reads until the socket is empty, a batch at a time.
+*/
+void SocketCanBackend::poll(CANRaw &bus)
+{
+	struct mmsghdr msgs[SOCKETCAN_BATCH];
+	struct iovec iov[SOCKETCAN_BATCH];
+	struct can_frame frames[SOCKETCAN_BATCH];
+	char control[SOCKETCAN_BATCH][CMSG_SPACE(sizeof(struct timeval))];
+	struct timespec realNow, monoNow;
+	int64_t realToMono;
+	int count;
+
+	if (fd < 0) return;
+	if (txCount) flush();
+	if (filterVersion != bus.getFilterVersion()) setFilters(bus);
+
+	for (int i = 0; i < SOCKETCAN_BATCH; i++)
+	{
+		iov[i].iov_base = &frames[i];
+		iov[i].iov_len = sizeof(struct can_frame);
+		memset(&msgs[i].msg_hdr, 0, sizeof(struct msghdr));
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	do
+	{
+		for (int i = 0; i < SOCKETCAN_BATCH; i++)
+		{
+			msgs[i].msg_hdr.msg_control = control[i];
+			msgs[i].msg_hdr.msg_controllen = sizeof(control[i]);
+		}
+		count = recvmmsg(fd, msgs, SOCKETCAN_BATCH, MSG_DONTWAIT, NULL);
+		if (count <= 0) return;
+
+		//SO_TIMESTAMP is wall clock time but virtual time follows CLOCK_MONOTONIC
+		clock_gettime(CLOCK_REALTIME, &realNow);
+		clock_gettime(CLOCK_MONOTONIC, &monoNow);
+		realToMono = ((int64_t)monoNow.tv_sec - realNow.tv_sec) * 1000000ll + (monoNow.tv_nsec - realNow.tv_nsec) / 1000;
+
+		for (int i = 0; i < count; i++)
+		{
+			CAN_FRAME frame;
+			uint64_t rxMicros = hostGetMicros();
+			struct cmsghdr *cmsg;
+
+			if (msgs[i].msg_len < sizeof(struct can_frame)) continue;
+			if (frames[i].can_id & CAN_ERR_FLAG) continue;
+			for (cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg; cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg))
+			{
+				if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP)
+				{
+					struct timeval tv;
+					memcpy(&tv, CMSG_DATA(cmsg), sizeof(tv));
+					rxMicros = hostWallToVirtual((uint64_t)((int64_t)tv.tv_sec * 1000000ll + tv.tv_usec + realToMono));
+				}
+			}
+
+			memset(&frame, 0, sizeof(frame));
+			frame.extended = (frames[i].can_id & CAN_EFF_FLAG) ? 1 : 0;
+			frame.id = frames[i].can_id & (frame.extended ? CAN_EFF_MASK : CAN_SFF_MASK);
+			frame.rtr = (frames[i].can_id & CAN_RTR_FLAG) ? 1 : 0;
+			frame.length = (frames[i].can_dlc > 8) ? 8 : frames[i].can_dlc;
+			memcpy(frame.data.bytes, frames[i].data, frame.length);
+			bus.inject(frame, rxMicros);
+		}
+	} while (count == SOCKETCAN_BATCH);
+}
+
+//whatever the interface won't take right now stays queued for next time
+void SocketCanBackend::flush()
+{
+	struct mmsghdr msgs[SOCKETCAN_BATCH];
+	struct iovec iov[SOCKETCAN_BATCH];
+	int sent;
+
+	memset(msgs, 0, sizeof(msgs));
+	for (uint32_t i = 0; i < txCount; i++)
+	{
+		iov[i].iov_base = &txFrames[i];
+		iov[i].iov_len = sizeof(struct can_frame);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+	sent = sendmmsg(fd, msgs, txCount, MSG_DONTWAIT);
+	if (sent <= 0) return;
+	txCount -= sent;
+	memmove(txFrames, &txFrames[sent], txCount * sizeof(struct can_frame));
+}
+
+/*
+One kernel filter per receiving mailbox. The EFF flag is always in the mask so standard
+and extended frames stay apart the way the mailbox IDE bit keeps them apart. No mailboxes
+means an empty filter list, which lets nothing through.
+*/
+void SocketCanBackend::setFilters(CANRaw &bus)
+{
+	struct can_filter filters[CAN_RX_MAILBOXES];
+	uint32_t id, mask;
+	bool extended;
+	int count = 0;
+
+	for (int mailbox = 0; mailbox < CAN_RX_MAILBOXES; mailbox++)
+	{
+		if (!bus.getFilter(mailbox, id, mask, extended)) continue;
+		if (extended)
+		{
+			filters[count].can_id = (id & mask & CAN_EFF_MASK) | CAN_EFF_FLAG;
+			filters[count].can_mask = (mask & CAN_EFF_MASK) | CAN_EFF_FLAG;
+		}
+		else
+		{
+			filters[count].can_id = id & mask & CAN_SFF_MASK;
+			filters[count].can_mask = (mask & CAN_SFF_MASK) | CAN_EFF_FLAG;
+		}
+		count++;
+	}
+	setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FILTER, count ? filters : NULL, count * sizeof(struct can_filter));
+	filterVersion = bus.getFilterVersion();
+}
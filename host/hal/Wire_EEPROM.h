@@ -0,0 +1,66 @@
+/*
+ * Wire_EEPROM.h - Host stand-in for the 32K I2C EEPROM. It is just RAM that starts out
+ * erased (0xFF). HostHal can load it from a file at start and save it back at exit.
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <Arduino.h>
+
+#ifndef HOST_WIRE_EEPROM_H_
+#define HOST_WIRE_EEPROM_H_
+
+#define EEPROM_SIZE	32768
+
+class EEPROMCLASS
+{
+public:
+	EEPROMCLASS() { memset(mem, 0xFF, sizeof(mem)); writes = 0; }
+	uint8_t read(uint32_t address) { return mem[address % EEPROM_SIZE]; }
+	void write(uint32_t address, uint8_t value) { mem[address % EEPROM_SIZE] = value; writes++; }
+	template<typename T> void read(uint32_t address, T &value) { copyOut(address, (uint8_t *)&value, sizeof(T)); }
+	template<typename T> void write(uint32_t address, const T &value) { copyIn(address, (const uint8_t *)&value, sizeof(T)); }
+
+	//host side
+	bool load(const char *path);
+	bool save(const char *path);
+	uint8_t *getData() { return mem; }
+	uint32_t getWriteCount() { return writes; } //bytes written since start
+
+private:
+	uint8_t mem[EEPROM_SIZE];
+	uint32_t writes;
+
+	void copyOut(uint32_t address, uint8_t *data, uint32_t length)
+	{
+		for (uint32_t i = 0; i < length; i++) data[i] = read(address + i);
+	}
+	void copyIn(uint32_t address, const uint8_t *data, uint32_t length)
+	{
+		for (uint32_t i = 0; i < length; i++) write(address + i, data[i]);
+	}
+};
+
+extern EEPROMCLASS EEPROM;
+
+#endif
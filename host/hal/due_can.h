@@ -0,0 +1,130 @@
+/*
+ * due_can.h - Host stand-in for the due_can library. Frames the firmware sends go to
+ * a HostCanBackend and frames from the backend come back through available()/read().
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <Arduino.h>
+#include <deque>
+
+#ifndef HOST_DUE_CAN_H_
+#define HOST_DUE_CAN_H_
+
+typedef union
+{
+	uint64_t value;
+	struct
+	{
+		uint32_t low;
+		uint32_t high;
+	};
+	struct
+	{
+		uint16_t s0;
+		uint16_t s1;
+		uint16_t s2;
+		uint16_t s3;
+	};
+	uint8_t bytes[8];
+	uint8_t byte[8];
+} BytesUnion;
+
+typedef struct
+{
+	uint32_t id;
+	uint32_t fid;
+	uint8_t rtr;
+	uint8_t priority;
+	uint8_t extended;
+	uint16_t time;
+	uint8_t length;
+	BytesUnion data;
+} CAN_FRAME;
+
+class CANRaw;
+
+//where frames really go on the host. HostHal.cpp has one that reads and writes candump style logs
+class HostCanBackend
+{
+public:
+	virtual ~HostCanBackend() {}
+	virtual bool send(const CAN_FRAME &frame) = 0;
+	virtual void poll(CANRaw &bus) = 0; //hand anything due by now to bus.inject()
+	virtual uint64_t nextEvent() { return UINT64_MAX; } //virtual micros of the next scripted frame
+};
+
+/*
+Receive filtering works like the SAM3X mailboxes: CAN_RX_MAILBOXES of them (the last of the
+eight is kept for sending, the library default) each take frames where
+(frame id & mask) == (id & mask) and the extended flag matches. Nothing gets through until a
+mailbox has been set up and begin() clears them all again, the same as the real library.
+*/
+#define CAN_MAILBOXES		8
+#define CAN_RX_MAILBOXES	7
+
+class CANRaw
+{
+public:
+	CANRaw();
+	uint32_t begin(uint32_t baudRate, uint8_t enablePin);
+	int setRXFilter(uint8_t mailbox, uint32_t id, uint32_t mask, bool extended);
+	int setRXFilter(uint32_t id, uint32_t mask, bool extended);
+	int watchFor();
+	int watchFor(uint32_t id);
+	void setGeneralCallback(void (*callback)(CAN_FRAME *)) {}
+	uint32_t available();
+	uint32_t read(CAN_FRAME &frame);
+	bool sendFrame(CAN_FRAME &frame);
+	uint32_t getBusSpeed() { return baud; }
+
+	//host side
+	void setBackend(HostCanBackend *newBackend) { backend = newBackend; }
+	HostCanBackend *getBackend() { return backend; }
+	void inject(const CAN_FRAME &frame); //received now
+	void inject(const CAN_FRAME &frame, uint64_t rxMicros); //received at virtual time rxMicros
+	bool accepts(const CAN_FRAME &frame);
+	//mailbox filter as set, false if the mailbox isn't receiving
+	bool getFilter(uint8_t mailbox, uint32_t &id, uint32_t &mask, bool &extended);
+	uint32_t getFilterVersion() { return filterVersion; } //changes whenever the filters do
+
+private:
+	struct RX_FILTER
+	{
+		bool enabled;
+		bool extended;
+		uint32_t id;
+		uint32_t mask;
+	};
+
+	HostCanBackend *backend;
+	uint32_t baud;
+	std::deque<CAN_FRAME> rx;
+	RX_FILTER filters[CAN_RX_MAILBOXES];
+	uint32_t filterVersion;
+};
+
+extern CANRaw Can0;
+extern CANRaw Can1;
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * due_wire.h - Host stand-in for the I2C bus. Each address can have a device model
+ * attached (HostHal.h). Talking to an address with nothing attached gets a NACK.
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <Arduino.h>
+
+#ifndef HOST_DUE_WIRE_H_
+#define HOST_DUE_WIRE_H_
+
+#define WIRE_BUFFER_LENGTH	32
+
+class I2CDevice
+{
+public:
+	virtual ~I2CDevice() {}
+	virtual void receive(const uint8_t *data, uint8_t length) {} //master wrote to us
+	virtual uint8_t request(uint8_t *data, uint8_t length) = 0; //master reads. Returns bytes filled in
+};
+
+class TwoWire
+{
+public:
+	TwoWire();
+	void begin() {}
+	void setClock(uint32_t frequency) {}
+	void beginTransmission(uint8_t address);
+	void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+	size_t write(uint8_t data);
+	size_t write(const uint8_t *data, size_t length);
+	uint8_t endTransmission(uint8_t sendStop = true);
+	uint8_t requestFrom(uint8_t address, uint8_t quantity, uint8_t sendStop);
+	uint8_t requestFrom(uint8_t address, uint8_t quantity) { return requestFrom(address, quantity, (uint8_t)true); }
+	uint8_t requestFrom(uint8_t address, int quantity) { return requestFrom(address, (uint8_t)quantity, (uint8_t)true); } //byte address, literal count
+	uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity, (uint8_t)true); }
+	uint8_t requestFrom(int address, int quantity, int sendStop) { return requestFrom((uint8_t)address, (uint8_t)quantity, (uint8_t)sendStop); }
+	int available() { return rxLength - rxIndex; }
+	int read() { return (rxIndex < rxLength) ? rxBuffer[rxIndex++] : -1; }
+
+	//host side
+	void attach(uint8_t address, I2CDevice *device) { devices[address & 0x7F] = device; }
+
+private:
+	I2CDevice *devices[128];
+	uint8_t txAddress;
+	uint8_t txBuffer[WIRE_BUFFER_LENGTH];
+	uint8_t txLength;
+	uint8_t rxBuffer[WIRE_BUFFER_LENGTH];
+	uint8_t rxLength;
+	uint8_t rxIndex;
+};
+
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif
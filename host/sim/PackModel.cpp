@@ -0,0 +1,330 @@
+/*
+ * PackModel.cpp - Equivalent circuit model of the pack for the host build, one model per
+ * quadrant, driven by a current profile
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include "PackModel.h"
+
+//open circuit voltage of a LiFePO4 cell at rest, from SOC 0 to 1 in the steps below
+static const float ocvSoc[PACK_OCV_POINTS] = { 0.0f, 0.05f, 0.10f, 0.20f, 0.30f, 0.40f, 0.50f, 0.60f, 0.70f, 0.80f, 0.90f, 0.95f, 1.0f };
+static const float ocvVolts[PACK_OCV_POINTS] = { 2.50f, 3.00f, 3.20f, 3.25f, 3.28f, 3.29f, 3.30f, 3.31f, 3.32f, 3.33f, 3.34f, 3.40f, 3.60f };
+
+DriveCycle::DriveCycle()
+{
+	repeat = false;
+}
+
+bool DriveCycle::load(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	char line[128];
+	float seconds, amps;
+
+	if (!file) return false;
+	while (fgets(line, sizeof(line), file))
+	{
+		if (line[0] == '#') continue;
+		if (sscanf(line, "%f , %f", &seconds, &amps) != 2) continue;
+		add(seconds, amps);
+	}
+	fclose(file);
+	return true;
+}
+
+//points have to come in time order
+void DriveCycle::add(float seconds, float amps)
+{
+	POINT point;
+
+	if (!points.empty() && seconds < points.back().time) return;
+	point.time = seconds;
+	point.amps = amps;
+	points.push_back(point);
+}
+
+void DriveCycle::setRepeat(bool repeat)
+{
+	this->repeat = repeat;
+}
+
+bool DriveCycle::isEmpty()
+{
+	return points.empty();
+}
+
+float DriveCycle::getCurrent(double seconds)
+{
+	size_t low = 0, high;
+	float length;
+
+	if (points.empty()) return 0.0f;
+	length = points.back().time;
+	if (repeat && length > 0.0f) seconds = fmod(seconds, length);
+	if (seconds <= points[0].time) return points[0].amps;
+	if (seconds >= length) return points.back().amps;
+
+	//binary search for the last point at or before seconds
+	high = points.size() - 1;
+	while (high - low > 1)
+	{
+		size_t mid = (low + high) / 2;
+		if (points[mid].time <= seconds) low = mid;
+		else high = mid;
+	}
+	if (points[high].time == points[low].time) return points[high].amps;
+	return points[low].amps + (points[high].amps - points[low].amps) *
+		(float)((seconds - points[low].time) / (points[high].time - points[low].time));
+}
+
+//defaults are a 12S 100Ah LiFePO4 module per quadrant sitting half full at room temperature
+PackModel::PackModel()
+{
+	for (int q = 0; q < PACK_QUADS; q++)
+	{
+		params[q].cells = 12;
+		params[q].capacityAh = 100.0f;
+		params[q].soc = 0.5f;
+		params[q].r0 = 0.0015f;
+		params[q].r1 = 0.0010f;
+		params[q].c1 = 20000.0f;
+		params[q].temperature = 25.0f;
+		params[q].ambient = 25.0f;
+		params[q].heatCapacity = 12 * 2000.0f;
+		params[q].coolingRate = 12 * 0.25f;
+	}
+	cycle = NULL;
+	cycleStart = 0;
+	chargerAmps = 0.0f;
+	chargerVolts = 0.0f;
+	now = 0;
+	current = 0.0f;
+	chargeCurrent = 0.0f;
+	started = false;
+	decayStep = 0.0f;
+}
+
+QUAD_PARAMS &PackModel::getParams(int quad)
+{
+	return params[quad];
+}
+
+/*
+Overrides for the defaults, lines of
+  quad name value
+where quad is 0 - 3 or * for all four. See setParam() for the names.
+*/
+bool PackModel::loadParams(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	char line[128], quad[8], name[32];
+	float value;
+
+	if (!file) return false;
+	while (fgets(line, sizeof(line), file))
+	{
+		if (line[0] == '#') continue;
+		if (sscanf(line, "%7s %31s %f", quad, name, &value) != 3) continue;
+		if (!setParam((quad[0] == '*') ? -1 : atoi(quad), name, value))
+		{
+			fprintf(stderr, "Bad pack parameter %s %s\n", quad, name);
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+/*
+Set one of the QUAD_PARAMS fields by name for one quadrant, or all of them if quad is -1:
+cells capacity soc r0 r1 c1 temp ambient heatcap cooling
+*/
+bool PackModel::setParam(int quad, const char *name, float value)
+{
+	int first = (quad < 0) ? 0 : quad;
+	int last = (quad < 0) ? PACK_QUADS - 1 : quad;
+
+	if (last >= PACK_QUADS) return false;
+	decayStep = 0.0f;
+	for (int q = first; q <= last; q++)
+	{
+		if (!strcmp(name, "cells")) params[q].cells = (int)value;
+		else if (!strcmp(name, "capacity")) params[q].capacityAh = value;
+		else if (!strcmp(name, "soc")) params[q].soc = value;
+		else if (!strcmp(name, "r0")) params[q].r0 = value;
+		else if (!strcmp(name, "r1")) params[q].r1 = value;
+		else if (!strcmp(name, "c1")) params[q].c1 = value;
+		else if (!strcmp(name, "temp")) params[q].temperature = value;
+		else if (!strcmp(name, "ambient")) params[q].ambient = value;
+		else if (!strcmp(name, "heatcap")) params[q].heatCapacity = value;
+		else if (!strcmp(name, "cooling")) params[q].coolingRate = value;
+		else return false;
+	}
+	return true;
+}
+
+void PackModel::setDriveCycle(DriveCycle *cycle, uint64_t startMicros)
+{
+	this->cycle = cycle;
+	cycleStart = startMicros;
+}
+
+void PackModel::setCharger(float amps, float volts)
+{
+	chargerAmps = amps;
+	chargerVolts = volts;
+}
+
+float PackModel::getLoad()
+{
+	if (!cycle || now < cycleStart) return 0.0f;
+	return cycle->getCurrent((now - cycleStart) / 1000000.0);
+}
+
+//the state is taken from the parameters the first time through so loadParams() can come after construction
+void PackModel::update(uint64_t micros)
+{
+	uint64_t stepTime;
+
+	if (!started)
+	{
+		for (int q = 0; q < PACK_QUADS; q++)
+		{
+			state[q].soc = params[q].soc;
+			state[q].v1 = 0.0f;
+			state[q].temperature = params[q].temperature;
+		}
+		now = micros;
+		current = getLoad();
+		started = true;
+	}
+
+	while (now < micros)
+	{
+		stepTime = micros - now;
+		if (stepTime > PACK_STEP_US) stepTime = PACK_STEP_US;
+		step(stepTime / 1000000.0f);
+		now += stepTime;
+	}
+}
+
+void PackModel::step(float seconds)
+{
+	float heat, load, openVolts = 0.0f, resistance = 0.0f;
+
+	//the charger holds the terminal voltage at its limit once it gets there
+	load = getLoad();
+	chargeCurrent = 0.0f;
+	if (chargerAmps > 0.0f)
+	{
+		for (int q = 0; q < PACK_QUADS; q++)
+		{
+			openVolts += params[q].cells * (getOCV(state[q].soc) - state[q].v1);
+			resistance += params[q].cells * params[q].r0;
+		}
+		chargeCurrent = load + (chargerVolts - openVolts) / resistance;
+		if (chargeCurrent > chargerAmps) chargeCurrent = chargerAmps;
+		if (chargeCurrent < 0.0f) chargeCurrent = 0.0f;
+	}
+	current = load - chargeCurrent;
+
+	//nearly every step is PACK_STEP_US long so this hardly ever needs working out
+	if (seconds != decayStep)
+	{
+		for (int q = 0; q < PACK_QUADS; q++) decay[q] = expf(-seconds / (params[q].r1 * params[q].c1));
+		decayStep = seconds;
+	}
+
+	for (int q = 0; q < PACK_QUADS; q++)
+	{
+		QUAD_PARAMS &p = params[q];
+		QUAD_STATE &s = state[q];
+
+		s.soc -= current * seconds / (3600.0f * p.capacityAh);
+		if (s.soc < 0.0f) s.soc = 0.0f;
+		if (s.soc > 1.0f) s.soc = 1.0f;
+
+		//exact solution for the RC pair with the current held over the step
+		s.v1 = s.v1 * decay[q] + current * p.r1 * (1.0f - decay[q]);
+
+		heat = p.cells * (current * current * p.r0 + s.v1 * s.v1 / p.r1);
+		s.temperature += seconds * (heat - p.coolingRate * (s.temperature - p.ambient)) / p.heatCapacity;
+	}
+}
+
+float PackModel::getOCV(float soc)
+{
+	int i;
+
+	if (soc <= ocvSoc[0]) return ocvVolts[0];
+	for (i = 1; i < PACK_OCV_POINTS - 1 && soc > ocvSoc[i]; i++);
+	if (soc > ocvSoc[i]) return ocvVolts[i];
+	return ocvVolts[i - 1] + (ocvVolts[i] - ocvVolts[i - 1]) * (soc - ocvSoc[i - 1]) / (ocvSoc[i] - ocvSoc[i - 1]);
+}
+
+float PackModel::getCurrent()
+{
+	return current;
+}
+
+float PackModel::getChargeCurrent()
+{
+	return chargeCurrent;
+}
+
+float PackModel::getSOC(int quad)
+{
+	return state[quad].soc;
+}
+
+float PackModel::getVoltage(int quad)
+{
+	float cell = getOCV(state[quad].soc) - current * params[quad].r0 - state[quad].v1;
+	if (cell < 0.0f) cell = 0.0f;
+	return cell * params[quad].cells;
+}
+
+float PackModel::getTemperature(int quad)
+{
+	return state[quad].temperature;
+}
+
+void PackModel::printHeader(FILE *file)
+{
+	fprintf(file, "time_s,current_a");
+	for (int q = 0; q < PACK_QUADS; q++) fprintf(file, ",soc%i,volts%i,temp%i", q, q, q);
+	fprintf(file, "\n");
+}
+
+void PackModel::printState(FILE *file)
+{
+	fprintf(file, "%.3f,%.3f", now / 1000000.0, current);
+	for (int q = 0; q < PACK_QUADS; q++)
+	{
+		fprintf(file, ",%.5f,%.4f,%.3f", state[q].soc, getVoltage(q), state[q].temperature);
+	}
+	fprintf(file, "\n");
+}
@@ -0,0 +1,131 @@
+/*
+ * PackModel.h - Equivalent circuit model of the pack for the host build, one model per
+ * quadrant, driven by a current profile
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#ifndef PACK_MODEL_H_
+#define PACK_MODEL_H_
+
+#define PACK_QUADS			4
+#define PACK_STEP_US		10000 //longest the model integrates over in one go
+#define PACK_OCV_POINTS		13
+
+/*
+Each quadrant is a string of identical cells modelled as
+  OCV(SOC) - R0 - (R1 || C1) - terminal
+plus one lump of thermal mass that heats from I^2 R losses and cools toward ambient.
+Current is positive for discharge, the same as the CAB300. It is the load from the drive
+cycle less whatever the charger puts in. The charger is constant current up to its voltage
+limit then constant voltage.
+*/
+struct QUAD_PARAMS
+{
+	int cells; //in series
+	float capacityAh;
+	float soc; //starting state of charge, 0 - 1
+	float r0; //ohms per cell
+	float r1;
+	float c1; //farads per cell
+	float temperature; //starting temperature, C
+	float ambient;
+	float heatCapacity; //J/K for the whole quadrant
+	float coolingRate; //W/K to ambient for the whole quadrant
+};
+
+/*
+Current profile from a CSV file of
+  time_s,current_a
+Points are joined with straight lines. Lines that don't start with two numbers (a header,
+# comments) are skipped. After the last point the profile either holds the last current
+or starts over.
+*/
+class DriveCycle
+{
+public:
+	DriveCycle();
+	bool load(const char *path);
+	void add(float seconds, float amps);
+	void setRepeat(bool repeat);
+	float getCurrent(double seconds);
+	bool isEmpty();
+
+private:
+	struct POINT
+	{
+		float time;
+		float amps;
+	};
+	std::vector<POINT> points;
+	bool repeat;
+};
+
+class PackModel
+{
+public:
+	PackModel();
+	QUAD_PARAMS &getParams(int quad);
+	bool loadParams(const char *path);
+	bool setParam(int quad, const char *name, float value);
+	void setDriveCycle(DriveCycle *cycle, uint64_t startMicros = 0); //the cycle's time 0 is at startMicros
+	void setCharger(float amps, float volts); //0 amps for off
+	void update(uint64_t micros); //integrate up to this virtual time
+	float getCurrent();
+	float getChargeCurrent();
+	float getSOC(int quad);
+	float getVoltage(int quad); //terminal voltage of the whole quadrant
+	float getTemperature(int quad);
+	void printHeader(FILE *file);
+	void printState(FILE *file);
+
+	static float getOCV(float soc); //per cell
+
+private:
+	struct QUAD_STATE
+	{
+		float soc;
+		float v1; //voltage across the RC pair, per cell
+		float temperature;
+	};
+	QUAD_PARAMS params[PACK_QUADS];
+	QUAD_STATE state[PACK_QUADS];
+	DriveCycle *cycle;
+	uint64_t cycleStart;
+	float chargerAmps, chargerVolts;
+	uint64_t now;
+	float current;
+	float chargeCurrent;
+	bool started;
+	float decayStep; //step length decay[] was worked out for
+	float decay[PACK_QUADS]; //how much of the RC voltage is left after one step
+
+	float getLoad();
+	void step(float seconds);
+};
+
+#endif
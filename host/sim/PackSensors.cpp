@@ -0,0 +1,237 @@
+/*
+ * PackSensors.cpp - Sensor stand-ins that read the pack model: the two ADS1110s behind the
+ * analog switches and the CAB300 current sensor
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include "PackSensors.h"
+#include "SamNonDuePin.h"
+#include "config.h"
+
+static const uint8_t vbatPins[PACK_QUADS] = { SWITCH_VBAT1_H, SWITCH_VBAT2_H, SWITCH_VBAT3_H, SWITCH_VBAT4_H };
+static const uint8_t thermPins[PACK_QUADS] = { SWITCH_THERM1, SWITCH_THERM2, SWITCH_THERM3, SWITCH_THERM4 };
+
+static int16_t clampCounts(float counts)
+{
+	if (counts > 32767.0f) return 32767;
+	if (counts < -32768.0f) return -32768;
+	return (int16_t)lroundf(counts);
+}
+
+//defaults match the ones bms.ino writes to a blank EEPROM
+PackVoltageAdc::PackVoltageAdc(uint8_t address, PackModel *pack) : Ads1110Model(address)
+{
+	this->pack = pack;
+	voltsPerCount = 0.01285f;
+}
+
+void PackVoltageAdc::setMultiplier(float voltsPerCount)
+{
+	this->voltsPerCount = voltsPerCount;
+}
+
+int16_t PackVoltageAdc::sample()
+{
+	pack->update(hostGetMicros());
+	for (int q = 0; q < PACK_QUADS; q++)
+	{
+		if (hostPinState(vbatPins[q]) == HIGH) return clampCounts(pack->getVoltage(q) / voltsPerCount);
+	}
+	return 0;
+}
+
+PackThermAdc::PackThermAdc(uint8_t address, PackModel *pack) : Ads1110Model(address)
+{
+	this->pack = pack;
+	setCurve(0.0000625609f, 1.8794f, 2.561f, 17.433f, 22.679f);
+}
+
+void PackThermAdc::setCurve(float adcToVolts, float a, float b, float c, float d)
+{
+	this->adcToVolts = adcToVolts;
+	this->a = a;
+	this->b = b;
+	this->c = c;
+	this->d = d;
+}
+
+float PackThermAdc::toTemperature(int32_t counts)
+{
+	float x = counts * adcToVolts;
+	return ((a * x + b) * x + c) * x + d;
+}
+
+//the curve only goes up over the positive half of the ADC range so a binary search finds it
+int16_t PackThermAdc::sample()
+{
+	int32_t low = 0, high = 32767, mid;
+	float target;
+
+	pack->update(hostGetMicros());
+	for (int q = 0; q < PACK_QUADS; q++)
+	{
+		if (hostPinState(thermPins[q]) != HIGH) continue;
+		target = pack->getTemperature(q);
+		while (low < high)
+		{
+			mid = (low + high) / 2;
+			if (toTemperature(mid) < target) low = mid + 1;
+			else high = mid;
+		}
+		return (int16_t)low;
+	}
+	return 0;
+}
+
+Cab300Model::Cab300Model(uint32_t id, PackModel *pack, HostCanBackend *next)
+{
+	this->id = id;
+	this->pack = pack;
+	this->next = next;
+	nextFrame = CAB300_PERIOD_US;
+}
+
+void Cab300Model::setId(uint32_t id)
+{
+	this->id = id;
+	nextFrame = hostGetMicros() + CAB300_PERIOD_US;
+}
+
+void Cab300Model::setNext(HostCanBackend *next)
+{
+	this->next = next;
+}
+
+bool Cab300Model::send(const CAN_FRAME &frame)
+{
+	if (next) return next->send(frame);
+	return true;
+}
+
+/*
+Current in milliamps, positive for discharge, goes out big endian with 0x80000000 added.
+Byte 4 is the status, 0 for a good reading.
+*/
+void Cab300Model::poll(CANRaw &bus)
+{
+	CAN_FRAME frame;
+	uint32_t value;
+
+	while (id != 0 && nextFrame <= hostGetMicros())
+	{
+		pack->update(nextFrame);
+		value = (uint32_t)(int32_t)lroundf(pack->getCurrent() * 1000.0f) + 0x80000000ul;
+		memset(&frame, 0, sizeof(frame));
+		frame.id = id;
+		frame.length = 8;
+		frame.data.byte[0] = (uint8_t)(value >> 24);
+		frame.data.byte[1] = (uint8_t)(value >> 16);
+		frame.data.byte[2] = (uint8_t)(value >> 8);
+		frame.data.byte[3] = (uint8_t)value;
+		bus.inject(frame);
+		nextFrame += CAB300_PERIOD_US;
+	}
+	if (next) next->poll(bus);
+}
+
+uint64_t Cab300Model::nextEvent()
+{
+	uint64_t event = (id != 0) ? nextFrame : UINT64_MAX;
+
+	if (next && next->nextEvent() < event) return next->nextEvent();
+	return event;
+}
+
+ElconModel::ElconModel(PackModel *pack, HostCanBackend *next)
+{
+	this->pack = pack;
+	this->next = next;
+	plugged = false;
+	nextStatus = 0;
+	lastCommand = 0;
+}
+
+void ElconModel::plug(bool pluggedIn)
+{
+	if (pluggedIn && !plugged) nextStatus = hostGetMicros() + ELCON_PERIOD_US;
+	if (!pluggedIn) pack->setCharger(0.0f, 0.0f);
+	plugged = pluggedIn;
+}
+
+bool ElconModel::isPlugged()
+{
+	return plugged;
+}
+
+//voltage and current are tenths, high byte first. Byte 4 of a command is 0 to charge
+bool ElconModel::send(const CAN_FRAME &frame)
+{
+	if (plugged && frame.extended && frame.id == 0x1806E5F4)
+	{
+		pack->update(hostGetMicros());
+		lastCommand = hostGetMicros();
+		if (frame.data.bytes[4] == 0)
+		{
+			pack->setCharger(((frame.data.bytes[2] << 8) + frame.data.bytes[3]) / 10.0f,
+				((frame.data.bytes[0] << 8) + frame.data.bytes[1]) / 10.0f);
+		}
+		else pack->setCharger(0.0f, 0.0f);
+	}
+	if (next) return next->send(frame);
+	return true;
+}
+
+void ElconModel::poll(CANRaw &bus)
+{
+	CAN_FRAME frame;
+	uint16_t volts, amps;
+
+	while (plugged && nextStatus <= hostGetMicros())
+	{
+		pack->update(nextStatus);
+		if (nextStatus - lastCommand > ELCON_TIMEOUT_US) pack->setCharger(0.0f, 0.0f);
+		volts = 0;
+		for (int q = 0; q < PACK_QUADS; q++) volts += (uint16_t)lroundf(pack->getVoltage(q) * 10.0f);
+		amps = (uint16_t)lroundf(pack->getChargeCurrent() * 10.0f);
+		memset(&frame, 0, sizeof(frame));
+		frame.id = 0x18FF50E5;
+		frame.extended = 1;
+		frame.length = 8;
+		frame.data.bytes[0] = highByte(volts);
+		frame.data.bytes[1] = lowByte(volts);
+		frame.data.bytes[2] = highByte(amps);
+		frame.data.bytes[3] = lowByte(amps);
+		bus.inject(frame);
+		nextStatus += ELCON_PERIOD_US;
+	}
+	if (next) next->poll(bus);
+}
+
+uint64_t ElconModel::nextEvent()
+{
+	uint64_t event = plugged ? nextStatus : UINT64_MAX;
+
+	if (next && next->nextEvent() < event) return next->nextEvent();
+	return event;
+}
@@ -0,0 +1,117 @@
+/*
+ * PackSensors.h - Sensor stand-ins that read the pack model: the two ADS1110s behind the
+ * analog switches and the CAB300 current sensor
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include "HostHal.h"
+#include "PackModel.h"
+
+#ifndef PACK_SENSORS_H_
+#define PACK_SENSORS_H_
+
+#define CAB300_PERIOD_US	10000 //the CAB300 sends a reading every 10ms
+#define ELCON_PERIOD_US		1000000 //Elcon chargers send their status once a second
+#define ELCON_TIMEOUT_US	5000000 //and stop charging if they don't hear a command for this long
+
+/*
+Voltage ADC. Reads the quadrant whose high side switch (SWITCH_VBATn_H) is on, or 0 if none
+is. Volts become counts with the same multiplier the firmware uses (settings.vMultiplier).
+*/
+class PackVoltageAdc : public Ads1110Model
+{
+public:
+	PackVoltageAdc(uint8_t address, PackModel *pack);
+	void setMultiplier(float voltsPerCount);
+	int16_t sample();
+
+private:
+	PackModel *pack;
+	float voltsPerCount;
+};
+
+/*
+Thermistor ADC. Reads the quadrant whose SWITCH_THERMn is on. The firmware turns counts
+into degrees with a cubic (settings.tMultiplier). This runs that backward to find the
+counts for the model's temperature.
+*/
+class PackThermAdc : public Ads1110Model
+{
+public:
+	PackThermAdc(uint8_t address, PackModel *pack);
+	void setCurve(float adcToVolts, float a, float b, float c, float d);
+	int16_t sample();
+
+private:
+	PackModel *pack;
+	float adcToVolts, a, b, c, d;
+
+	float toTemperature(int32_t counts);
+};
+
+/*
+CAB300 on the bus. Sits in front of another backend (or none) and adds a current frame
+every CAB300_PERIOD_US on top of whatever that backend supplies. Quiet while its id is 0.
+*/
+class Cab300Model : public HostCanBackend
+{
+public:
+	Cab300Model(uint32_t id, PackModel *pack, HostCanBackend *next);
+	void setId(uint32_t id);
+	void setNext(HostCanBackend *next);
+	bool send(const CAN_FRAME &frame);
+	void poll(CANRaw &bus);
+	uint64_t nextEvent();
+
+private:
+	uint32_t id;
+	PackModel *pack;
+	HostCanBackend *next;
+	uint64_t nextFrame;
+};
+
+/*
+Elcon charger. While plugged in it sends its status (0x18FF50E5) every ELCON_PERIOD_US and
+charges the pack the way the last command (0x1806E5F4) asked, until the commands stop.
+Frames go on to the next backend as well so they still show up in the logs.
+*/
+class ElconModel : public HostCanBackend
+{
+public:
+	ElconModel(PackModel *pack, HostCanBackend *next);
+	void plug(bool pluggedIn);
+	bool isPlugged();
+	bool send(const CAN_FRAME &frame);
+	void poll(CANRaw &bus);
+	uint64_t nextEvent();
+
+private:
+	PackModel *pack;
+	HostCanBackend *next;
+	bool plugged;
+	uint64_t nextStatus;
+	uint64_t lastCommand;
+};
+
+#endif
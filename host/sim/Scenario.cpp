@@ -0,0 +1,201 @@
+/*
+ * Scenario.cpp - Timed script of drive cycles, charger plug ins and console input for long
+ * deterministic runs of the host build
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include "Scenario.h"
+
+Scenario::Scenario(PackModel *pack, ElconModel *charger)
+{
+	this->pack = pack;
+	this->charger = charger;
+	nextIndex = 0;
+	end = 0;
+	reportPeriod = 60000000ull;
+}
+
+Scenario::~Scenario()
+{
+	for (size_t i = 0; i < cycles.size(); i++) delete cycles[i];
+}
+
+bool Scenario::load(const char *path)
+{
+	FILE *file = fopen(path, "r");
+	char line[256];
+	const char *slash = strrchr(path, '/');
+	std::string directory = slash ? std::string(path, slash - path + 1) : std::string();
+	int lineNumber = 0;
+
+	if (!file)
+	{
+		fprintf(stderr, "Can't open %s\n", path);
+		return false;
+	}
+	while (fgets(line, sizeof(line), file))
+	{
+		lineNumber++;
+		line[strcspn(line, "\r\n")] = 0;
+		if (line[0] == '#' || line[strspn(line, " \t")] == 0) continue;
+		if (!parseLine(line, directory))
+		{
+			fprintf(stderr, "%s:%i: can't make sense of this line\n", path, lineNumber);
+			fclose(file);
+			return false;
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+//units can be strung together, as in 1d6h or 7h40m
+bool Scenario::parseTime(const char *text, uint64_t &micros)
+{
+	char *unit;
+	double value, total = 0.0;
+
+	do
+	{
+		value = strtod(text, &unit);
+		if (unit == text || value < 0.0) return false;
+		if (*unit == 's' || *unit == 0) total += value;
+		else if (*unit == 'm') total += value * 60.0;
+		else if (*unit == 'h') total += value * 3600.0;
+		else if (*unit == 'd') total += value * 86400.0;
+		else return false;
+		text = (*unit == 0) ? unit : unit + 1;
+	} while (*text);
+	micros = (uint64_t)(total * 1e6 + 0.5);
+	return true;
+}
+
+//events have to come in time order
+bool Scenario::parseLine(char *line, const std::string &directory)
+{
+	char *timeText = strtok(line, " \t");
+	char *command = strtok(NULL, " \t");
+	char *args = strtok(NULL, "");
+	char quad[8], name[32], file[200], option[16];
+	float value;
+	EVENT event;
+
+	if (!command || !parseTime(timeText, event.time)) return false;
+	if (!events.empty() && event.time < events.back().time) return false;
+	if (args) args += strspn(args, " \t");
+	event.cycle = NULL;
+
+	if (!strcmp(command, "pack"))
+	{
+		if (event.time != 0 || !args || sscanf(args, "%7s %31s %f", quad, name, &value) != 3) return false;
+		return pack->setParam((quad[0] == '*') ? -1 : atoi(quad), name, value);
+	}
+	if (!strcmp(command, "report"))
+	{
+		return event.time == 0 && args && parseTime(args, reportPeriod) && reportPeriod > 0;
+	}
+	if (!strcmp(command, "end"))
+	{
+		end = event.time;
+		return true;
+	}
+
+	if (!strcmp(command, "drive"))
+	{
+		option[0] = 0;
+		if (!args || sscanf(args, "%199s %15s", file, option) < 1) return false;
+		event.cycle = new DriveCycle();
+		cycles.push_back(event.cycle);
+		if (!event.cycle->load((file[0] == '/') ? file : (directory + file).c_str()) || event.cycle->isEmpty())
+		{
+			fprintf(stderr, "Can't read a drive cycle from %s\n", file);
+			return false;
+		}
+		event.cycle->setRepeat(!strcmp(option, "repeat"));
+		event.type = EVENT_DRIVE;
+	}
+	else if (!strcmp(command, "current") || !strcmp(command, "rest"))
+	{
+		value = 0.0f;
+		if (command[0] == 'c' && (!args || sscanf(args, "%f", &value) != 1)) return false;
+		event.cycle = new DriveCycle();
+		cycles.push_back(event.cycle);
+		event.cycle->add(0.0f, value);
+		event.type = EVENT_DRIVE;
+	}
+	else if (!strcmp(command, "plug")) event.type = EVENT_PLUG;
+	else if (!strcmp(command, "unplug")) event.type = EVENT_UNPLUG;
+	else if (!strcmp(command, "console"))
+	{
+		event.type = EVENT_CONSOLE;
+		event.text = std::string(args ? args : "") + "\r";
+	}
+	else return false;
+
+	events.push_back(event);
+	return true;
+}
+
+void Scenario::run(uint64_t now)
+{
+	while (nextIndex < events.size() && events[nextIndex].time <= now)
+	{
+		EVENT &event = events[nextIndex++];
+
+		pack->update(now);
+		switch (event.type)
+		{
+		case EVENT_DRIVE:
+			pack->setDriveCycle(event.cycle, event.time);
+			break;
+		case EVENT_PLUG:
+			charger->plug(true);
+			break;
+		case EVENT_UNPLUG:
+			charger->plug(false);
+			break;
+		case EVENT_CONSOLE:
+			hostConsoleType(event.text.c_str());
+			break;
+		}
+	}
+}
+
+uint64_t Scenario::nextEvent()
+{
+	if (nextIndex < events.size()) return events[nextIndex].time;
+	return UINT64_MAX;
+}
+
+uint64_t Scenario::getEnd()
+{
+	return end;
+}
+
+uint64_t Scenario::getReportPeriod()
+{
+	return reportPeriod;
+}
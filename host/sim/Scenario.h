@@ -0,0 +1,88 @@
+/*
+ * Scenario.h - Timed script of drive cycles, charger plug ins and console input for long
+ * deterministic runs of the host build
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <string>
+#include <vector>
+#include "PackSensors.h"
+
+#ifndef SCENARIO_H_
+#define SCENARIO_H_
+
+/*
+One event per line:
+  time command arguments
+Times are seconds, or take units: 90s, 15m, 7h40m, 1d6h. Events at the same time run in file
+order. Commands:
+  pack QUAD NAME VALUE   pack model parameter, see PackModel::setParam(). Time 0 only
+  drive FILE [repeat]    load from a drive cycle CSV, the cycle starts at this time
+  current AMPS           steady load (positive is discharge)
+  rest                   no load
+  plug / unplug          Elcon charger connected or not
+  console TEXT           type a line on the console
+  report INTERVAL        time between report rows (default 1m). Time 0 only
+  end                    stop the run
+Paths are relative to the scenario file. Blank lines and lines starting with # are skipped.
+*/
+class Scenario
+{
+public:
+	Scenario(PackModel *pack, ElconModel *charger);
+	~Scenario();
+	bool load(const char *path);
+	void run(uint64_t now); //everything due by now
+	uint64_t nextEvent(); //UINT64_MAX once there's nothing left
+	uint64_t getEnd(); //0 if the scenario doesn't end by itself
+	uint64_t getReportPeriod();
+
+private:
+	enum EVENT_TYPE
+	{
+		EVENT_DRIVE,
+		EVENT_PLUG,
+		EVENT_UNPLUG,
+		EVENT_CONSOLE
+	};
+	struct EVENT
+	{
+		uint64_t time;
+		EVENT_TYPE type;
+		DriveCycle *cycle;
+		std::string text;
+	};
+	PackModel *pack;
+	ElconModel *charger;
+	std::vector<EVENT> events;
+	std::vector<DriveCycle *> cycles;
+	size_t nextIndex;
+	uint64_t end;
+	uint64_t reportPeriod;
+
+	static bool parseTime(const char *text, uint64_t &micros);
+	bool parseLine(char *line, const std::string &directory);
+};
+
+#endif
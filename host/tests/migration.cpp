@@ -0,0 +1,215 @@
+/*
+ * migration.cpp - Loads settings images written by older firmware through SettingsStore and
+ * checks they come out upgraded, or are turned down so defaults get used.
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include "HostHal.h"
+#include <Wire_EEPROM.h>
+#include "config.h"
+#include "SettingsStore.h"
+#include "SettingsMigration.h"
+#include "TelemetryFormat.h"
+
+#define V13_LENGTH	148 //sizeof(EEPROMSettings) before logBinary
+
+extern EEPROMSettings settings;
+
+static int failures;
+
+#define CHECK(cond) \
+	do { if (!(cond)) { printf("  FAIL %s:%i %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+//what a version 13 unit would have had saved
+static void makeV13(uint8_t *image)
+{
+	EEPROMSettings old;
+
+	memset(&old, 0xFF, sizeof(old)); //logBinary and anything after it stays garbage, like the EEPROM
+	old.version = 13;
+	old.CANSpeed = 250000;
+	old.TermEnabled = 1;
+	old.cab300Address = 0x3C2;
+	old.bmsBaseAddress = 0x650;
+	old.balanceThreshold = 120;
+	old.lowThreshold = 2900;
+	old.highThreshold = 4150;
+	old.lowTempThresh = -100;
+	old.highTempThresh = 550;
+	for (int x = 0; x < 4; x++)
+	{
+		old.vMultiplier[x] = 0.0125f + x * 0.0001f;
+		old.tMultiplier[x].A = 1.0f;
+		old.tMultiplier[x].B = 2.0f;
+		old.tMultiplier[x].C = 3.0f;
+		old.tMultiplier[x].D = 4.0f + x;
+		old.tMultiplier[x].adcToVolts = 0.0000625f;
+		old.numQuadCells[x] = 24 + x;
+	}
+	old.maxPackAH = 1000000000;
+	old.currentPackAH = 750000000;
+	old.logLevel = 2;
+	old.valid = 0xDE;
+	old.chargingVoltage = 3960;
+	old.chargingAmperage = 120;
+	memcpy(image, &old, sizeof(old));
+}
+
+static void eraseEEPROM()
+{
+	memset(EEPROM.getData(), 0xFF, EEPROM_SIZE);
+}
+
+//put an image in a slot with a header the way SettingsStore writes one
+static void writeSlot(uint8_t slot, const uint8_t *image, uint16_t length, uint32_t generation)
+{
+	SETTINGS_HEADER header;
+	uint32_t base = EE_SETTINGS_ADDR + slot * SETTINGS_SLOT_SIZE;
+
+	header.magic = SETTINGS_MAGIC;
+	header.length = length;
+	header.generation = generation;
+	header.crc = telemCrc16Update(telemCrc16(image, length), (const uint8_t *)&generation, 4);
+	header.reserved = 0;
+	EEPROM.write(base, header);
+	for (uint16_t x = 0; x < length; x++) EEPROM.write(base + SETTINGS_BODY_OFFSET + x, image[x]);
+}
+
+//everything version 13 had came through, and logBinary got its upgrade value
+static void checkUpgraded()
+{
+	CHECK(settings.version == CFG_EEPROM_VER);
+	CHECK(settings.CANSpeed == 250000);
+	CHECK(settings.cab300Address == 0x3C2);
+	CHECK(settings.bmsBaseAddress == 0x650);
+	CHECK(settings.lowTempThresh == -100);
+	CHECK(settings.vMultiplier[3] == 0.0125f + 3 * 0.0001f);
+	CHECK(settings.tMultiplier[2].D == 6.0f);
+	CHECK(settings.numQuadCells[1] == 25);
+	CHECK(settings.currentPackAH == 750000000);
+	CHECK(settings.valid == 0xDE);
+	CHECK(settings.chargingAmperage == 120);
+	CHECK(settings.logBinary == 0);
+}
+
+//the upgraded copy was saved, so a fresh start loads it as the current version
+static void checkSaved(uint32_t generation)
+{
+	SettingsStore store;
+
+	memset(&settings, 0, sizeof(settings));
+	CHECK(store.load());
+	CHECK(store.getGeneration() == generation);
+	checkUpgraded();
+}
+
+static void testLegacyAddress()
+{
+	uint8_t image[sizeof(EEPROMSettings)];
+	SettingsStore store;
+
+	printf("version 13 at the old address\n");
+	eraseEEPROM();
+	makeV13(image);
+	for (int x = 0; x < V13_LENGTH; x++) EEPROM.write(x, image[x]);
+	memset(&settings, 0, sizeof(settings));
+	CHECK(store.load());
+	checkUpgraded();
+	checkSaved(1);
+}
+
+static void testSlot()
+{
+	uint8_t image[sizeof(EEPROMSettings)];
+	SettingsStore store;
+
+	printf("version 13 in a slot\n");
+	eraseEEPROM();
+	makeV13(image);
+	writeSlot(0, image, V13_LENGTH, 7);
+	memset(&settings, 0, sizeof(settings));
+	CHECK(store.load());
+	checkUpgraded();
+	store.flush();
+	checkSaved(8);
+}
+
+static void testWrongLength()
+{
+	uint8_t image[sizeof(EEPROMSettings)];
+	SettingsStore store;
+
+	printf("version 13 with the wrong length\n");
+	eraseEEPROM();
+	makeV13(image);
+	writeSlot(0, image, V13_LENGTH + 4, 3);
+	CHECK(!store.load());
+
+	eraseEEPROM();
+	writeSlot(1, image, V13_LENGTH - 4, 3);
+	CHECK(!store.load());
+}
+
+static void testUnknownVersion()
+{
+	uint8_t image[sizeof(EEPROMSettings)];
+
+	printf("unknown and future versions\n");
+	makeV13(image);
+	for (int version = 0; version < 256; version++)
+	{
+		if (SettingsMigration::getLength(version) != 0) continue;
+		image[offsetof(EEPROMSettings, version)] = version;
+
+		SettingsStore slotStore;
+		eraseEEPROM();
+		writeSlot(0, image, sizeof(EEPROMSettings), 2);
+		CHECK(!slotStore.load());
+
+		SettingsStore legacyStore;
+		eraseEEPROM();
+		for (unsigned int x = 0; x < sizeof(EEPROMSettings); x++) EEPROM.write(x, image[x]);
+		CHECK(!legacyStore.load());
+	}
+	CHECK(SettingsMigration::getLength(CFG_EEPROM_VER + 1) == 0);
+}
+
+int main()
+{
+	hostSetDeterministic(true); //saves wait on millis(), no point sleeping for it
+
+#if BMS_NUM_CHANNELS == 4
+	testLegacyAddress();
+	testSlot();
+	testWrongLength();
+#endif
+	testUnknownVersion();
+
+	if (failures) printf("%i checks failed\n", failures);
+	else printf("all passed\n");
+	return failures ? 1 : 0;
+}
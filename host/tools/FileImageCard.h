@@ -0,0 +1,112 @@
+/*
+ * FileImageCard.h - SdCard backed by a plain file so DataLogger can run on a PC.
+ * Writes complete right away but isBusy() reports busy for a few polls after
+ * each one so the double buffering in DataLogger gets exercised the same way
+ * a real card would.
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stdio.h>
+#include "SdCard.h"
+
+#ifndef FILEIMAGECARD_H_
+#define FILEIMAGECARD_H_
+
+class FileImageCard : public SdCard
+{
+public:
+	FileImageCard(const char *path, int busyPolls = 3)
+	{
+		fileName = path;
+		file = NULL;
+		blocks = 0;
+		busyCount = 0;
+		busyPerWrite = busyPolls;
+		error = false;
+	}
+
+	~FileImageCard()
+	{
+		if (file) fclose(file);
+	}
+
+	bool begin()
+	{
+		long size;
+
+		file = fopen(fileName, "r+b");
+		if (!file) return false;
+		fseek(file, 0, SEEK_END);
+		size = ftell(file);
+		blocks = (uint32_t)(size / SD_BLOCK_SIZE);
+		return blocks > 0;
+	}
+
+	uint32_t getBlockCount()
+	{
+		return blocks;
+	}
+
+	bool readBlock(uint32_t block, uint8_t *data)
+	{
+		if (block >= blocks) return false;
+		fseek(file, (long)block * SD_BLOCK_SIZE, SEEK_SET);
+		return fread(data, 1, SD_BLOCK_SIZE, file) == SD_BLOCK_SIZE;
+	}
+
+	bool startWrite(uint32_t block, const uint8_t *data)
+	{
+		if (busyCount > 0) return false;
+		error = (block >= blocks);
+		if (!error)
+		{
+			fseek(file, (long)block * SD_BLOCK_SIZE, SEEK_SET);
+			error = fwrite(data, 1, SD_BLOCK_SIZE, file) != SD_BLOCK_SIZE;
+		}
+		busyCount = busyPerWrite;
+		return true;
+	}
+
+	bool isBusy()
+	{
+		if (busyCount == 0) return false;
+		busyCount--;
+		return true;
+	}
+
+	bool hadError()
+	{
+		return error;
+	}
+
+private:
+	const char *fileName;
+	FILE *file;
+	uint32_t blocks;
+	int busyCount;
+	int busyPerWrite;
+	bool error;
+};
+
+#endif
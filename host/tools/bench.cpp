@@ -0,0 +1,140 @@
+/*
+ * bench.cpp - Runs the firmware benchmarks (Benchmark.cpp) on the host and compares them with a
+ * saved run so a slower hot path shows up before it goes on a BMS.
+ *
+ * usage: bmsbench [--eeprom FILE] [--baseline FILE] [--threshold PCT] > run.csv
+ *
+ * --baseline is an earlier run. Medians more than --threshold percent (default 10) slower
+ * than it are listed on stderr and the exit code is 3. The numbers are wall clock ns on a PC
+ * that is doing other things as well, so compare runs from the same machine.
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#include "HostHal.h"
+#include <Wire_EEPROM.h>
+#include "config.h"
+#include "Benchmark.h"
+
+#define BENCH_VOLTAGE_RAW	3080 //about 39.6V per quad with the default multiplier
+#define BENCH_THERM_RAW		6000 //about 25C with the default polynomial
+
+void setup();
+
+//name -> median from the CSV a run prints
+static bool readMedians(FILE *file, std::map<std::string, float> &medians)
+{
+	char line[160], name[64];
+	unsigned long ops;
+	float min, median;
+
+	rewind(file);
+	while (fgets(line, sizeof(line), file))
+	{
+		if (sscanf(line, "%63[^,],%lu,%f,%f", name, &ops, &min, &median) == 4) medians[name] = median;
+	}
+	return !medians.empty();
+}
+
+static int compare(FILE *run, const char *baselinePath, float threshold)
+{
+	std::map<std::string, float> now, baseline;
+	std::map<std::string, float>::iterator it;
+	FILE *file = fopen(baselinePath, "r");
+	int slower = 0;
+
+	if (!file || !readMedians(file, baseline))
+	{
+		fprintf(stderr, "Can't read a run from %s\n", baselinePath);
+		if (file) fclose(file);
+		return 1;
+	}
+	fclose(file);
+	readMedians(run, now);
+
+	for (it = now.begin(); it != now.end(); it++)
+	{
+		if (baseline.find(it->first) == baseline.end() || baseline[it->first] <= 0.0f) continue;
+		float change = (it->second - baseline[it->first]) * 100.0f / baseline[it->first];
+		fprintf(stderr, "%-20s %10.1f -> %10.1f %+6.1f%%%s\n", it->first.c_str(), baseline[it->first], it->second,
+			change, (change > threshold) ? "  SLOWER" : "");
+		if (change > threshold) slower++;
+	}
+	if (slower) fprintf(stderr, "%i benchmarks slower than %s by more than %.0f%%\n", slower, baselinePath, threshold);
+	return slower ? 3 : 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *eepromPath = NULL, *baselinePath = NULL;
+	float threshold = 10.0f;
+	ScriptedAds1110 voltageAdc(VIN_ADDR);
+	ScriptedAds1110 thermAdc(THERM_ADDR);
+	FILE *run, *out;
+	char line[160];
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (i + 1 >= argc)
+		{
+			fprintf(stderr, "usage: bmsbench [--eeprom FILE] [--baseline FILE] [--threshold PCT]\n");
+			return 1;
+		}
+		if (!strcmp(argv[i], "--eeprom")) eepromPath = argv[++i];
+		else if (!strcmp(argv[i], "--baseline")) baselinePath = argv[++i];
+		else if (!strcmp(argv[i], "--threshold")) threshold = atof(argv[++i]);
+		else
+		{
+			fprintf(stderr, "Unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	if (eepromPath) EEPROM.load(eepromPath);
+	voltageAdc.set(0, -1, BENCH_VOLTAGE_RAW);
+	thermAdc.set(0, -1, BENCH_THERM_RAW);
+	Wire.attach(VIN_ADDR, &voltageAdc);
+	Wire.attach(THERM_ADDR, &thermAdc);
+	hostSetConsoleStdin(false);
+
+	//everything the firmware prints goes nowhere, the results go to the real stdout
+	out = fdopen(dup(fileno(stdout)), "w");
+	run = tmpfile();
+	if (!out || !run || !freopen("/dev/null", "w", stdout)) return 1;
+
+	setup();
+	Serial_ results(run);
+	Benchmark::runAll(results);
+	fflush(run);
+
+	rewind(run);
+	while (fgets(line, sizeof(line), run)) fputs(line, out);
+	fflush(out);
+	return baselinePath ? compare(run, baselinePath, threshold) : 0;
+}
@@ -0,0 +1,297 @@
+/*
+ * logdecode.cpp - Turns the binary log records written by Logger (LOGBIN=1)
+ * back into the same text the firmware would have printed.
+ *
+ * usage: bmslogdecode [-s firmware source dir] [capture file]
+ *
+ * With no capture file the stream is read from stdin so it can sit directly
+ * on the serial port:   bmslogdecode < /dev/ttyACM0
+ *
+ * The format strings are not sent by the firmware. Instead every
+ * Logger::debug/info/warn/error call in the firmware sources is found and
+ * hashed the same way the firmware does it (see LogFormat.h). Anything in the
+ * stream that isn't a valid record (console output for instance) is passed
+ * through untouched.
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <map>
+#include <vector>
+#include <regex>
+
+#include "LogFormat.h"
+
+#ifndef BMS_SOURCE_DIR
+#define BMS_SOURCE_DIR "."
+#endif
+
+static std::map<uint16_t, std::string> formats;
+static const char *levelNames[] = { "DEBUG", "INFO", "WARNING", "ERROR" };
+
+//undo the C escapes that can show up in a string literal
+static std::string unescape(const std::string &in)
+{
+	std::string out;
+	for (size_t i = 0; i < in.size(); i++)
+	{
+		if (in[i] != '\\' || i + 1 == in.size())
+		{
+			out += in[i];
+			continue;
+		}
+		char c = in[++i];
+		switch (c)
+		{
+		case 'n': out += '\n'; break;
+		case 'r': out += '\r'; break;
+		case 't': out += '\t'; break;
+		case '0': out += '\0'; break;
+		default: out += c; break;
+		}
+	}
+	return out;
+}
+
+static bool hasSuffix(const std::string &name, const char *suffix)
+{
+	size_t len = strlen(suffix);
+	return name.size() >= len && name.compare(name.size() - len, len, suffix) == 0;
+}
+
+//find every log call in the firmware and remember its format string by id
+static int loadFormats(const std::string &dir)
+{
+	static const std::regex logCall("Logger::(debug|info|warn|error)\\s*\\(\\s*\"((?:[^\"\\\\]|\\\\.)*)\"");
+	DIR *d = opendir(dir.c_str());
+	struct dirent *entry;
+	int count = 0;
+
+	if (!d) return -1;
+	while ((entry = readdir(d)) != NULL)
+	{
+		std::string name = entry->d_name;
+		if (!hasSuffix(name, ".cpp") && !hasSuffix(name, ".ino") && !hasSuffix(name, ".h")) continue;
+
+		std::ifstream file(dir + "/" + name);
+		std::stringstream contents;
+		contents << file.rdbuf();
+		std::string text = contents.str();
+
+		for (std::sregex_iterator it(text.begin(), text.end(), logCall), end; it != end; ++it)
+		{
+			std::string format = unescape((*it)[2].str());
+			uint16_t id = logFormatId(format.c_str());
+			std::map<uint16_t, std::string>::iterator existing = formats.find(id);
+			if (existing != formats.end() && existing->second != format)
+			{
+				fprintf(stderr, "warning: \"%s\" and \"%s\" share id %04X\n", existing->second.c_str(), format.c_str(), id);
+				continue;
+			}
+			formats[id] = format;
+			count++;
+		}
+	}
+	closedir(d);
+	return count;
+}
+
+static uint32_t getWord(const uint8_t *data)
+{
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static void printBinary(std::string &out, uint32_t value)
+{
+	std::string bits;
+	do
+	{
+		bits.insert(bits.begin(), (value & 1) ? '1' : '0');
+		value >>= 1;
+	} while (value);
+	out += bits;
+}
+
+//format the arguments the same way Logger::logMessage() does
+static bool formatRecord(const std::string &format, const uint8_t *args, int argLength, std::string &out)
+{
+	char buff[64];
+	int pos = 0;
+
+	for (size_t i = 0; i < format.size(); i++)
+	{
+		if (format[i] != '%')
+		{
+			out += format[i];
+			continue;
+		}
+		if (++i == format.size()) break;
+		char spec = format[i];
+		if (spec == '%')
+		{
+			out += '%';
+			continue;
+		}
+		if (spec == 's')
+		{
+			if (pos + 1 > argLength || pos + 1 + args[pos] > argLength) return false;
+			out.append((const char *)&args[pos + 1], args[pos]);
+			pos += 1 + args[pos];
+			continue;
+		}
+
+		if (pos + 4 > argLength) return false;
+		uint32_t word = getWord(&args[pos]);
+		pos += 4;
+		switch (spec)
+		{
+		case 'f':
+			float f;
+			memcpy(&f, &word, 4);
+			snprintf(buff, sizeof(buff), "%.8f", f);
+			out += buff;
+			break;
+		case 'd':
+		case 'i':
+		case 'l':
+			snprintf(buff, sizeof(buff), "%d", (int32_t)word);
+			out += buff;
+			break;
+		case 'c':
+			out += (char)word; //same as the text log prints it
+			break;
+		case 'X':
+			out += "0x";
+			//fall through
+		case 'x':
+			snprintf(buff, sizeof(buff), "%X", word);
+			out += buff;
+			break;
+		case 'B':
+			out += "0b";
+			//fall through
+		case 'b':
+			printBinary(out, word);
+			break;
+		case 't':
+			out += (word == 1) ? "T" : "F";
+			break;
+		case 'T':
+			out += (word == 1) ? "TRUE" : "FALSE";
+			break;
+		default:
+			out += spec;
+			break;
+		}
+	}
+	return pos == argLength;
+}
+
+//returns how many bytes were used if a valid record starts at data, 0 otherwise
+static size_t decodeRecord(const uint8_t *data, size_t available, bool &needMore)
+{
+	uint8_t sum = 0;
+	needMore = false;
+
+	if (available < 2) { needMore = true; return 0; }
+	if (data[0] != LOG_SYNC || data[1] != LOG_RECORD_TEXT) return 0;
+	if (available < LOG_RECORD_HEADER) { needMore = true; return 0; }
+
+	size_t length = LOG_RECORD_HEADER + data[3] + 1;
+	if (available < length) { needMore = true; return 0; }
+	for (size_t i = 0; i < length; i++) sum += data[i];
+	if (sum != 0) return 0;
+
+	uint16_t id = data[4] | (data[5] << 8);
+	std::map<uint16_t, std::string>::iterator format = formats.find(id);
+	std::string text;
+	char buff[64];
+
+	snprintf(buff, sizeof(buff), "%u - %s: ", getWord(&data[6]), data[2] < 4 ? levelNames[data[2]] : "?");
+	std::string prefix = buff;
+	text = prefix;
+	if (format == formats.end() || !formatRecord(format->second, &data[LOG_RECORD_HEADER], data[3], text))
+	{
+		snprintf(buff, sizeof(buff), "<unknown format id %04X, %i argument bytes>", id, data[3]);
+		text = prefix + buff;
+	}
+	printf("%s\r\n", text.c_str());
+	return length;
+}
+
+int main(int argc, char **argv)
+{
+	std::string sourceDir = BMS_SOURCE_DIR;
+	FILE *in = stdin;
+	std::vector<uint8_t> pending;
+	uint8_t chunk[4096];
+	size_t got;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-s") && i + 1 < argc) sourceDir = argv[++i];
+		else if (strcmp(argv[i], "-")) in = fopen(argv[i], "rb");
+		if (!in)
+		{
+			fprintf(stderr, "Could not open %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	int count = loadFormats(sourceDir);
+	if (count <= 0)
+	{
+		fprintf(stderr, "No log format strings found in %s\n", sourceDir.c_str());
+		return 1;
+	}
+	fprintf(stderr, "Loaded %i log format strings from %s\n", count, sourceDir.c_str());
+
+	while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0)
+	{
+		pending.insert(pending.end(), chunk, chunk + got);
+		size_t pos = 0;
+		while (pos < pending.size())
+		{
+			bool needMore;
+			size_t used = decodeRecord(&pending[pos], pending.size() - pos, needMore);
+			if (needMore) break;
+			if (used == 0)
+			{
+				putchar(pending[pos++]); //not a record, pass it through
+				continue;
+			}
+			pos += used;
+		}
+		pending.erase(pending.begin(), pending.begin() + pos);
+		fflush(stdout);
+	}
+	//whatever is left can't be a full record
+	fwrite(pending.data(), 1, pending.size(), stdout);
+	return 0;
+}
@@ -0,0 +1,262 @@
+/*
+ * sdlog.cpp - Reads (and for testing, writes) the raw SD card layout used by DataLogger.
+ *
+ * usage: bmssdlog list <image>              show the segments on the card
+ *        bmssdlog dump <image> [sequence]   print the records of one segment (newest by default)
+ *        bmssdlog create <image> <MB>       make an empty card image
+ *        bmssdlog fill <image> <seconds>    run DataLogger against the image with made up traffic
+ *
+ * <image> is normally a copy of the whole card:  dd if=/dev/sdX of=card.img bs=1M
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "DataLogger.h"
+#include "FileImageCard.h"
+
+struct SEGMENT_INFO
+{
+	uint32_t sequence;
+	uint32_t blocks; //blocks in a row that belong to this segment
+};
+
+static FileImageCard *card;
+static uint32_t segmentBlocks, segmentCount;
+
+//same segment sizing that DataLogger::begin() does
+static bool openImage(const char *path)
+{
+	card = new FileImageCard(path, 0);
+	if (!card->begin())
+	{
+		fprintf(stderr, "Could not open %s\n", path);
+		return false;
+	}
+	segmentBlocks = card->getBlockCount() / SDLOG_MAX_SEGMENTS;
+	if (segmentBlocks < SDLOG_MIN_SEGMENT_BLOCKS) segmentBlocks = SDLOG_MIN_SEGMENT_BLOCKS;
+	segmentCount = card->getBlockCount() / segmentBlocks;
+	return true;
+}
+
+static bool readHeader(uint32_t block, uint8_t *data, SDLOG_BLOCK_HEADER &header)
+{
+	if (!card->readBlock(block, data)) return false;
+	memcpy(&header, data, sizeof(header));
+	return header.magic == SDLOG_MAGIC;
+}
+
+static bool scanSegment(uint32_t s, SEGMENT_INFO &info)
+{
+	uint8_t data[SD_BLOCK_SIZE];
+	SDLOG_BLOCK_HEADER header;
+
+	if (!readHeader(s * segmentBlocks, data, header) || header.blockIndex != 0) return false;
+	info.sequence = header.sequence;
+	for (info.blocks = 1; info.blocks < segmentBlocks; info.blocks++)
+	{
+		if (!readHeader(s * segmentBlocks + info.blocks, data, header)) break;
+		if (header.sequence != info.sequence || header.blockIndex != info.blocks) break;
+	}
+	return true;
+}
+
+static void printRecord(uint8_t type, uint8_t length, uint32_t time, const uint8_t *payload)
+{
+	uint32_t word;
+
+	printf("%10u ", time);
+	switch (type)
+	{
+	case SDLOG_REC_SNAPSHOT:
+	{
+		SDLOG_SNAPSHOT snap;
+		if (length != sizeof(snap)) break;
+		memcpy(&snap, payload, sizeof(snap));
+		printf("SNAP pack %.2fV %.3fA AH %u SOC %u status %02X V %.2f %.2f %.2f %.2f T %.1f %.1f %.1f %.1f\n",
+			snap.packVolts / 100.0, snap.packMilliAmps / 1000.0, snap.currentPackAH, snap.soc, snap.status,
+			snap.quadVolts[0] / 100.0, snap.quadVolts[1] / 100.0, snap.quadVolts[2] / 100.0, snap.quadVolts[3] / 100.0,
+			snap.quadTemps[0] / 10.0, snap.quadTemps[1] / 10.0, snap.quadTemps[2] / 10.0, snap.quadTemps[3] / 10.0);
+		return;
+	}
+	case SDLOG_REC_CHANNELS:
+	{
+		SDLOG_CHANNELS chans;
+		if (length != sizeof(chans)) break;
+		memcpy(&chans, payload, sizeof(chans));
+		printf("CHAN group %u V %.2f %.2f %.2f %.2f T %.1f %.1f %.1f %.1f\n", chans.group,
+			chans.volts[0] / 100.0, chans.volts[1] / 100.0, chans.volts[2] / 100.0, chans.volts[3] / 100.0,
+			chans.temps[0] / 10.0, chans.temps[1] / 10.0, chans.temps[2] / 10.0, chans.temps[3] / 10.0);
+		return;
+	}
+	case SDLOG_REC_CANFRAME:
+		if (length < 4) break;
+		memcpy(&word, payload, 4);
+		printf("CAN  %s %X [%i]", (word & 0x80000000ul) ? "ext" : "std", word & 0x1FFFFFFF, length - 4);
+		for (int i = 4; i < length; i++) printf(" %02X", payload[i]);
+		printf("\n");
+		return;
+	case SDLOG_REC_DROPPED:
+		if (length != 4) break;
+		memcpy(&word, payload, 4);
+		printf("DROPPED %u records\n", word);
+		return;
+	case SDLOG_REC_START:
+		if (length != 4) break;
+		memcpy(&word, payload, 4);
+		printf("START build %u\n", word);
+		return;
+	}
+	printf("unknown record type %i length %i\n", type, length);
+}
+
+static int list()
+{
+	SEGMENT_INFO info;
+
+	printf("%u segments of %u blocks\n", segmentCount, segmentBlocks);
+	for (uint32_t s = 0; s < segmentCount; s++)
+	{
+		if (scanSegment(s, info)) printf("segment %4u: sequence %u, %u blocks\n", s, info.sequence, info.blocks);
+	}
+	return 0;
+}
+
+static int dump(bool newest, uint32_t sequence)
+{
+	SEGMENT_INFO info;
+	uint8_t data[SD_BLOCK_SIZE];
+	SDLOG_BLOCK_HEADER header;
+	int found = -1;
+
+	for (uint32_t s = 0; s < segmentCount; s++)
+	{
+		if (!scanSegment(s, info)) continue;
+		if ((newest && (found < 0 || info.sequence > sequence)) || (!newest && info.sequence == sequence))
+		{
+			found = s;
+			sequence = info.sequence;
+		}
+	}
+	if (found < 0)
+	{
+		fprintf(stderr, "No such segment on the card\n");
+		return 1;
+	}
+
+	scanSegment(found, info);
+	for (uint32_t b = 0; b < info.blocks; b++)
+	{
+		readHeader(found * segmentBlocks + b, data, header);
+		uint16_t pos = sizeof(SDLOG_BLOCK_HEADER);
+		while (pos + SDLOG_RECORD_HEADER <= header.used && pos + SDLOG_RECORD_HEADER <= SD_BLOCK_SIZE)
+		{
+			uint8_t type = data[pos];
+			uint8_t length = data[pos + 1];
+			uint32_t time;
+			if (type == SDLOG_REC_PAD || pos + SDLOG_RECORD_HEADER + length > header.used) break;
+			memcpy(&time, &data[pos + 2], 4);
+			printRecord(type, length, time, &data[pos + SDLOG_RECORD_HEADER]);
+			pos += SDLOG_RECORD_HEADER + length;
+		}
+	}
+	return 0;
+}
+
+static int create(const char *path, uint32_t megabytes)
+{
+	static uint8_t zeros[1024 * 1024];
+	FILE *file = fopen(path, "wb");
+
+	if (!file) return 1;
+	for (uint32_t i = 0; i < megabytes; i++) fwrite(zeros, 1, sizeof(zeros), file);
+	fclose(file);
+	return 0;
+}
+
+//pretend to be the firmware: a scan every 625ms and a few frames every 100ms, time in 1ms steps
+static int fill(const char *path, uint32_t seconds)
+{
+	FileImageCard image(path);
+	DataLogger logger(&image);
+	SDLOG_SNAPSHOT snap;
+	uint8_t frame[8];
+
+	if (!logger.begin(0, 0))
+	{
+		fprintf(stderr, "Could not start logging to %s\n", path);
+		return 1;
+	}
+	memset(&snap, 0, sizeof(snap));
+	for (uint32_t now = 1; now <= seconds * 1000; now++)
+	{
+		if ((now % 625) == 0)
+		{
+			snap.packVolts = 33000 + (now / 625) % 100;
+			snap.packMilliAmps = -(int32_t)(now % 50000);
+			snap.soc = 200;
+			for (int x = 0; x < 4; x++)
+			{
+				snap.quadVolts[x] = snap.packVolts / 4;
+				snap.quadTemps[x] = 250 + x;
+			}
+			logger.logSnapshot(now, snap);
+		}
+		if ((now % 100) == 0)
+		{
+			for (int i = 0; i < 8; i++) frame[i] = (uint8_t)(now >> (i & 3));
+			logger.logFrame(now, 0x3C0, false, 8, frame);
+			logger.logFrame(now, 0x1806E5F4, true, 8, frame);
+		}
+		logger.loop(now);
+	}
+	logger.flush(seconds * 1000);
+	while (image.isBusy()) logger.loop(seconds * 1000);
+	logger.loop(seconds * 1000); //writes the last block
+
+	printf("sequence %u: %u blocks written, %u records dropped, %u errors\n", logger.getSequence(),
+		logger.getBlocksWritten(), logger.getDroppedCount(), logger.getErrorCount());
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc >= 4 && !strcmp(argv[1], "create")) return create(argv[2], atoi(argv[3]));
+	if (argc >= 4 && !strcmp(argv[1], "fill")) return fill(argv[2], atoi(argv[3]));
+	if (argc >= 3 && !strcmp(argv[1], "list"))
+	{
+		if (!openImage(argv[2])) return 1;
+		return list();
+	}
+	if (argc >= 3 && !strcmp(argv[1], "dump"))
+	{
+		if (!openImage(argv[2])) return 1;
+		if (argc >= 4) return dump(false, strtoul(argv[3], NULL, 0));
+		return dump(true, 0);
+	}
+	fprintf(stderr, "usage: %s list|dump|create|fill <image> ...\n", argv[0]);
+	return 1;
+}
@@ -0,0 +1,196 @@
+/*
+ * telemdecode.cpp - Splits the binary telemetry stream (TELEMSUB=...) into one
+ * CSV file per stream for plotting.
+ *
+ * usage: bmstelemdecode [-o output prefix] [capture file]
+ *
+ * With no capture file the stream is read from stdin:
+ *     bmstelemdecode -o run1 < /dev/ttyACM0
+ * writes run1_samples.csv, run1_quads.csv, run1_current.csv and run1_status.csv.
+ * Everything in the stream that isn't a telemetry frame (log output, console
+ * replies) is passed through to stdout. Lost frames (sequence gaps) and CRC
+ * failures are counted and reported on stderr at the end. With binary logging
+ * on as well (LOGBIN=1) pipe stdout into bmslogdecode.
+ *
+ Copyright (c) 2015 Collin Kidder
+
+ Permission is hereby granted, free of charge, to any person obtaining
+ a copy of this software and associated documentation files (the
+ "Software"), to deal in the Software without restriction, including
+ without limitation the rights to use, copy, modify, merge, publish,
+ distribute, sublicense, and/or sell copies of the Software, and to
+ permit persons to whom the Software is furnished to do so, subject to
+ the following conditions:
+
+ The above copyright notice and this permission notice shall be included
+ in all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "TelemetryFormat.h"
+
+static FILE *outputs[TELEM_STREAM_COUNT];
+static const char *streamNames[TELEM_STREAM_COUNT] = { "samples", "quads", "current", "status", "channels" };
+static const char *streamColumns[TELEM_STREAM_COUNT] =
+{
+	"time,seq,channel,raw,filtered",
+	"time,seq,v0,v1,v2,v3,t0,t1,t2,t3",
+	"time,seq,milliamps",
+	"time,seq,packvolts,packah,soc,status",
+	"time,seq,group,v0,v1,v2,v3,t0,t1,t2,t3"
+};
+static const uint8_t streamLength[TELEM_STREAM_COUNT] =
+{
+	sizeof(TELEM_SAMPLE), sizeof(TELEM_QUADS), sizeof(TELEM_CURRENT), sizeof(TELEM_STATUS), sizeof(TELEM_CHANNELS)
+};
+
+static uint32_t frames, lost, badCrc;
+static bool haveSequence;
+static uint16_t lastSequence;
+
+static void writeFrame(uint8_t stream, uint16_t seq, uint32_t time, const uint8_t *payload)
+{
+	FILE *out = outputs[stream];
+
+	fprintf(out, "%u,%u,", time, seq);
+	switch (stream)
+	{
+	case TELEM_STREAM_SAMPLE:
+	{
+		TELEM_SAMPLE sample;
+		memcpy(&sample, payload, sizeof(sample));
+		fprintf(out, "%u,%i,%i\n", sample.channel, sample.raw, sample.filtered);
+		break;
+	}
+	case TELEM_STREAM_QUADS:
+	{
+		TELEM_QUADS quads;
+		memcpy(&quads, payload, sizeof(quads));
+		fprintf(out, "%f,%f,%f,%f,%f,%f,%f,%f\n", quads.volts[0], quads.volts[1], quads.volts[2], quads.volts[3],
+			quads.temps[0], quads.temps[1], quads.temps[2], quads.temps[3]);
+		break;
+	}
+	case TELEM_STREAM_CURRENT:
+	{
+		TELEM_CURRENT current;
+		memcpy(&current, payload, sizeof(current));
+		fprintf(out, "%i\n", current.milliAmps);
+		break;
+	}
+	case TELEM_STREAM_STATUS:
+	{
+		TELEM_STATUS stat;
+		memcpy(&stat, payload, sizeof(stat));
+		fprintf(out, "%f,%u,%u,%u\n", stat.packVolts, stat.currentPackAH, stat.soc, stat.status);
+		break;
+	}
+	case TELEM_STREAM_CHANNELS:
+	{
+		TELEM_CHANNELS chans;
+		memcpy(&chans, payload, sizeof(chans));
+		fprintf(out, "%u,%f,%f,%f,%f,%f,%f,%f,%f\n", chans.group, chans.volts[0], chans.volts[1], chans.volts[2], chans.volts[3],
+			chans.temps[0], chans.temps[1], chans.temps[2], chans.temps[3]);
+		break;
+	}
+	}
+}
+
+//returns how many bytes were used if a valid frame starts at data, 0 otherwise
+static size_t decodeFrame(const uint8_t *data, size_t available, bool &needMore)
+{
+	needMore = false;
+
+	if (available < 2) { needMore = true; return 0; }
+	if (data[0] != TELEM_SYNC || data[1] != TELEM_RECORD) return 0;
+	if (available < TELEM_HEADER) { needMore = true; return 0; }
+	if (data[2] >= TELEM_STREAM_COUNT || data[3] != streamLength[data[2]]) return 0;
+
+	size_t length = TELEM_HEADER + data[3] + 2;
+	if (available < length) { needMore = true; return 0; }
+	uint16_t crc = data[length - 2] | (data[length - 1] << 8);
+	if (crc != telemCrc16(data, length - 2))
+	{
+		badCrc++;
+		return 0;
+	}
+
+	uint16_t seq = data[4] | (data[5] << 8);
+	uint32_t time = data[6] | (data[7] << 8) | (data[8] << 16) | ((uint32_t)data[9] << 24);
+	if (haveSequence) lost += (uint16_t)(seq - lastSequence - 1);
+	haveSequence = true;
+	lastSequence = seq;
+	frames++;
+
+	writeFrame(data[2], seq, time, &data[TELEM_HEADER]);
+	return length;
+}
+
+int main(int argc, char **argv)
+{
+	std::string prefix = "telemetry";
+	FILE *in = stdin;
+	std::vector<uint8_t> pending;
+	uint8_t chunk[4096];
+	size_t got;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-o") && i + 1 < argc) prefix = argv[++i];
+		else if (strcmp(argv[i], "-")) in = fopen(argv[i], "rb");
+		if (!in)
+		{
+			fprintf(stderr, "Could not open %s\n", argv[i]);
+			return 1;
+		}
+	}
+
+	for (int s = 0; s < TELEM_STREAM_COUNT; s++)
+	{
+		std::string name = prefix + "_" + streamNames[s] + ".csv";
+		outputs[s] = fopen(name.c_str(), "w");
+		if (!outputs[s])
+		{
+			fprintf(stderr, "Could not create %s\n", name.c_str());
+			return 1;
+		}
+		fprintf(outputs[s], "%s\n", streamColumns[s]);
+	}
+
+	while ((got = fread(chunk, 1, sizeof(chunk), in)) > 0)
+	{
+		pending.insert(pending.end(), chunk, chunk + got);
+		size_t pos = 0;
+		while (pos < pending.size())
+		{
+			bool needMore;
+			size_t used = decodeFrame(&pending[pos], pending.size() - pos, needMore);
+			if (needMore) break;
+			if (used == 0)
+			{
+				putchar(pending[pos++]); //not a frame, pass it through
+				continue;
+			}
+			pos += used;
+		}
+		pending.erase(pending.begin(), pending.begin() + pos);
+		fflush(stdout);
+	}
+	fwrite(pending.data(), 1, pending.size(), stdout);
+
+	for (int s = 0; s < TELEM_STREAM_COUNT; s++) fclose(outputs[s]);
+	fprintf(stderr, "%u frames, %u lost, %u failed CRC\n", frames, lost, badCrc);
+	return 0;
+}
@@ -25,23 +25,29 @@
  */
 
 #include "i2c_adc.h"
+#include "Telemetry.h"
 
-const uint8_t VBat[4][2] = {
-								{SWITCH_VBAT1_H, SWITCH_VBAT2_L},{SWITCH_VBAT2_H, SWITCH_VBAT3_L}, 
-								{SWITCH_VBAT3_H, SWITCH_VBAT4_L},{SWITCH_VBAT4_H,SWITCH_VBATRTN}
+//quadrant n is measured between VBATn_H and the L switch of the one below it
+const CHANNEL_DESC boardChannels[4] = {
+								{SWITCH_VBAT1_H, SWITCH_VBAT2_L, SWITCH_THERM1},{SWITCH_VBAT2_H, SWITCH_VBAT3_L, SWITCH_THERM2},
+								{SWITCH_VBAT3_H, SWITCH_VBAT4_L, SWITCH_THERM3},{SWITCH_VBAT4_H, SWITCH_VBATRTN, SWITCH_THERM4}
 						   };
 
+#if BMS_NUM_CHANNELS > 4
+//expansion boards put VBAT1_H through VBATRTN on expander bits 0 - 7 in the same order as the
+//board's pins are set up below, then THERM1 - 4 on bits 8 - 11
+const CHANNEL_DESC expansionChannels[4] = { {0, 1, 8}, {2, 3, 9}, {4, 5, 10}, {6, 7, 11} };
+
+#define EXPANDER_VBAT_BITS	0x00FF
+#define EXPANDER_THERM_BITS	0x0F00
+#define EXPANDER_OUTPUT		0x02 //PCA9555 output port 0 register, port 1 follows
+#define EXPANDER_CONFIG		0x06 //PCA9555 direction register for port 0. 0 bits are outputs
+#endif
+
 extern EEPROMSettings settings;
 extern STATUS status;
 
 ADCClass* ADCClass::instance = NULL;
-volatile bool doADC = false;
-
-void adcTickBounce()
-{
-	doADC = true;	
-}
-
 ADCClass* ADCClass::getInstance()
 {
 	if (instance == NULL)
@@ -62,21 +68,58 @@ void ADCClass::setup()
 	pinModeNonDue(SWITCH_VBAT4_L, OUTPUT );
 	pinModeNonDue(SWITCH_VBAT4_H, OUTPUT );
 	pinModeNonDue(SWITCH_VBATRTN, OUTPUT );
-	setAllVOff();
-	setVEnable(0);
 
 	//Thermistor inputs
 	pinModeNonDue(SWITCH_THERM1, OUTPUT );
 	pinModeNonDue(SWITCH_THERM2, OUTPUT );
 	pinModeNonDue(SWITCH_THERM3, OUTPUT );
 	pinModeNonDue(SWITCH_THERM4, OUTPUT );
+
+#if BMS_NUM_CHANNELS > 4
+	//expansion board switches all off and made outputs
+	muxGroup = 0xFF; //so the first selectGroup() really writes to the mux
+	for (int group = 1; group < BMS_CHANNEL_GROUPS; group++)
+	{
+		writeExpander(group, 0);
+		Wire.beginTransmission(CHANNEL_GPIO_ADDR);
+		Wire.write(EXPANDER_CONFIG);
+		Wire.write(0);
+		Wire.write(0);
+		Wire.endTransmission();
+	}
+	selectGroup(0);
+#endif
+
+	setAllVOff();
+	setVEnable(0);
 	setAllThermOff();
-	setThermActive(SWITCH_THERM1);
+	setThermActive(0);
+}
 
-	Timer3.attachInterrupt(adcTickBounce);
-	Timer3.start(125000); //trigger every 125ms
+#if BMS_NUM_CHANNELS > 4
+//point the I2C mux at an expansion board's ADCs and expander. Group 0 turns every mux port off
+//so the board's own ADCs, which have the same addresses, are the only ones on the bus
+void ADCClass::selectGroup(uint8_t group)
+{
+	if (group == muxGroup) return;
+	Wire.beginTransmission(CHANNEL_MUX_ADDR);
+	Wire.write((group == 0) ? 0 : 1 << (group - 1));
+	Wire.endTransmission();
+	muxGroup = group;
 }
 
+void ADCClass::writeExpander(uint8_t group, uint16_t value)
+{
+	selectGroup(group);
+	Wire.beginTransmission(CHANNEL_GPIO_ADDR);
+	Wire.write(EXPANDER_OUTPUT);
+	Wire.write(value & 0xFF);
+	Wire.write(value >> 8);
+	Wire.endTransmission();
+	expanderOut[group] = value;
+}
+#endif
+
 
 void ADCClass::setAllVOff()
 {
@@ -88,14 +131,28 @@ void ADCClass::setAllVOff()
   digitalWriteNonDue( SWITCH_VBAT4_L, LOW );
   digitalWriteNonDue( SWITCH_VBAT4_H, LOW );
   digitalWriteNonDue( SWITCH_VBATRTN, LOW );
+#if BMS_NUM_CHANNELS > 4
+  for (int group = 1; group < BMS_CHANNEL_GROUPS; group++)
+  {
+    if (expanderOut[group] & EXPANDER_VBAT_BITS) writeExpander(group, expanderOut[group] & ~EXPANDER_VBAT_BITS);
+  }
+#endif
 }
 
 void ADCClass::setVEnable(uint8_t which)
 {
-	if (which > 3) return;
+	if (which >= BMS_NUM_CHANNELS) return;
 	setAllVOff();
-	digitalWriteNonDue(VBat[which][0], HIGH);
-	digitalWriteNonDue(VBat[which][1], HIGH);
+#if BMS_NUM_CHANNELS > 4
+	if (which >= 4)
+	{
+		const CHANNEL_DESC &chan = expansionChannels[which & 3];
+		writeExpander(which / 4, expanderOut[which / 4] | (1 << chan.vHigh) | (1 << chan.vLow));
+		return;
+	}
+#endif
+	digitalWriteNonDue(boardChannels[which].vHigh, HIGH);
+	digitalWriteNonDue(boardChannels[which].vLow, HIGH);
 }
 
 void ADCClass::setAllThermOff()
@@ -104,14 +161,26 @@ void ADCClass::setAllThermOff()
   digitalWriteNonDue(SWITCH_THERM2, LOW);
   digitalWriteNonDue(SWITCH_THERM3, LOW );
   digitalWriteNonDue(SWITCH_THERM4, LOW );
+#if BMS_NUM_CHANNELS > 4
+  for (int group = 1; group < BMS_CHANNEL_GROUPS; group++)
+  {
+    if (expanderOut[group] & EXPANDER_THERM_BITS) writeExpander(group, expanderOut[group] & ~EXPANDER_THERM_BITS);
+  }
+#endif
 }
 
 void ADCClass::setThermActive(uint8_t which)
 {
-	if (which < SWITCH_THERM1) return;
-	if (which > SWITCH_THERM4) return;
+	if (which >= BMS_NUM_CHANNELS) return;
 	setAllThermOff();
-	digitalWriteNonDue(which, HIGH );
+#if BMS_NUM_CHANNELS > 4
+	if (which >= 4)
+	{
+		writeExpander(which / 4, expanderOut[which / 4] | (1 << expansionChannels[which & 3].therm));
+		return;
+	}
+#endif
+	digitalWriteNonDue(boardChannels[which].therm, HIGH );
 }
 
 //ask for a reading to start. Currently we support 15 reads per second so one must wait
@@ -140,8 +209,8 @@ bool ADCClass::adsGetData(byte addr, int16_t &value)
 
 /*
   periodic tick that handles reading ADCs and doing other stuff that happens on a schedule.
-  There are four voltage readings and four thermistor readings and they are on separate
-  ads chips. What happens is a new source is selected and then a conversion is started. Later
+  There are BMS_NUM_CHANNELS voltage readings and as many thermistor readings and they are on separate
+  ads chips. Past the first four the chips are on expansion boards so the I2C mux is switched first. What happens is a new source is selected and then a conversion is started. Later
   on we read back the value. The code runs like this:
   1. Start conversion for voltage
   2. Read that conversion and select a new voltage source
@@ -154,10 +223,10 @@ bool ADCClass::adsGetData(byte addr, int16_t &value)
 */
 void ADCClass::handleTick()
 {
+	PROFILE_SCOPE("handleTick");
+
 	//these track which reading we are about to request
 	static byte vNum = 0, tNum = 0; //which voltage and thermistor reading we're on
-	static byte Operation = 0; //quad way operation 0 = read voltage, 1 = start new voltage reading, 2 = read temperature, 3 = start new temperature reading and calculate faults
-	static uint16_t EEPROMWriteCounter = 0;
 
 	int32_t vTemp, tTemp;
 
@@ -170,28 +239,20 @@ void ADCClass::handleTick()
 	int perMilliVolt;
 	int thisTemperature;
 
-	//This is just an opportune place because it is the only place that currently has a timer set up. Probably should move
-	//this to a better place and set up another timer
-	//125ms tick * 500 = 62.5 second interval for writing which gives us at least a full year of run time.
-	EEPROMWriteCounter++;
-	if (EEPROMWriteCounter > 500)
-	{
-		EEPROMWriteCounter = 0;
-		EEPROM.write(0, settings);
-	}
-
-	switch (Operation) 
+	switch (operation) 
 	{
 	case 0: //start by asking to begin an ADC reading for voltage
+		selectGroup(vNum / 4);
 		adsStartConversion(VIN_ADDR);
 		break;
 	case 1: //its been some time since we asked for the reading so ask for it now
 		//read the values from the previous cycle
 		//if there is a problem we won't update the values stored
+		selectGroup(vNum / 4);
 		if (adsGetData(VIN_ADDR, readValue))
 		{
-			vReading[vNum][vReadingPos] = readValue;
-			vReadingPos = (vReadingPos + 1) % SAMPLES;
+			vReading[vNum][vReadingPos[vNum]] = readValue;
+			vReadingPos[vNum] = (vReadingPos[vNum] + 1) % SAMPLES;
 			vTemp = 0;
 			for (x = 0; x < SAMPLES; x++)
 			{
@@ -199,29 +260,32 @@ void ADCClass::handleTick()
 			}
 			vTemp /= SAMPLES;
 			vAccum[vNum] = vTemp;
+			Telemetry::getInstance()->sendSample(vNum, readValue, vTemp);
 		}
 		else Logger::error("Error reading voltage");
 
 		divisor = 1.0f;
 		if (settings.numQuadCells[vNum] > 0) divisor = (float)settings.numQuadCells[vNum];
-		Logger::debug("V%i: %f AV%i %f", vNum, getVoltage(vNum), vNum, getVoltage(vNum) / divisor);		
+		if (Logger::isDebug()) Logger::debug("V%i: %f AV%i %f", vNum, getVoltage(vNum), vNum, getVoltage(vNum) / divisor);
 		//if (vNum == 3) Logger::debug("Total system voltage: %f", getVoltage(0) + getVoltage(1) + getVoltage(2) + getVoltage(3));
 
-		vNum = (vNum + 1) & 3;
+		vNum = (vNum + 1) % BMS_NUM_CHANNELS;
 
 		setVEnable(vNum);
 		break;
 
 	case 2:
+		selectGroup(tNum / 4);
 		adsStartConversion(THERM_ADDR);
 		break;
 
 	case 3:
+		selectGroup(tNum / 4);
 		if (adsGetData(THERM_ADDR, readValue))
 		{
 			//Logger::debug("TL: %i", readValue);
-			tReading[tNum][tReadingPos] = readValue;
-			tReadingPos = (tReadingPos + 1) % SAMPLES;
+			tReading[tNum][tReadingPos[tNum]] = readValue;
+			tReadingPos[tNum] = (tReadingPos[tNum] + 1) % SAMPLES;
 			tTemp = 0;
 			for (x = 0; x < SAMPLES; x++)
 			{
@@ -229,15 +293,18 @@ void ADCClass::handleTick()
 			}
 			tTemp /= SAMPLES;
 			tAccum[tNum] = tTemp;
+			Telemetry::getInstance()->sendSample(BMS_NUM_CHANNELS + tNum, readValue, tTemp);
 		}
 		else Logger::error("Error reading temperature");
 
-		Logger::debug("T%i: %f", tNum, getTemperature(tNum));
-		Logger::debug(" ");
+		if (Logger::isDebug())
+		{
+			Logger::debug("T%i: %f", tNum, getTemperature(tNum));
+			Logger::debug(" ");
+		}
 
-		tNum = tNum + 1;
-		tNum &= 3;
-		setThermActive(SWITCH_THERM1 + tNum);
+		tNum = (tNum + 1) % BMS_NUM_CHANNELS;
+		setThermActive(tNum);
 		break;
 	case 4: //calculate the various faults
 		vHigh = -10000.0f;
@@ -251,13 +318,15 @@ void ADCClass::handleTick()
 		status.HIGHT = 0;
 		status.HIGHV = 0;
 
-		for (int y = 0; y < 4; y++)
+		for (int y = 0; y < BMS_NUM_CHANNELS; y++)
 		{
+			//no cells set up on this channel (not wired, or the wizard hasn't been run) so
+			//there is nothing to compare against the per cell thresholds
+			if (settings.numQuadCells[y] == 0) continue;
 			quadVolt = getVoltage(y);
-			divisor = 1.0f;
-			if (settings.numQuadCells[y] > 0) divisor = (float)settings.numQuadCells[y];
+			divisor = (float)settings.numQuadCells[y];
 			perVolt = quadVolt / divisor;
-			perMilliVolt = (int)(quadVolt * 1000);
+			perMilliVolt = (int)(perVolt * 1000); //thresholds are per cell
 			thisTemperature = (int)(getTemperature(y) * 10);
 			if (perVolt > vHigh) vHigh = perVolt;
 			if (perVolt < vLow) vLow = perVolt;
@@ -299,31 +368,43 @@ void ADCClass::handleTick()
 			status.DISCHARGE_OK = 0; //also not OK to discharge
 		}
 		else status.IMBALANCE = 0;
+		scanCount++;
+		Telemetry::getInstance()->sendScan();
 		break;
 	}
 	
-	Operation++;
-	if (Operation == 5) Operation = 0;
+	operation++;
+	if (operation == 5) operation = 0;
+}
+
+byte ADCClass::getOperation()
+{
+	return operation;
+}
+
+uint32_t ADCClass::getScanCount()
+{
+	return scanCount;
 }
 
 int ADCClass::getRawV(int which)
 {
 	if (which < 0) return 0;
-	if (which > 3) return 0;
+	if (which >= BMS_NUM_CHANNELS) return 0;
 	return vAccum[which];
 }
 
 int ADCClass::getRawT(int which)
 {
 	if (which < 0) return 0;
-	if (which > 3) return 0;
+	if (which >= BMS_NUM_CHANNELS) return 0;
 	return tAccum[which];
 }
 
 float ADCClass::getVoltage(int which)
 {
 	if (which < 0) return 0.0f;
-	if (which > 3) return 0.0f;
+	if (which >= BMS_NUM_CHANNELS) return 0.0f;
 	return (vAccum[which] * settings.vMultiplier[which]);
 }
 
@@ -331,7 +412,7 @@ float ADCClass::getCellAvgVoltage(int which)
 {
 	float divisor = 1.0f;
 	if (which < 0) return 0.0f;
-	if (which > 3) return 0.0f;
+	if (which >= BMS_NUM_CHANNELS) return 0.0f;
 	if (settings.numQuadCells[which] > 0) divisor = (float)settings.numQuadCells[which];
 	return (vAccum[which] * settings.vMultiplier[which] / divisor);
 }
@@ -339,14 +420,14 @@ float ADCClass::getCellAvgVoltage(int which)
 float ADCClass::getPackVoltage()
 {
 	float accum = 0.0f;
-	for (int x = 0; x < 4; x++) accum += getVoltage(x);
+	for (int x = 0; x < BMS_NUM_CHANNELS; x++) accum += getVoltage(x);
 	return accum;
 }
 
 float ADCClass::getTemperature(int which)
 {
 	if (which < 0) return 0.0f;
-	if (which > 3) return 0.0f;
+	if (which >= BMS_NUM_CHANNELS) return 0.0f;
 
 	//temperature is much more complicated to calculate. Luckily we only do it when asked
 	//Basically just use a third order polynomial. The results are actually fairly linear but off by enough
@@ -365,12 +446,3 @@ float ADCClass::getTemperature(int which)
 	return (y);
 }
 
-void ADCClass::loop()
-{
-	if (doADC)
-	{
-		ADCClass::getInstance()->handleTick();
-		doADC = false;
-	}
-}
-
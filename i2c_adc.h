@@ -30,6 +30,7 @@
 #include <DueTimer.h>
 #include "Logger.h"
 #include "config.h"
+#include "Profiler.h"
 
 
 #ifndef ADCCLASS_H_
@@ -37,7 +38,14 @@
 
 #define SAMPLES	8 //how many samples to use while smoothing
 
-extern volatile bool doADC;
+//the switches for one channel. On the board these are pins, on an expansion board they are
+//bit numbers in the port expander's 16 bit output register
+struct CHANNEL_DESC
+{
+	uint8_t vHigh; //connects the top of the quadrant to the voltage ADC
+	uint8_t vLow; //connects the bottom
+	uint8_t therm; //connects the quadrant's thermistor to the thermistor ADC
+};
 
 class ADCClass 
 {
@@ -51,22 +59,35 @@ public:
 	float getCellAvgVoltage(int which);
 	float getPackVoltage();
 	float getTemperature(int which);
-	void loop();
+	uint32_t getScanCount();
+	byte getOperation(); //which of its five steps handleTick() does next
 
 private:
 	//There are three full readings per second so 32 entries is about 10 seconds worth of data
 	//Thus, the average of all these readings is a 10 second average of the pack performance
-	int16_t vReading[4][SAMPLES];
-	int16_t tReading[4][SAMPLES];
-	int vAccum[4];
-	int tAccum[4];
-	byte vReadingPos, tReadingPos;
+	int16_t vReading[BMS_NUM_CHANNELS][SAMPLES];
+	int16_t tReading[BMS_NUM_CHANNELS][SAMPLES];
+	int vAccum[BMS_NUM_CHANNELS];
+	int tAccum[BMS_NUM_CHANNELS];
+	byte vReadingPos[BMS_NUM_CHANNELS], tReadingPos[BMS_NUM_CHANNELS]; //next slot to fill in each ring
+	byte operation; //0 = start a voltage conversion, 1 = read it, 2 and 3 the same for temperature, 4 = work out faults
+	volatile uint32_t scanCount; //up by one per fault check. Each one follows a voltage and a thermistor reading so all BMS_NUM_CHANNELS are fresh every BMS_NUM_CHANNELS counts
 	static ADCClass *instance;	
+#if BMS_NUM_CHANNELS > 4
+	uint8_t muxGroup; //channel group the I2C mux is switched to. 0 is the board, mux all off
+	uint16_t expanderOut[BMS_CHANNEL_GROUPS]; //last thing written to each expansion board's switches
+#endif
 
 	void setAllVOff();
 	void setVEnable(uint8_t which);
 	void setAllThermOff();
 	void setThermActive(uint8_t which);
+#if BMS_NUM_CHANNELS > 4
+	void selectGroup(uint8_t group);
+	void writeExpander(uint8_t group, uint16_t value);
+#else
+	void selectGroup(uint8_t) {} //only the board's own ADCs, nothing to switch
+#endif
 	void adsStartConversion(uint8_t addr);
 	bool adsGetData(byte addr, int16_t &value);	
 };